@@ -0,0 +1,629 @@
+// Micro-benchmarks of the functionals and dynamics of the droplet model.
+//
+//   mpirun -np N ./lbm_bench [--sizes 64,128,...] [--min-time seconds]
+//                            [--repeats n] [--filter text] [--out file.json]
+//                            [--threads n]
+//
+// Every kernel runs on square n x n lattices. Each measurement runs the
+// kernel repeatedly for at least --min-time seconds (slowest rank). The
+// median of --repeats measurements is reported as MLUPS, with the modelled
+// memory traffic per cell update (compulsory loads and stores of the data
+// the kernel touches) and the storage the benchmark allocates per cell.
+// python/bench_compare.py compares two result files; bench/run_bench.sh
+// sweeps rank counts. With --threads n the whole coupled step,
+// CollideAndStream2D and BlockedSpeciesCollideAndStream2D use n threads per
+// rank (see TileExecutor).
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ComputeLaplacian.h"
+#include "ComputeNormGradient.h"
+#include "DropletModel.h"
+#include "SimdStencil.h"
+#include "TwoSpeciesLattice.h"
+#include "custom_dynamics.h"
+
+using namespace plb;
+typedef double T;
+#define DESCRIPTOR descriptors::PhaseFieldD2Q9Descriptor
+
+namespace {
+
+typedef MultiBlockLattice2D<T, DESCRIPTOR> Lattice;
+
+const double latticeCellBytes =
+    (DESCRIPTOR<T>::q + DESCRIPTOR<T>::ExternalField::numScalars) * sizeof(T);
+const double populationBytes = DESCRIPTOR<T>::q * sizeof(T);
+
+struct BenchResult {
+  std::string name;
+  plint nx, ny;
+  plint iterations;
+  double seconds;
+  double mlups;
+  double bytesPerCellUpdate;
+  double storageBytesPerCell;
+};
+
+struct BenchOptions {
+  std::vector<plint> sizes{64, 128, 256, 512, 1024, 2048, 4096};
+  double minTime = 0.2;
+  int repeats = 3;
+  std::string filter;
+  std::string out = "bench.json";
+  unsigned threads = 1;
+};
+
+double maxOverRanks(double value) {
+#ifdef PLB_MPI_PARALLEL
+  MPI_Allreduce(MPI_IN_PLACE, &value, 1, MPI_DOUBLE, MPI_MAX,
+                global::mpi().getGlobalCommunicator());
+#endif
+  return value;
+}
+
+// Seconds for iterations calls of body, on the slowest rank.
+double timeIterations(std::function<void()> const &body, plint iterations) {
+  global::mpi().barrier();
+  auto start = std::chrono::steady_clock::now();
+  for (plint i = 0; i < iterations; ++i) {
+    body();
+  }
+  global::mpi().barrier();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return maxOverRanks(elapsed.count());
+}
+
+class BenchSuite {
+public:
+  explicit BenchSuite(BenchOptions const &options) : options_(options) {}
+
+  bool selected(std::string const &name) const {
+    return options_.filter.empty() ||
+           name.find(options_.filter) != std::string::npos;
+  }
+
+  // One warm-up call, then doubles the iteration count until a run lasts
+  // minTime, then keeps the median of repeats runs. A call of body that
+  // advances stepsPerCall steps counts as that many cell updates per cell.
+  void measure(std::string const &name, plint n, double bytesPerCellUpdate,
+               double storageBytesPerCell, std::function<void()> const &body,
+               plint stepsPerCall = 1) {
+    body();
+    plint iterations = 1;
+    double seconds = timeIterations(body, iterations);
+    while (seconds < options_.minTime) {
+      iterations *= 2;
+      seconds = timeIterations(body, iterations);
+    }
+    std::vector<double> runs{seconds};
+    for (int i = 1; i < options_.repeats; ++i) {
+      runs.push_back(timeIterations(body, iterations));
+    }
+    std::sort(runs.begin(), runs.end());
+    seconds = runs[runs.size() / 2];
+
+    BenchResult result;
+    result.name = name;
+    result.nx = result.ny = n;
+    result.iterations = iterations;
+    result.seconds = seconds;
+    result.mlups = (double)n * (double)n * (double)(iterations * stepsPerCall) /
+                   seconds / 1e6;
+    result.bytesPerCellUpdate = bytesPerCellUpdate;
+    result.storageBytesPerCell = storageBytesPerCell;
+    results_.push_back(result);
+
+    pcout << name << " " << n << "^2: " << result.mlups << " MLUPS, "
+          << result.mlups * bytesPerCellUpdate / 1e3 << " GB/s modelled ("
+          << iterations << " iterations in " << seconds << " s)"
+          << std::endl;
+  }
+
+  void writeJson(std::string const &fileName) const;
+
+private:
+  BenchOptions options_;
+  std::vector<BenchResult> results_;
+};
+
+std::string jsonString(std::string const &text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+void BenchSuite::writeJson(std::string const &fileName) const {
+  if (global::mpi().getRank() != 0) {
+    return;
+  }
+  std::time_t now = std::time(nullptr);
+  char date[32];
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::gmtime(&now));
+
+  std::ofstream out(fileName.c_str());
+  if (!out) {
+    throw PlbIOException("lbm_bench: cannot write " + fileName);
+  }
+  out.precision(9);
+  out << "{\n  \"date\": " << jsonString(date)
+      << ",\n  \"ranks\": " << global::mpi().getSize()
+      << ",\n  \"simd\": " << jsonString(simdLevelName(activeSimdLevel()))
+      << ",\n  \"compiler\": " << jsonString(__VERSION__)
+      << ",\n  \"results\": [";
+  for (std::size_t i = 0; i < results_.size(); ++i) {
+    BenchResult const &r = results_[i];
+    out << (i ? "," : "") << "\n    {\"name\": " << jsonString(r.name)
+        << ", \"nx\": " << r.nx << ", \"ny\": " << r.ny
+        << ", \"ranks\": " << global::mpi().getSize()
+        << ", \"iterations\": " << r.iterations
+        << ", \"seconds\": " << r.seconds << ", \"mlups\": " << r.mlups
+        << ", \"bytesPerCellUpdate\": " << r.bytesPerCellUpdate
+        << ", \"storageBytesPerCell\": " << r.storageBytesPerCell << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+std::unique_ptr<Lattice> makeLattice(plint n, Dynamics<T, DESCRIPTOR> *dynamics,
+                                     plint envelope = 1) {
+  return createLattice<T, DESCRIPTOR>(
+      defaultMultiBlockPolicy2D().getMultiBlockManagement(n, n, envelope),
+      dynamics);
+}
+
+// Species record of the interleaved layouts: c1 and c2 populations and phi.
+const plint speciesRecord = 2 * DESCRIPTOR<T>::q + 1;
+
+// The species collision on raw records without streaming, so that only the
+// layout differs: blocks of width consecutive cells store each value in a
+// run of width entries, i.e. AoS for width 1, SoA for width = numCells and
+// AoSoA in between. data holds whole blocks. Runs are collided lanes cells
+// at a time (SpeciesCollisionCell::block), the rest of a run cell by cell.
+template <int lanes>
+void collideRecords(std::vector<T> &data, plint numCells, plint width,
+                    SpeciesCollisionCell<T, DESCRIPTOR> const &collision) {
+  const plint q = DESCRIPTOR<T>::q;
+  for (plint first = 0; first < numCells; first += width) {
+    T *base = data.data() + first * speciesRecord;
+    const plint cells = std::min(width, numCells - first);
+    plint k = 0;
+    for (; k + lanes <= cells; k += lanes) {
+      collision.template block<lanes>(base + k, base + q * width + k,
+                                      base + 2 * q * width + k, width);
+    }
+    for (; k < cells; ++k) {
+      collision.template block<1>(base + k, base + q * width + k,
+                                  base + 2 * q * width + k, width);
+    }
+  }
+}
+
+void collideRecords(std::vector<T> &data, plint numCells, plint width,
+                    SpeciesCollisionCell<T, DESCRIPTOR> const &collision) {
+  if (width == 1) {
+    collideRecords<1>(data, numCells, width, collision);
+  } else if (width == 4) {
+    collideRecords<4>(data, numCells, width, collision);
+  } else {
+    collideRecords<8>(data, numCells, width, collision);
+  }
+}
+
+// Droplet of radius n / 4 at the centre, so every kernel sees bulk and
+// interface cells.
+void initializeDroplet(Lattice &phiLattice, plint n, T zeta) {
+  applyProcessingFunctional(
+      new InitializePhiFunctional<T, DESCRIPTOR>((T)n / 4, zeta, n / 2, n / 2),
+      phiLattice.getBoundingBox(), phiLattice);
+}
+
+void runSize(BenchSuite &suite, plint n, unsigned threads) {
+  DropletParameters params;
+  params.nx = params.ny = n;
+  params.threads = threads;
+  params.r0 = (double)n / 4;
+  Box2D box(0, n - 1, 0, n - 1);
+  Array<T, 2> zero(0., 0.);
+  const double scalarBytes = sizeof(T);
+
+  // ---- initialization and finite-difference stencils ----
+  if (suite.selected("InitializePhiFunctional")) {
+    std::unique_ptr<Lattice> phiLattice =
+        makeLattice(n, new phi<T, DESCRIPTOR>(params.M, params.zeta));
+    suite.measure("InitializePhiFunctional", n, populationBytes,
+                  latticeCellBytes,
+                  [&]() { initializeDroplet(*phiLattice, n, params.zeta); });
+  }
+
+  // emulsion of (n / 16)^2 droplets into phi, c1 and c2
+  if (suite.selected("InitializeDropletsFunctional2D")) {
+    std::unique_ptr<Lattice> phiLattice =
+        makeLattice(n, new phi<T, DESCRIPTOR>(params.M, params.zeta));
+    std::unique_ptr<Lattice> c1 =
+        makeLattice(n, new BGKdynamics<T, DESCRIPTOR>(1. / params.tau1));
+    std::unique_ptr<Lattice> c2 =
+        makeLattice(n, new BGKdynamics<T, DESCRIPTOR>(1. / params.tau2));
+    std::vector<DropletSpec> droplets;
+    for (plint x = 8; x < n; x += 16) {
+      for (plint y = 8; y < n; y += 16) {
+        DropletSpec droplet;
+        droplet.x = (double)x;
+        droplet.y = (double)y;
+        droplet.r = 5.;
+        droplets.push_back(droplet);
+      }
+    }
+    std::vector<Lattice *> lattices{phiLattice.get(), c1.get(), c2.get()};
+    suite.measure("InitializeDropletsFunctional2D", n, 3 * populationBytes,
+                  3 * latticeCellBytes, [&]() {
+                    DropletField field(droplets, params.zeta, params.c_bulk);
+                    applyProcessingFunctional(
+                        new InitializeDropletsFunctional2D<T, DESCRIPTOR>(
+                            &field),
+                        box, lattices);
+                  });
+  }
+
+  if (suite.selected("BoxNormGradientFunctional2D") ||
+      suite.selected("BoxLaplacianFunctional2D") ||
+      suite.selected("FusedInterfaceFunctional2D")) {
+    std::unique_ptr<Lattice> phiLattice =
+        makeLattice(n, new phi<T, DESCRIPTOR>(params.M, params.zeta));
+    initializeDroplet(*phiLattice, n, params.zeta);
+    std::unique_ptr<MultiScalarField2D<T>> density =
+        generateMultiScalarField<T>(*phiLattice, 2);
+    applyProcessingFunctional(new BoxDensityFunctional2D<T, DESCRIPTOR>(), box,
+                              *phiLattice, *density);
+
+    if (suite.selected("BoxNormGradientFunctional2D")) {
+      MultiTensorField2D<T, 2> normGrad(*density);
+      suite.measure("BoxNormGradientFunctional2D", n, 3 * scalarBytes,
+                    3 * scalarBytes, [&]() {
+                      applyProcessingFunctional(
+                          new BoxNormGradientFunctional2D<T>(), box, *density,
+                          normGrad, 1);
+                    });
+    }
+    if (suite.selected("BoxLaplacianFunctional2D")) {
+      MultiScalarField2D<T> laplacian(*density);
+      suite.measure("BoxLaplacianFunctional2D", n, 2 * scalarBytes,
+                    2 * scalarBytes, [&]() {
+                      applyProcessingFunctional(
+                          new BoxLaplacianFunctional2D<T>(), box, *density,
+                          laplacian, 1);
+                    });
+    }
+    if (suite.selected("FusedInterfaceFunctional2D")) {
+      // reads the density, writes grad, n-hat, lap and mu
+      suite.measure("FusedInterfaceFunctional2D", n, 7 * scalarBytes,
+                    latticeCellBytes + scalarBytes, [&]() {
+                      applyProcessingFunctional(
+                          new FusedInterfaceFunctional2D<T, DESCRIPTOR>(
+                              params.beta, params.kappa, box, params.stencil),
+                          box, *phiLattice, *density);
+                    });
+    }
+  }
+
+  // ---- couplings ----
+  if (suite.selected("lattice_coupling") ||
+      suite.selected("SpeciesCollideAndStream2D") ||
+      suite.selected("BlockedSpeciesCollideAndStream2D") ||
+      suite.selected("SpeciesReaction2D")) {
+    std::unique_ptr<Lattice> phiLattice =
+        makeLattice(n, new phi<T, DESCRIPTOR>(params.M, params.zeta));
+    std::unique_ptr<Lattice> c1 =
+        makeLattice(n, new BGKdynamics<T, DESCRIPTOR>(1. / params.tau1));
+    std::unique_ptr<Lattice> c2 =
+        makeLattice(n, new BGKdynamics<T, DESCRIPTOR>(1. / params.tau2));
+    initializeDroplet(*phiLattice, n, params.zeta);
+    initializeAtEquilibrium(*c1, box, (T)params.c_bulk, zero);
+    initializeAtEquilibrium(*c2, box, (T)params.c_bulk, zero);
+    std::vector<Lattice *> lattices{c1.get(), c2.get(), phiLattice.get()};
+
+    // c1 and c2 read and written, phi populations read
+    const double couplingBytes = 5 * populationBytes;
+    if (suite.selected("lattice_coupling")) {
+      suite.measure("lattice_coupling", n, couplingBytes,
+                    3 * latticeCellBytes, [&]() {
+                      applyProcessingFunctional(
+                          new lattice_coupling<T, DESCRIPTOR>(
+                              1. / params.tau1, params.chi, params.mu,
+                              params.a, params.b, params.epsilon,
+                              params.c_bulk, params.tau1, params.tau2),
+                          box, lattices);
+                    });
+    }
+    // the coupling followed by the streaming of c1 and c2, in one sweep
+    if (suite.selected("SpeciesCollideAndStream2D")) {
+      suite.measure("SpeciesCollideAndStream2D", n, couplingBytes,
+                    3 * latticeCellBytes, [&]() {
+                      applyProcessingFunctional(
+                          new SpeciesCollideAndStream2D<T, DESCRIPTOR>(
+                              params.chi, params.mu, params.a, params.b,
+                              params.epsilon, params.c_bulk, params.tau1,
+                              params.tau2),
+                          box, lattices);
+                    });
+    }
+    // the same sweep on the interleaved lattice, packed from c1 and c2
+    if (suite.selected("TwoSpeciesCollideAndStream2D")) {
+      typedef MultiBlockLattice2D<T, descriptors::TwoSpeciesD2Q9Descriptor>
+          SpeciesLattice;
+      std::unique_ptr<SpeciesLattice> species =
+          createLattice<T, descriptors::TwoSpeciesD2Q9Descriptor>(
+              c1->getMultiBlockManagement(),
+              new BGKdynamics<T, descriptors::TwoSpeciesD2Q9Descriptor>(
+                  1. / params.tau1));
+      applyProcessingFunctional(
+          new TwoSpeciesTransfer2D<T, DESCRIPTOR,
+                                   descriptors::TwoSpeciesD2Q9Descriptor>(
+              1, true),
+          box, *c1, *species);
+      applyProcessingFunctional(
+          new TwoSpeciesTransfer2D<T, DESCRIPTOR,
+                                   descriptors::TwoSpeciesD2Q9Descriptor>(
+              2, true),
+          box, *c2, *species);
+      applyProcessingFunctional(
+          new TwoSpeciesCachePhi2D<T, descriptors::TwoSpeciesD2Q9Descriptor,
+                                   DESCRIPTOR>(),
+          box, *species, *phiLattice);
+      // c1 and c2 read and written, phi read, all from one record
+      suite.measure("TwoSpeciesCollideAndStream2D", n,
+                    (4 * DESCRIPTOR<T>::q + 1) * sizeof(T),
+                    speciesRecord * sizeof(T), [&]() {
+                      applyProcessingFunctional(
+                          new TwoSpeciesCollideAndStream2D<
+                              T, descriptors::TwoSpeciesD2Q9Descriptor>(
+                              params.chi, params.mu, params.a, params.b,
+                              params.epsilon, params.c_bulk, params.tau1,
+                              params.tau2),
+                          box, *species);
+                    });
+    }
+    // four steps per sweep from the phi of each step, in 64^2 tiles, with
+    // what the model adds around the sweep: the phi density recorded at
+    // every step and the exchange of the depth-wide envelopes
+    if (suite.selected("BlockedSpeciesCollideAndStream2D")) {
+      const plint depth = 4;
+      std::unique_ptr<Lattice> c1Blocked = makeLattice(
+          n, new BGKdynamics<T, DESCRIPTOR>(1. / params.tau1), depth);
+      std::unique_ptr<Lattice> c2Blocked = makeLattice(
+          n, new BGKdynamics<T, DESCRIPTOR>(1. / params.tau2), depth);
+      initializeAtEquilibrium(*c1Blocked, box, (T)params.c_bulk, zero);
+      initializeAtEquilibrium(*c2Blocked, box, (T)params.c_bulk, zero);
+      std::vector<std::unique_ptr<MultiScalarField2D<T>>> history;
+      std::vector<MultiBlock2D *> blocks{c1Blocked.get(), c2Blocked.get()};
+      for (plint step = 0; step < depth; ++step) {
+        history.push_back(generateMultiScalarField<T>(*c1Blocked, depth));
+        blocks.push_back(history.back().get());
+      }
+      std::unique_ptr<TileExecutor> executor;
+      if (threads > 1) {
+        executor.reset(new TileExecutor(threads, params.threadTileSize));
+      }
+      // per step: phi populations read and phi written by the record; c1
+      // and c2 read and written once per sweep, phi read every step
+      suite.measure(
+          "BlockedSpeciesCollideAndStream2D", n,
+          populationBytes + 2. * scalarBytes +
+              4. * populationBytes / (double)depth,
+          2 * latticeCellBytes + (double)depth * scalarBytes,
+          [&]() {
+            for (plint step = 0; step < depth; ++step) {
+              applyProcessingFunctional(
+                  new BoxDensityFunctional2D<T, DESCRIPTOR>(), box,
+                  *phiLattice, *history[step]);
+            }
+            c1Blocked->duplicateOverlaps(modif::staticVariables);
+            c2Blocked->duplicateOverlaps(modif::staticVariables);
+            for (std::unique_ptr<MultiScalarField2D<T>> &phi : history) {
+              phi->duplicateOverlaps(modif::staticVariables);
+            }
+            applyProcessingFunctional(
+                new BlockedSpeciesCollideAndStream2D<T, DESCRIPTOR>(
+                    params.chi, params.mu, params.a, params.b,
+                    params.epsilon, params.c_bulk, params.tau1, params.tau2,
+                    box, params.speciesBlockingTile, executor.get()),
+                box, blocks);
+          },
+          depth);
+    }
+    if (suite.selected("SpeciesReaction2D")) {
+      ReactionKinetics<T> kinetics{params.a, params.b, params.epsilon,
+                                   params.c_bulk};
+      ReactionIntegrator<T> integrator;
+      suite.measure("SpeciesReaction2D", n, couplingBytes,
+                    3 * latticeCellBytes, [&]() {
+                      applyProcessingFunctional(
+                          new SpeciesReaction2D<T, DESCRIPTOR>(
+                              kinetics, integrator, (T)1),
+                          box, lattices);
+                    });
+    }
+  }
+
+  // ---- species record layouts (collision only, on raw records) ----
+  std::vector<std::pair<std::string, plint>> layouts{
+      {"SpeciesLayoutAoS", 1},
+      {"SpeciesLayoutAoSoA4", 4},
+      {"SpeciesLayoutAoSoA8", 8},
+      {"SpeciesLayoutSoA", n * n}};
+  for (std::pair<std::string, plint> const &layout : layouts) {
+    if (!suite.selected(layout.first)) {
+      continue;
+    }
+    const plint numCells = n * n, width = layout.second;
+    const plint q = DESCRIPTOR<T>::q;
+    SpeciesCollisionCell<T, DESCRIPTOR> collision(
+        params.chi, params.mu, params.a, params.b, params.epsilon,
+        params.c_bulk, params.tau1, params.tau2, true);
+    // species at rest in the bath, phi = 1 in the first quarter of the cells
+    // whole blocks of width cells
+    std::vector<T> records((numCells + width - 1) / width * width *
+                           speciesRecord);
+    for (plint cell = 0; cell < numCells; ++cell) {
+      T *base = records.data() + (cell / width) * width * speciesRecord +
+                cell % width;
+      for (plint iPop = 0; iPop < q; ++iPop) {
+        base[iPop * width] = DESCRIPTOR<T>::t[iPop] * ((T)params.c_bulk - 1);
+        base[(q + iPop) * width] = base[iPop * width];
+      }
+      base[2 * q * width] = cell < numCells / 4 ? (T)1 : (T)0;
+    }
+    // c1 and c2 read and written, phi read
+    suite.measure(layout.first, n, (2 * speciesRecord - 1) * sizeof(T),
+                  speciesRecord * sizeof(T), [&]() {
+                    collideRecords(records, numCells, width, collision);
+                  });
+  }
+
+  if (suite.selected("PhiPcoupling2D")) {
+    std::unique_ptr<Lattice> phiLattice =
+        makeLattice(n, new phi<T, DESCRIPTOR>(params.M, params.zeta));
+    std::unique_ptr<Lattice> pLattice =
+        makeLattice(n, new DynamicsMomentum<T, DESCRIPTOR>(1. / params.tauP));
+    // mu and grad(phi) read, Fs written
+    suite.measure("PhiPcoupling2D", n, 5 * scalarBytes, 2 * latticeCellBytes,
+                  [&]() {
+                    applyProcessingFunctional(
+                        new PhiPcoupling2D<T, DESCRIPTOR>(), box, *phiLattice,
+                        *pLattice);
+                  });
+  }
+
+  // ---- collisions: populations read and written, externals read ----
+  if (suite.selected("DynamicsMomentum::collide") ||
+      suite.selected("collideAndStream") ||
+      suite.selected("CollideAndStream2D")) {
+    std::unique_ptr<Lattice> pLattice =
+        makeLattice(n, new DynamicsMomentum<T, DESCRIPTOR>(1. / params.tauP));
+    initializeAtEquilibrium(*pLattice, box, (T)1, zero);
+    const double bytes = 2 * populationBytes + 2 * scalarBytes;
+    if (suite.selected("DynamicsMomentum::collide")) {
+      suite.measure("DynamicsMomentum::collide", n, bytes, latticeCellBytes,
+                    [&]() { pLattice->collide(); });
+    }
+    if (suite.selected("collideAndStream")) {
+      suite.measure("collideAndStream", n, bytes, latticeCellBytes,
+                    [&]() { pLattice->collideAndStream(); });
+    }
+    // the same as a swap sweep, on slabs of the blocks with --threads
+    if (suite.selected("CollideAndStream2D")) {
+      std::unique_ptr<TileExecutor> executor;
+      if (threads > 1) {
+        executor.reset(new TileExecutor(threads, params.threadTileSize));
+      }
+      suite.measure("CollideAndStream2D", n, bytes, latticeCellBytes, [&]() {
+        applyProcessingFunctional(
+            new CollideAndStream2D<T, DESCRIPTOR>(executor.get()), box,
+            *pLattice);
+        pLattice->duplicateOverlaps(modif::staticVariables);
+      });
+    }
+  }
+
+  const PhaseCollision collisions[] = {PhaseCollision::bgk,
+                                       PhaseCollision::regularized,
+                                       PhaseCollision::trt};
+  const char *collisionNames[] = {"bgk", "regularized", "trt"};
+  for (int i = 0; i < 3; ++i) {
+    std::string name = std::string("phi::collide/") + collisionNames[i];
+    if (!suite.selected(name)) {
+      continue;
+    }
+    std::unique_ptr<Lattice> phiLattice = makeLattice(
+        n, new phi<T, DESCRIPTOR>(params.M, params.zeta, collisions[i]));
+    initializeDroplet(*phiLattice, n, params.zeta);
+    suite.measure(name, n, 2 * populationBytes + 2 * scalarBytes,
+                  latticeCellBytes, [&]() { phiLattice->collide(); });
+  }
+
+  if (suite.selected("custom_dynamics::collide")) {
+    std::unique_ptr<Lattice> lattice = makeLattice(
+        n, new custom_dynamics<T, DESCRIPTOR>(1. / params.tau1, params.chi,
+                                              params.mu));
+    initializeAtEquilibrium(*lattice, box, (T)params.c_bulk, zero);
+    suite.measure("custom_dynamics::collide", n, 2 * populationBytes,
+                  latticeCellBytes, [&]() { lattice->collide(); });
+  }
+
+  // ---- the whole coupled step ----
+  if (suite.selected("DropletModel::step")) {
+    DropletModel<T, DESCRIPTOR> model(params);
+    model.initialize();
+    // phi, c1, c2 and momentum populations read and written once per
+    // stage that sweeps them, plus the density and interface fields
+    const double bytes = 2 * populationBytes * 6 + 16 * scalarBytes;
+    suite.measure("DropletModel::step", n, bytes,
+                  4 * latticeCellBytes + scalarBytes, [&]() { model.step(); });
+  }
+}
+
+std::vector<plint> parseSizes(std::string const &list) {
+  std::vector<plint> sizes;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    sizes.push_back(std::stol(item));
+  }
+  return sizes;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  plbInit(&argc, &argv);
+
+  BenchOptions options;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    std::string value = argv[i + 1];
+    if (key == "--sizes") {
+      options.sizes = parseSizes(value);
+    } else if (key == "--min-time") {
+      options.minTime = std::stod(value);
+    } else if (key == "--repeats") {
+      options.repeats = std::max(1, std::stoi(value));
+    } else if (key == "--filter") {
+      options.filter = value;
+    } else if (key == "--out") {
+      options.out = value;
+    } else if (key == "--threads") {
+      options.threads = (unsigned)std::max(1, std::stoi(value));
+    } else {
+      pcout << "lbm_bench: unknown option " << key << std::endl;
+      return 1;
+    }
+  }
+
+  pcout << "lbm_bench on " << global::mpi().getSize() << " rank(s), SIMD "
+        << simdLevelName(activeSimdLevel()) << ", " << options.threads
+        << " thread(s) per rank" << std::endl;
+
+  BenchSuite suite(options);
+  for (plint n : options.sizes) {
+    runSize(suite, n, options.threads);
+  }
+  suite.writeJson(options.out);
+  pcout << "Results written to " << options.out << std::endl;
+  return 0;
+}
@@ -0,0 +1,18 @@
+#!/bin/bash
+# Runs lbm_bench once per MPI rank count and writes one JSON file each.
+#
+#   bench/run_bench.sh <lbm_bench> <output dir> [rank counts] [lbm_bench options]
+#
+# e.g. bench/run_bench.sh build/lbm_bench results/base "1 2 4" --sizes 64,256,1024
+# Compare two result directories with python/bench_compare.py.
+
+BENCH=${1:?path to lbm_bench}
+OUT_DIR=${2:?output directory}
+RANKS=${3:-"1 2 4"}
+shift $(( $# < 3 ? $# : 3 ))
+
+mkdir -p "$OUT_DIR"
+for np in $RANKS; do
+    echo "--> $np rank(s)"
+    mpirun -np "$np" "$BENCH" --out "$OUT_DIR/bench_np$np.json" "$@" || exit 1
+done
@@ -0,0 +1,92 @@
+#include "palabos2D.h"
+#include "palabos2D.hh"
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "Ensemble.h"
+
+using namespace plb;
+typedef double T;
+#define DESCRIPTOR descriptors::PhaseFieldD2Q9Descriptor
+
+// ---------------- Ensemble program ----------------
+// Arguments: table.csv [threads] [steps reportEvery]
+// Runs every row of the table as a droplet case of its own (see
+// readEnsembleTable() for the columns); steps and reportEvery are the
+// defaults for rows without those columns, threads = 0 uses every core.
+// With several ranks the cases are dealt out over the ranks, each running
+// its share on its own threads; launch one rank per node.
+int main(int argc, char *argv[]) {
+  plbInit(&argc, &argv);
+
+  if (global::argc() < 2) {
+    pcout << "Usage: ensemble table.csv [threads] [steps reportEvery]"
+          << std::endl;
+    return 1;
+  }
+  std::string tableFile;
+  global::argv(1).read(tableFile);
+  plint numThreads = 0;
+  if (global::argc() > 2) {
+    global::argv(2).read(numThreads);
+  }
+  EnsembleCase defaults;
+  if (global::argc() > 4) {
+    global::argv(3).read(defaults.steps);
+    global::argv(4).read(defaults.reportEvery);
+  }
+
+  std::vector<EnsembleCase> cases = readEnsembleTable(tableFile, defaults);
+  std::string prefix = "./data/ensemble/";
+  std::filesystem::create_directories(prefix);
+
+  EnsembleRunner<T, DESCRIPTOR> runner(cases, prefix, (unsigned)numThreads);
+  pcout << "Ensemble of " << cases.size() << " case(s) from " << tableFile
+        << " on " << global::mpi().getSize() << " rank(s)" << std::endl;
+
+  global::timer("ensemble").start();
+  std::vector<EnsembleResult> results = runner.run();
+  double seconds = global::timer("ensemble").stop();
+
+  // one summary per rank, like the snapshots
+  std::string summaryFile =
+      prefix + "summary" +
+      createFileName("_p", global::mpi().getRank(), 4) + ".csv";
+  std::ofstream summary(summaryFile.c_str());
+  summary << "label,steps,seconds,mass,radius,interfaceLength,c1Inside,"
+             "c1Outside,c2Inside,c2Outside,maxVelocity,error\n";
+  double completed = 0, cellSteps = 0;
+  for (EnsembleResult const &result : results) {
+    summary << result.label << "," << result.steps << "," << result.seconds
+            << "," << result.last.mass << "," << result.last.radius << ","
+            << result.last.interfaceLength << "," << result.last.c1Inside
+            << "," << result.last.c1Outside << "," << result.last.c2Inside
+            << "," << result.last.c2Outside << "," << result.last.maxVelocity
+            << ",\"" << result.error << "\"\n";
+    if (result.error.empty()) {
+      completed += 1;
+    } else {
+      std::cout << "case " << result.label << " failed: " << result.error
+                << std::endl;
+    }
+  }
+  for (EnsembleCase const &c : cases) {
+    cellSteps += (double)(c.params.nx * c.params.ny) * (double)c.steps;
+  }
+#ifdef PLB_MPI_PARALLEL
+  MPI_Allreduce(MPI_IN_PLACE, &completed, 1, MPI_DOUBLE, MPI_SUM,
+                global::mpi().getGlobalCommunicator());
+  MPI_Allreduce(MPI_IN_PLACE, &seconds, 1, MPI_DOUBLE, MPI_MAX,
+                global::mpi().getGlobalCommunicator());
+#endif
+
+  pcout << completed << "/" << cases.size() << " case(s) completed in "
+        << seconds << " s: " << std::setprecision(4)
+        << completed * 3600. / seconds << " cases/hour, about "
+        << cellSteps / seconds * 1e-6 << " Mcell steps/s" << std::endl;
+  return 0;
+}
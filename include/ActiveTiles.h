@@ -0,0 +1,242 @@
+#ifndef ACTIVE_TILES_H
+#define ACTIVE_TILES_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include "D2Q9Kernels.h"
+#include "ReactionKinetics.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace plb;
+
+// Activity mask over square tiles of the global domain. A tile is busy if
+// one of its cells is away from equilibrium (see
+// UpdateActiveTilesFunctional2D); it is active if it or one of its eight
+// neighbours is busy. Information travels at most one cell per step, so a
+// mask refreshed at least every tileSize steps wakes a tile before a front
+// reaches it. Every rank holds the whole mask.
+class ActiveTiles {
+public:
+  // Without combineRanks the busy tiles are not exchanged between ranks,
+  // for a domain held entirely by one process.
+  ActiveTiles(Box2D domain, plint tileSize, bool combineRanks = true);
+
+  plint getTileSize() const { return tileSize_; }
+  plint getNumTiles() const { return numTilesX_ * numTilesY_; }
+  plint getNumActive() const { return numActive_; }
+  bool isActive(plint tileX, plint tileY) const {
+    return active_[tileX * numTilesY_ + tileY] != 0;
+  }
+
+  // Starts a refresh: all tiles quiescent until marked busy.
+  void beginUpdate();
+  // Marks the tile of the global cell (x, y) busy.
+  void markBusy(plint x, plint y) {
+    busy_[tileX(x) * numTilesY_ + tileY(y)] = 1;
+  }
+  bool isBusy(plint x, plint y) const {
+    return busy_[tileX(x) * numTilesY_ + tileY(y)] != 0;
+  }
+  // Combines the busy tiles of all ranks and dilates them into the mask.
+  void finishUpdate();
+  void activateAll();
+
+  // Calls f(box) for the parts of domain, given in the local coordinates of
+  // a block at location, that lie in active tiles. Runs of active tiles
+  // along y are merged into one box. Cells outside the global domain (the
+  // envelope at its edge) belong to the nearest tile.
+  template <class F>
+  void forEachActiveBox(Box2D domain, Dot2D location, F f) const {
+    for (plint x0 = domain.x0; x0 <= domain.x1;) {
+      plint tx = tileX(x0 + location.x);
+      plint x1 = std::min(domain.x1, lastX(tx) - location.x);
+      plint runBegin = -1;
+      for (plint y0 = domain.y0; y0 <= domain.y1;) {
+        plint ty = tileY(y0 + location.y);
+        plint y1 = std::min(domain.y1, lastY(ty) - location.y);
+        if (isActive(tx, ty) && runBegin < 0) {
+          runBegin = y0;
+        } else if (!isActive(tx, ty) && runBegin >= 0) {
+          f(Box2D(x0, x1, runBegin, y0 - 1));
+          runBegin = -1;
+        }
+        y0 = y1 + 1;
+      }
+      if (runBegin >= 0) {
+        f(Box2D(x0, x1, runBegin, domain.y1));
+      }
+      x0 = x1 + 1;
+    }
+  }
+
+  // Calls f(box, tileX, tileY) for every intersection of domain with a tile.
+  template <class F>
+  void forEachTile(Box2D domain, Dot2D location, F f) const {
+    for (plint x0 = domain.x0; x0 <= domain.x1;) {
+      plint tx = tileX(x0 + location.x);
+      plint x1 = std::min(domain.x1, lastX(tx) - location.x);
+      for (plint y0 = domain.y0; y0 <= domain.y1;) {
+        plint ty = tileY(y0 + location.y);
+        plint y1 = std::min(domain.y1, lastY(ty) - location.y);
+        f(Box2D(x0, x1, y0, y1), tx, ty);
+        y0 = y1 + 1;
+      }
+      x0 = x1 + 1;
+    }
+  }
+
+private:
+  plint tileX(plint x) const {
+    return std::min(std::max((x - domain_.x0) / tileSize_, (plint)0),
+                    numTilesX_ - 1);
+  }
+  plint tileY(plint y) const {
+    return std::min(std::max((y - domain_.y0) / tileSize_, (plint)0),
+                    numTilesY_ - 1);
+  }
+  // last global coordinate of a tile; the edge tiles extend to infinity
+  plint lastX(plint tx) const {
+    return (tx == numTilesX_ - 1) ? std::numeric_limits<plint>::max() / 2
+                                  : domain_.x0 + (tx + 1) * tileSize_ - 1;
+  }
+  plint lastY(plint ty) const {
+    return (ty == numTilesY_ - 1) ? std::numeric_limits<plint>::max() / 2
+                                  : domain_.y0 + (ty + 1) * tileSize_ - 1;
+  }
+
+  Box2D domain_;
+  plint tileSize_;
+  bool combineRanks_;
+  plint numTilesX_, numTilesY_;
+  std::vector<int> busy_;
+  std::vector<char> active_;
+  plint numActive_;
+};
+
+// Refreshes the busy tiles from the state of {c1, c2, phi}. A cell is at
+// equilibrium when phi is pure (within tolerance of 0 or 1), both species
+// carry no diffusive flux and their reaction rates vanish. Scanning a tile
+// stops at its first busy cell. Apply on the bulk, between
+// ActiveTiles::beginUpdate() and finishUpdate().
+template <typename T, template <typename U> class Descriptor>
+class UpdateActiveTilesFunctional2D
+    : public LatticeBoxProcessingFunctional2D<T, Descriptor> {
+public:
+  typedef typename ComputeType<T>::type C;
+
+  UpdateActiveTilesFunctional2D(ActiveTiles *tiles,
+                                ReactionKinetics<C> const &kinetics,
+                                C tolerance)
+      : tiles_(tiles), kinetics_(kinetics), tolerance_(tolerance) {}
+
+  void process(Box2D domain,
+               std::vector<BlockLattice2D<T, Descriptor> *> lattices) override {
+    PLB_PRECONDITION(lattices.size() == 3);
+    BlockLattice2D<T, Descriptor> &lattice1 = *lattices[0];
+    BlockLattice2D<T, Descriptor> &lattice2 = *lattices[1];
+    BlockLattice2D<T, Descriptor> &phiLattice = *lattices[2];
+    Dot2D location = lattice1.getLocation();
+
+    tiles_->forEachTile(domain, location, [&](Box2D box, plint, plint) {
+      if (tiles_->isBusy(box.x0 + location.x, box.y0 + location.y)) {
+        return; // marked by another block
+      }
+      for (plint iX = box.x0; iX <= box.x1; ++iX) {
+        for (plint iY = box.y0; iY <= box.y1; ++iY) {
+          if (!atEquilibrium(&lattice1.get(iX, iY)[0],
+                             &lattice2.get(iX, iY)[0],
+                             phiLattice.get(iX, iY).computeDensity())) {
+            tiles_->markBusy(iX + location.x, iY + location.y);
+            return;
+          }
+        }
+      }
+    });
+  }
+
+  UpdateActiveTilesFunctional2D<T, Descriptor> *clone() const override {
+    return new UpdateActiveTilesFunctional2D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::nothing;
+    modified[1] = modif::nothing;
+    modified[2] = modif::nothing;
+  }
+
+private:
+  bool atEquilibrium(T const *stored1, T const *stored2, T phiStored) const {
+    typedef D2Q9Kernels<C> K;
+    const C phi = (C)phiStored;
+    if (std::min(std::abs(phi), std::abs((C)1 - phi)) > tolerance_) {
+      return false;
+    }
+    C f1[K::q], f2[K::q];
+    K::load(stored1, f1);
+    K::load(stored2, f2);
+    C rhoBar1, jx1, jy1, rhoBar2, jx2, jy2;
+    K::rhoBarJ(f1, rhoBar1, jx1, jy1);
+    K::rhoBarJ(f2, rhoBar2, jx2, jy2);
+    if (std::abs(jx1) + std::abs(jy1) + std::abs(jx2) + std::abs(jy2) >
+        tolerance_) {
+      return false;
+    }
+    C r1, r2;
+    kinetics_.rates(phi >= (C)0.5, Descriptor<C>::fullRho(rhoBar1),
+                    Descriptor<C>::fullRho(rhoBar2), r1, r2);
+    return std::abs(r1) + std::abs(r2) <= tolerance_;
+  }
+
+  ActiveTiles *tiles_;
+  ReactionKinetics<C> kinetics_;
+  C tolerance_;
+};
+
+// Restricts a box functional to the active tiles: the wrapped functional
+// only sees the parts of its domain that lie in active tiles. Suited to
+// cell-local updates and stencils whose result in a quiescent tile would
+// not change.
+class TiledFunctional2D : public BoxProcessingFunctional2D {
+public:
+  TiledFunctional2D(BoxProcessingFunctional2D *functional,
+                    ActiveTiles const *tiles)
+      : functional_(functional), tiles_(tiles) {}
+
+  TiledFunctional2D(TiledFunctional2D const &rhs)
+      : BoxProcessingFunctional2D(rhs), functional_(rhs.functional_->clone()),
+        tiles_(rhs.tiles_) {}
+
+  ~TiledFunctional2D() override { delete functional_; }
+
+  void process(Box2D domain, std::vector<AtomicBlock2D *> blocks) override {
+    tiles_->forEachActiveBox(domain, blocks[0]->getLocation(),
+                             [&](Box2D box) {
+                               functional_->process(box, blocks);
+                             });
+  }
+
+  TiledFunctional2D *clone() const override {
+    return new TiledFunctional2D(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    functional_->getTypeOfModification(modified);
+  }
+
+  BlockDomain::DomainT appliesTo() const override {
+    return functional_->appliesTo();
+  }
+
+private:
+  TiledFunctional2D &operator=(TiledFunctional2D const &);
+
+  BoxProcessingFunctional2D *functional_;
+  ActiveTiles const *tiles_;
+};
+
+#endif
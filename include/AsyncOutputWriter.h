@@ -0,0 +1,133 @@
+#ifndef ASYNC_OUTPUT_WRITER_H
+#define ASYNC_OUTPUT_WRITER_H
+
+#include "LiveView.h"
+#include "SnapshotIO.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes snapshots on a background thread so that the solver does not wait
+// for encoding and disk I/O. At an output step the solver acquires one of a
+// fixed pool of SnapshotFrame buffers, stages the fields it wants into it (a
+// plain copy of its local blocks), submits it and keeps stepping.
+//
+// Every process writes its own blocks to
+//   <prefix>snapshot_<step>_p<rank>.lbm
+// with writeSnapshotLocal(), plus an optional greyscale preview of one
+// scalar field. The writer thread makes no MPI calls.
+//
+// When every buffer is still queued or being written, acquire() applies the
+// backpressure policy:
+//   block    wait until the writer releases a buffer
+//   drop     skip this frame
+//   coarsen  skip this frame and double the output interval; the interval
+//            is halved again once the writer has drained its queue after
+//            drainedToRefine frames in a row, so that it does not flip
+//            between two values on alternate frames
+// With drop and coarsen, acquire() and acquireLive() are collective: a frame
+// is skipped on every process when one of them has no free buffer, and the
+// interval is halved only once every writer has drained, so that each step
+// is written by all processes or by none.
+//
+// With a LiveView attached, the writer thread also publishes every frame to
+// it. Frames taken with acquireLive() only go to the live view; they never
+// wait for a buffer and are not written to disk.
+class AsyncOutputWriter {
+public:
+  enum class Backpressure { block, drop, coarsen };
+  static const plint drainedToRefine = 4;
+
+  struct Statistics {
+    plint submitted = 0, written = 0, dropped = 0;
+    // solver side: staging copies, and waiting for a free buffer
+    double stagingSeconds = 0, blockedSeconds = 0;
+    // writer side: encoding and writing, per frame and in total
+    double writeSeconds = 0, maxWriteSeconds = 0;
+    double bytesWritten = 0;
+    // current stride between accepted frames (coarsen only)
+    plint interval = 1;
+    // frames published to the live view, and live-only frames skipped for
+    // lack of a free buffer
+    plint livePublished = 0, liveSkipped = 0;
+  };
+
+  AsyncOutputWriter(std::string const &prefix, plint numBuffers = 2,
+                    Backpressure policy = Backpressure::block,
+                    SnapshotOptions const &options = SnapshotOptions());
+  // Writes the frames still queued, then stops the writer thread.
+  ~AsyncOutputWriter();
+
+  AsyncOutputWriter(AsyncOutputWriter const &) = delete;
+  AsyncOutputWriter &operator=(AsyncOutputWriter const &) = delete;
+
+  // Writes <prefix>preview_<step>_p<rank>.pgm of the named scalar field with
+  // every frame; an empty name disables the preview.
+  void setPreview(std::string const &fieldName);
+  // Publishes every following frame to view, which must outlive the writer;
+  // nullptr detaches it.
+  void setLiveView(LiveView *view);
+
+  // Frame to stage step iT into, or nullptr if the policy skips this frame.
+  // Rethrows on the solver thread an error raised by an earlier write.
+  SnapshotFrame *acquire(plint iT);
+  // Frame for the live view only, or nullptr without a live view or when
+  // some process has no free buffer.
+  SnapshotFrame *acquireLive(plint iT);
+  // Hands a frame obtained from acquire() or acquireLive() to the writer
+  // thread.
+  void submit(SnapshotFrame *frame);
+  // Waits until every submitted frame is on disk.
+  void flush();
+
+  Statistics getStatistics() const;
+  static std::string policyName(Backpressure policy);
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Job {
+    SnapshotFrame *frame;
+    bool persist;
+  };
+
+  void run();
+  void writeFrame(SnapshotFrame const &frame, std::string const &preview,
+                  double &bytes) const;
+  void writePreview(SnapshotFrame const &frame,
+                    std::string const &fieldName) const;
+  void rethrowWriterError();
+
+  std::string prefix_;
+  Backpressure policy_;
+  SnapshotOptions options_;
+  std::string preview_;
+  LiveView *live_ = nullptr;
+  int rank_;
+
+  std::vector<SnapshotFrame> buffers_;
+  std::vector<SnapshotFrame *> free_;
+  std::deque<Job> queue_;
+  // whether the frame being staged goes to disk; one is staged at a time
+  bool stagingPersist_ = true;
+  bool writing_ = false;
+  bool stop_ = false;
+  plint offered_ = 0;
+  // frames in a row after which the writer found its queue empty (coarsen)
+  plint drained_ = 0;
+  std::exception_ptr error_;
+  Statistics stats_;
+  Clock::time_point stagingBegin_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable queued_;
+  std::condition_variable released_;
+  std::thread worker_;
+};
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace plb;
+
+// Raw binary checkpoint of lattices that share one geometry (extension
+// .lbmc).
+//
+// Layout, little-endian:
+//   char[8]  magic "LBMCKPT"
+//   uint32   version, header size in bytes (before padding)
+//   int64    nx, ny, step
+//   uint32   number of lattices, populations q, external scalars,
+//            bytes per value
+//   lattices: uint16 name length, name
+// then, starting at the next multiple of checkpointAlignment, one dense
+// array per lattice in header order, each again aligned:
+//   value[iX][iY][k], global coordinates, y fastest, k < q + externals
+// Populations are stored as Palabos keeps them (f_i - t_i), followed by the
+// external scalars in descriptor order. A reader can mmap the file and index
+// a lattice directly; python/lbm_checkpoint.py does so with numpy.memmap.
+//
+// The layout depends only on the global geometry, so a checkpoint written
+// by one number of processes restarts on any other.
+
+const std::uint64_t checkpointAlignment = 4096;
+
+struct CheckpointHeader {
+  plint nx = 0, ny = 0, step = 0;
+  plint numPopulations = 0, numScalars = 0, bytesPerValue = 0;
+  std::vector<std::string> lattices;
+
+  plint cellSize() const { return numPopulations + numScalars; }
+  std::uint64_t latticeBytes() const;
+  // File offset of the array of lattice iLattice.
+  std::uint64_t latticeOffset(plint iLattice) const;
+  // Index of the named lattice, or -1.
+  plint find(std::string const &name) const;
+};
+
+// A contiguous range of the file and where it lives in the local buffer.
+struct CheckpointSpan {
+  std::uint64_t fileOffset;
+  std::uint64_t bufferOffset;
+  std::uint64_t length;
+};
+
+// Collective. Process 0 writes the header; every process writes its spans.
+void writeCheckpointData(std::string const &fileName,
+                         CheckpointHeader const &header,
+                         std::vector<CheckpointSpan> const &spans,
+                         std::vector<char> const &buffer);
+
+// Collective. Process 0 reads the header and broadcasts it.
+CheckpointHeader readCheckpointHeader(std::string const &fileName);
+
+// Collective. Fills the spans of the local buffer from the file.
+void readCheckpointData(std::string const &fileName,
+                        std::vector<CheckpointSpan> const &spans,
+                        std::vector<char> &buffer);
+
+// ---- Packing of multi-block lattices (local blocks only) ----
+
+namespace checkpoint_detail {
+
+// Calls visit(component, iX, iY0, numY, fileOffset) for every x-column of
+// every local block; the column is contiguous in the file.
+template <typename T, template <typename U> class Descriptor, class Visit>
+void visitColumns(MultiBlockLattice2D<T, Descriptor> &lattice,
+                  CheckpointHeader const &header, plint iLattice,
+                  Visit visit) {
+  MultiBlockManagement2D const &management = lattice.getMultiBlockManagement();
+  std::uint64_t base = header.latticeOffset(iLattice);
+  std::uint64_t cellBytes = header.cellSize() * sizeof(T);
+  for (plint blockId : management.getLocalInfo().getBlocks()) {
+    Box2D bulk;
+    management.getSparseBlockStructure().getBulk(blockId, bulk);
+    BlockLattice2D<T, Descriptor> &component = lattice.getComponent(blockId);
+    Dot2D location = component.getLocation();
+    for (plint iX = bulk.x0; iX <= bulk.x1; ++iX) {
+      std::uint64_t offset =
+          base + (std::uint64_t)(iX * header.ny + bulk.y0) * cellBytes;
+      visit(component, iX - location.x, bulk.y0 - location.y, bulk.getNy(),
+            offset);
+    }
+  }
+}
+
+template <typename T, template <typename U> class Descriptor>
+CheckpointHeader makeHeader(
+    plint step,
+    std::vector<std::pair<std::string, MultiBlockLattice2D<T, Descriptor> *>>
+        const &lattices) {
+  PLB_PRECONDITION(!lattices.empty());
+  CheckpointHeader header;
+  header.nx = lattices[0].second->getNx();
+  header.ny = lattices[0].second->getNy();
+  header.step = step;
+  header.numPopulations = Descriptor<T>::q;
+  header.numScalars = Descriptor<T>::ExternalField::numScalars;
+  header.bytesPerValue = sizeof(T);
+  for (auto const &entry : lattices) {
+    PLB_PRECONDITION(entry.second->getNx() == header.nx &&
+                     entry.second->getNy() == header.ny);
+    header.lattices.push_back(entry.first);
+  }
+  return header;
+}
+
+} // namespace checkpoint_detail
+
+// Populations and external scalars of the bulk of every lattice.
+template <typename T, template <typename U> class Descriptor>
+void saveCheckpoint(
+    std::string const &fileName, plint step,
+    std::vector<std::pair<std::string, MultiBlockLattice2D<T, Descriptor> *>>
+        const &lattices) {
+  CheckpointHeader header = checkpoint_detail::makeHeader(step, lattices);
+  const plint q = header.numPopulations;
+  const plint numScalars = header.numScalars;
+
+  std::vector<CheckpointSpan> spans;
+  std::vector<char> buffer;
+  for (pluint iLattice = 0; iLattice < lattices.size(); ++iLattice) {
+    checkpoint_detail::visitColumns(
+        *lattices[iLattice].second, header, iLattice,
+        [&](BlockLattice2D<T, Descriptor> &component, plint iX, plint iY0,
+            plint numY, std::uint64_t fileOffset) {
+          std::uint64_t length = numY * header.cellSize() * sizeof(T);
+          spans.push_back(CheckpointSpan{fileOffset, buffer.size(), length});
+          buffer.resize(buffer.size() + length);
+          T *values = reinterpret_cast<T *>(&buffer[buffer.size() - length]);
+          for (plint iY = iY0; iY < iY0 + numY; ++iY) {
+            Cell<T, Descriptor> &cell = component.get(iX, iY);
+            for (plint iPop = 0; iPop < q; ++iPop) {
+              *values++ = cell[iPop];
+            }
+            T const *external = cell.getExternal(0);
+            for (plint iScalar = 0; iScalar < numScalars; ++iScalar) {
+              *values++ = external[iScalar];
+            }
+          }
+        });
+  }
+  writeCheckpointData(fileName, header, spans, buffer);
+}
+
+// Restores the named lattices from a checkpoint, refreshes their envelopes
+// and returns the step at which it was written. The process count and
+// block distribution may differ from the run that wrote it.
+template <typename T, template <typename U> class Descriptor>
+plint loadCheckpoint(
+    std::string const &fileName,
+    std::vector<std::pair<std::string, MultiBlockLattice2D<T, Descriptor> *>>
+        const &lattices) {
+  CheckpointHeader header = readCheckpointHeader(fileName);
+  CheckpointHeader expected =
+      checkpoint_detail::makeHeader(header.step, lattices);
+  if (header.nx != expected.nx || header.ny != expected.ny ||
+      header.numPopulations != expected.numPopulations ||
+      header.numScalars != expected.numScalars ||
+      header.bytesPerValue != expected.bytesPerValue) {
+    throw PlbIOException("Checkpoint " + fileName +
+                         " does not match the lattice geometry, descriptor "
+                         "or floating-point type");
+  }
+  const plint q = header.numPopulations;
+  const plint numScalars = header.numScalars;
+
+  std::vector<plint> indices;
+  std::vector<CheckpointSpan> spans;
+  std::uint64_t bufferSize = 0;
+  for (auto const &entry : lattices) {
+    plint iLattice = header.find(entry.first);
+    if (iLattice < 0) {
+      throw PlbIOException("Checkpoint " + fileName + " has no lattice " +
+                           entry.first);
+    }
+    indices.push_back(iLattice);
+    checkpoint_detail::visitColumns(
+        *entry.second, header, iLattice,
+        [&](BlockLattice2D<T, Descriptor> &, plint, plint, plint numY,
+            std::uint64_t fileOffset) {
+          std::uint64_t length = numY * header.cellSize() * sizeof(T);
+          spans.push_back(CheckpointSpan{fileOffset, bufferSize, length});
+          bufferSize += length;
+        });
+  }
+
+  std::vector<char> buffer(bufferSize);
+  readCheckpointData(fileName, spans, buffer);
+
+  std::uint64_t position = 0;
+  for (pluint i = 0; i < lattices.size(); ++i) {
+    checkpoint_detail::visitColumns(
+        *lattices[i].second, header, indices[i],
+        [&](BlockLattice2D<T, Descriptor> &component, plint iX, plint iY0,
+            plint numY, std::uint64_t) {
+          T const *values = reinterpret_cast<T const *>(&buffer[position]);
+          for (plint iY = iY0; iY < iY0 + numY; ++iY) {
+            Cell<T, Descriptor> &cell = component.get(iX, iY);
+            for (plint iPop = 0; iPop < q; ++iPop) {
+              cell[iPop] = *values++;
+            }
+            T *external = cell.getExternal(0);
+            for (plint iScalar = 0; iScalar < numScalars; ++iScalar) {
+              external[iScalar] = *values++;
+            }
+          }
+          position += numY * header.cellSize() * sizeof(T);
+        });
+    lattices[i].second->duplicateOverlaps(modif::staticVariables);
+  }
+  return header.step;
+}
+
+#endif
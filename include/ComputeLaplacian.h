@@ -3,17 +3,25 @@
 
 #include "palabos2D.h"
 #include "palabos2D.hh"
+#include "FieldStencil.h"
+#include <algorithm>
+#include <type_traits>
 
 using namespace plb;
 
 template <typename T>
 class BoxLaplacianFunctional2D
-    : public BoundedBoxProcessingFunctional2D_ST<T, T, 1> {
+    : public BoundedBoxProcessingFunctional2D_SS<T, T> {
 public:
   void processBulk(Box2D domain, ScalarField2D<T> &phi,
                    ScalarField2D<T> &laplacian) override {
-    for (plint iX = domain.x0 + 1; iX <= domain.x1 - 1; ++iX) {
-      for (plint iY = domain.y0 + 1; iY <= domain.y1 - 1; ++iY) {
+    // contiguous rows through the SIMD stencil engine
+    if constexpr (std::is_same<T, double>::value) {
+      applyRowStencil(LaplacianStencil(), domain, phi, laplacian);
+      return;
+    }
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
         T center = phi.get(iX, iY);
         T lap = (phi.get(iX + 1, iY) + phi.get(iX - 1, iY) +
                  phi.get(iX, iY + 1) + phi.get(iX, iY - 1) - 4.0 * center);
@@ -22,14 +30,25 @@ public:
     }
   }
 
+  // Neighbours outside the field are clamped to its edge.
   void processEdge(int, int, Box2D domain, ScalarField2D<T> &phi,
                    ScalarField2D<T> &laplacian) override {
-    processBulk(domain, phi, laplacian);
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      plint xm = std::max((plint)(iX - 1), (plint)0);
+      plint xp = std::min((plint)(iX + 1), (plint)(phi.getNx() - 1));
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        plint ym = std::max((plint)(iY - 1), (plint)0);
+        plint yp = std::min((plint)(iY + 1), (plint)(phi.getNy() - 1));
+        laplacian.get(iX, iY) = phi.get(xp, iY) + phi.get(xm, iY) +
+                                phi.get(iX, yp) + phi.get(iX, ym) -
+                                4.0 * phi.get(iX, iY);
+      }
+    }
   }
 
   void processCorner(int, int, Box2D domain, ScalarField2D<T> &phi,
                      ScalarField2D<T> &laplacian) override {
-    processBulk(domain, phi, laplacian);
+    processEdge(0, 0, domain, phi, laplacian);
   }
 
   BoxLaplacianFunctional2D<T> *clone() const override {
@@ -38,7 +57,8 @@ public:
 
   void
   getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
-    modified.push_back(modif::staticVariables);
+    modified[0] = modif::nothing;         // phi is read only
+    modified[1] = modif::staticVariables; // result
   }
 
   BlockDomain::DomainT appliesTo() const override {
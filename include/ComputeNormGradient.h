@@ -3,8 +3,10 @@
 
 #include "palabos2D.h"
 #include "palabos2D.hh"
+#include "FieldStencil.h"
 #include <algorithm>
 #include <cmath>
+#include <type_traits>
 
 using namespace plb;
 
@@ -15,8 +17,13 @@ public:
   // ------------------- BULK REGION -------------------
   virtual void processBulk(Box2D domain, ScalarField2D<T> &phi,
                            TensorField2D<T, 2> &normGrad) override {
-    for (plint iX = domain.x0 + 1; iX <= domain.x1 - 1; ++iX) {
-      for (plint jY = domain.y0 + 1; jY <= domain.y1 - 1; ++jY) {
+    // contiguous rows through the SIMD stencil engine
+    if constexpr (std::is_same<T, double>::value) {
+      applyRowStencil(NormGradientStencil(), domain, phi, normGrad);
+      return;
+    }
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint jY = domain.y0; jY <= domain.y1; ++jY) {
 
         // Central difference approximation
         T dphidx = (phi.get(iX + 1, jY) - phi.get(iX - 1, jY)) / (T)2;
@@ -73,7 +80,8 @@ public:
   // variables
   virtual void
   getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
-    modified.push_back(modif::staticVariables);
+    modified[0] = modif::nothing;         // phi is read only
+    modified[1] = modif::staticVariables; // result
   }
 
   virtual BlockDomain::DomainT appliesTo() const override {
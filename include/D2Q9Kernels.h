@@ -0,0 +1,62 @@
+#ifndef D2Q9_KERNELS_H
+#define D2Q9_KERNELS_H
+
+#include <utility>
+
+#include "LatticeKernels.h"
+
+// LatticeKernels of D2Q9 with the scalar 2D interface of the 2D-only
+// functionals (interface stencil, active tiles, refinement) and the SIMD row
+// engine: the lattice velocities as cx and cy tables, and moments and
+// equilibria with x and y components in place of T[2] vectors. The velocity
+// ordering follows plb::descriptors::D2Q9Descriptor, so the kernels work
+// directly on the raw populations of a Cell (Palabos stores f_i - t_i).
+template <typename T>
+struct D2Q9Kernels : public LatticeKernels<T, D2Q9Stencil> {
+  typedef LatticeKernels<T, D2Q9Stencil> Base;
+  using Base::q;
+
+  static constexpr std::array<int, q> cx =
+      lattice_kernels_detail::components<D2Q9Stencil, 0>(
+          std::make_integer_sequence<int, q>{});
+  static constexpr std::array<int, q> cy =
+      lattice_kernels_detail::components<D2Q9Stencil, 1>(
+          std::make_integer_sequence<int, q>{});
+
+  using Base::guoForcing;
+  using Base::phaseFieldEquilibria;
+  using Base::reactionDiffusionEquilibria;
+  using Base::rhoBarJ;
+  using Base::secondOrderEquilibria;
+
+  static inline void rhoBarJ(T const *f, T &rhoBar, T &jx, T &jy) {
+    T j[2];
+    Base::rhoBarJ(f, rhoBar, j);
+    jx = j[0];
+    jy = j[1];
+  }
+
+  static inline void secondOrderEquilibria(T rho, T ux, T uy, T *feq) {
+    const T u[2] = {ux, uy};
+    Base::secondOrderEquilibria(rho, u, feq);
+  }
+
+  static inline void reactionDiffusionEquilibria(T rho, T ux, T uy, T chiMu,
+                                                 T *feq) {
+    const T u[2] = {ux, uy};
+    Base::reactionDiffusionEquilibria(rho, u, chiMu, feq);
+  }
+
+  static inline void phaseFieldEquilibria(T rho, T ux, T uy, T nx, T ny, T M,
+                                          T zeta, T *feq) {
+    const T u[2] = {ux, uy}, n[2] = {nx, ny};
+    Base::phaseFieldEquilibria(rho, u, n, M, zeta, feq);
+  }
+
+  static inline void guoForcing(T ux, T uy, T Fx, T Fy, T *S) {
+    const T u[2] = {ux, uy}, F[2] = {Fx, Fy};
+    Base::guoForcing(u, F, S);
+  }
+};
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef DROPLET_DIAGNOSTICS_H
+#define DROPLET_DIAGNOSTICS_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "D2Q9Kernels.h"
+#include "phase_field_descriptor.h"
+
+using namespace plb;
+
+// Scalar state of a droplet run at one step, cheap enough to record every
+// few steps instead of dumping fields. Species inside and outside are
+// weighted with phi and 1 - phi, so each pair adds up to the total.
+struct DropletDiagnostics {
+  plint step = 0;
+  // integral of phi (droplet area), its centroid and the radius of the
+  // disc with that area
+  double mass = 0;
+  double centroidX = 0, centroidY = 0;
+  double radius = 0;
+  // integral of |grad phi|: the length of a resolved interface, since phi
+  // changes by one across it
+  double interfaceLength = 0;
+  double c1Inside = 0, c1Outside = 0;
+  double c2Inside = 0, c2Outside = 0;
+  double maxVelocity = 0;
+
+  static std::string csvHeader();
+  std::string csvRow() const;
+};
+
+// Partial sums of DropletDiagnosticsFunctional2D on one process.
+struct DiagnosticsSums {
+  double phi = 0, phiX = 0, phiY = 0, gradNorm = 0;
+  double c1Inside = 0, c1Outside = 0, c2Inside = 0, c2Outside = 0;
+  double maxVelocitySqr = 0;
+
+  // Combines the sums of all ranks into every rank.
+  void allReduce();
+  DropletDiagnostics finish(plint step) const;
+};
+
+// One pass over {phi, c1, c2, momentum} accumulating the sums of
+// DropletDiagnostics for the local blocks. Reads the phi gradient from the
+// externals left by the interface stencil. Apply on the bulk.
+template <typename T, template <typename U> class Descriptor>
+class DropletDiagnosticsFunctional2D
+    : public LatticeBoxProcessingFunctional2D<T, Descriptor> {
+public:
+  explicit DropletDiagnosticsFunctional2D(DiagnosticsSums *sums)
+      : sums_(sums) {}
+
+  void process(Box2D domain,
+               std::vector<BlockLattice2D<T, Descriptor> *> lattices) override {
+    PLB_PRECONDITION(lattices.size() == 4);
+    typedef typename ComputeType<T>::type C;
+    typedef D2Q9Kernels<C> K;
+    BlockLattice2D<T, Descriptor> &phiLattice = *lattices[0];
+    BlockLattice2D<T, Descriptor> &lattice1 = *lattices[1];
+    BlockLattice2D<T, Descriptor> &lattice2 = *lattices[2];
+    BlockLattice2D<T, Descriptor> &pLattice = *lattices[3];
+    Dot2D location = phiLattice.getLocation();
+    // c1 and c2 may have a wider envelope (temporal blocking)
+    Dot2D offset1 = computeRelativeDisplacement(phiLattice, lattice1);
+    Dot2D offset2 = computeRelativeDisplacement(phiLattice, lattice2);
+
+    DiagnosticsSums sums;
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        Cell<T, Descriptor> &cellPhi = phiLattice.get(iX, iY);
+        C f[K::q];
+        C rhoBar, jx, jy;
+        K::load(&cellPhi[0], f);
+        K::rhoBarJ(f, rhoBar, jx, jy);
+        const double phi = (double)Descriptor<C>::fullRho(rhoBar);
+
+        K::load(&lattice1.get(iX + offset1.x, iY + offset1.y)[0], f);
+        K::rhoBarJ(f, rhoBar, jx, jy);
+        const double c1 = (double)Descriptor<C>::fullRho(rhoBar);
+        K::load(&lattice2.get(iX + offset2.x, iY + offset2.y)[0], f);
+        K::rhoBarJ(f, rhoBar, jx, jy);
+        const double c2 = (double)Descriptor<C>::fullRho(rhoBar);
+
+        K::load(&pLattice.get(iX, iY)[0], f);
+        K::rhoBarJ(f, rhoBar, jx, jy);
+        const double rho = (double)Descriptor<C>::fullRho(rhoBar);
+        const double uSqr = (double)(jx * jx + jy * jy) / (rho * rho);
+
+        T const *grad = cellPhi.getExternal(PHI_GRAD_FIELD);
+        sums.phi += phi;
+        sums.phiX += phi * (double)(iX + location.x);
+        sums.phiY += phi * (double)(iY + location.y);
+        sums.gradNorm += std::sqrt((double)grad[0] * (double)grad[0] +
+                                   (double)grad[1] * (double)grad[1]);
+        sums.c1Inside += phi * c1;
+        sums.c1Outside += (1. - phi) * c1;
+        sums.c2Inside += phi * c2;
+        sums.c2Outside += (1. - phi) * c2;
+        sums.maxVelocitySqr = std::max(sums.maxVelocitySqr, uSqr);
+      }
+    }
+
+    sums_->phi += sums.phi;
+    sums_->phiX += sums.phiX;
+    sums_->phiY += sums.phiY;
+    sums_->gradNorm += sums.gradNorm;
+    sums_->c1Inside += sums.c1Inside;
+    sums_->c1Outside += sums.c1Outside;
+    sums_->c2Inside += sums.c2Inside;
+    sums_->c2Outside += sums.c2Outside;
+    sums_->maxVelocitySqr =
+        std::max(sums_->maxVelocitySqr, sums.maxVelocitySqr);
+  }
+
+  DropletDiagnosticsFunctional2D<T, Descriptor> *clone() const override {
+    return new DropletDiagnosticsFunctional2D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    for (pluint i = 0; i < modified.size(); ++i) {
+      modified[i] = modif::nothing;
+    }
+  }
+
+private:
+  DiagnosticsSums *sums_;
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef DROPLET_FIELD_H
+#define DROPLET_FIELD_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include <string>
+#include <vector>
+
+using namespace plb;
+
+// One droplet of an initial condition: centre and radius in lattice units
+// and the species concentrations inside it; a negative concentration
+// leaves the bath value (c_bulk) inside the droplet.
+struct DropletSpec {
+  double x = 0, y = 0, r = 0;
+  double c1 = -1, c2 = -1;
+};
+
+// Reads droplets from a geometry file, one per line: x y r [c1 c2],
+// separated by blanks or commas. Lines starting with # are comments.
+std::vector<DropletSpec> readDropletFile(std::string const &fileName);
+
+// Initial phi, c1 and c2 of a set of droplets: the union of the discs with
+// the tanh profile of width zeta of InitializePhiFunctional, so that a
+// single droplet gives the same field. The species blend from the bath to
+// the values of the nearest droplet with phi.
+//
+// The droplets are binned on a uniform grid, each into every bin its disc
+// plus the interface reaches, so a point only looks at the droplets of its
+// bin; points out of reach of every droplet are bath without evaluating
+// tanh. Immutable after construction and shared by all blocks.
+class DropletField {
+public:
+  struct Sample {
+    double phi, c1, c2;
+  };
+
+  DropletField(std::vector<DropletSpec> const &droplets, double zeta,
+               double cBulk);
+
+  Sample sample(double x, double y) const;
+
+  plint getNumDroplets() const { return (plint)droplets_.size(); }
+  plint getNumBins() const { return nbx_ * nby_; }
+
+  // phi of the bath, the floor of the tanh profile
+  static constexpr double phiFloor = 1e-8;
+
+private:
+  std::vector<DropletSpec> droplets_;
+  double zeta_, cBulk_;
+  // beyond reach_ outside a disc the profile is at phiFloor
+  double reach_;
+  // grid origin, bin size and bins; bin b holds the droplets
+  // items_[binStart_[b]] to items_[binStart_[b + 1] - 1]
+  double x0_ = 0, y0_ = 0, binSize_ = 1;
+  plint nbx_ = 0, nby_ = 0;
+  std::vector<plint> binStart_;
+  std::vector<plint> items_;
+};
+
+// Sets {phi, c1, c2} at rest to the equilibria of field, one equilibrium
+// evaluation per cell and lattice. field must outlive the application.
+template <typename T, template <typename U> class Descriptor>
+class InitializeDropletsFunctional2D
+    : public LatticeBoxProcessingFunctional2D<T, Descriptor> {
+public:
+  explicit InitializeDropletsFunctional2D(DropletField const *field)
+      : field_(field) {}
+
+  void process(Box2D domain,
+               std::vector<BlockLattice2D<T, Descriptor> *> lattices) override {
+    PLB_PRECONDITION(lattices.size() == 3);
+    BlockLattice2D<T, Descriptor> &phiLattice = *lattices[0];
+    BlockLattice2D<T, Descriptor> &lattice1 = *lattices[1];
+    BlockLattice2D<T, Descriptor> &lattice2 = *lattices[2];
+    Dot2D location = phiLattice.getLocation();
+    // c1 and c2 may have a wider envelope (temporal blocking)
+    Dot2D offset1 = computeRelativeDisplacement(phiLattice, lattice1);
+    Dot2D offset2 = computeRelativeDisplacement(phiLattice, lattice2);
+
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        DropletField::Sample s = field_->sample((double)(iX + location.x),
+                                                (double)(iY + location.y));
+        atRest(phiLattice.get(iX, iY), (T)s.phi);
+        atRest(lattice1.get(iX + offset1.x, iY + offset1.y), (T)s.c1);
+        atRest(lattice2.get(iX + offset2.x, iY + offset2.y), (T)s.c2);
+      }
+    }
+  }
+
+  InitializeDropletsFunctional2D<T, Descriptor> *clone() const override {
+    return new InitializeDropletsFunctional2D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables; // phi
+    modified[1] = modif::staticVariables; // c1
+    modified[2] = modif::staticVariables; // c2
+  }
+
+private:
+  static void atRest(Cell<T, Descriptor> &cell, T rho) {
+    Array<T, Descriptor<T>::q> fEq;
+    Array<T, Descriptor<T>::d> j;
+    j.resetToZero();
+    cell.getDynamics().computeEquilibria(fEq, Descriptor<T>::rhoBar(rho), j,
+                                         T());
+    for (plint iPop = 0; iPop < Descriptor<T>::q; ++iPop) {
+      cell[iPop] = fEq[iPop];
+    }
+  }
+
+  DropletField const *field_;
+};
+
+#endif
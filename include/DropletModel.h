@@ -0,0 +1,691 @@
+#ifndef DROPLET_MODEL_H
+#define DROPLET_MODEL_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ActiveTiles.h"
+#include "Checkpoint.h"
+#include "DropletDiagnostics.h"
+#include "DropletField.h"
+#include "DynamicsMomentum.h"
+#include "InterfaceStencil.h"
+#include "Profiler.h"
+#include "StepScheduler.h"
+#include "SwapStream.h"
+#include "TileExecutor.h"
+#include "lattice_coupling.h"
+#include "lattice_initilization.h"
+#include "phase_field_descriptor.h"
+#include "phi.h"
+
+using namespace plb;
+
+struct DropletParameters {
+  plint nx = 200, ny = 200;
+  double r0 = 40.0, zeta = 2.0;
+  // phase field; regularized or TRT collision tolerates omega close to 2
+  double M = 0.1;
+  PhaseCollision phaseCollision = PhaseCollision::bgk;
+  double magic = 0.25;
+  // species (reaction-diffusion)
+  double chi = 1.0, mu = 0.1, a = 0.1, b = 1.0, epsilon = 0.1;
+  double c_bulk = 0.1, tau1 = 1.0, tau2 = 1.0;
+  // Reaction in the species collision (explicitSource) or operator split:
+  // integrated every reactionPeriod steps over reactionPeriod steps, with
+  // reactionSubsteps substeps (implicitEuler) or to reactionTolerance
+  // (adaptiveRK). All schemes advance the kinetics at the same rate, see
+  // SpeciesCollisionCell.
+  ReactionScheme reaction = ReactionScheme::explicitSource;
+  plint reactionPeriod = 1;
+  int reactionSubsteps = 1;
+  double reactionTolerance = 1e-6;
+  // Duration of one lattice step in reaction time units; below 1 on a
+  // refined level.
+  double timeStep = 1.0;
+  // Active tiles: with tileSize > 0 the species coupling, the reaction,
+  // the interface stencil and the surface force skip tiles at equilibrium
+  // to within tileTolerance. The mask is refreshed every tileSize steps.
+  plint tileSize = 0;
+  double tileTolerance = 1e-8;
+  // Species collision and streaming in one in-place sweep
+  // (SpeciesCollideAndStream2D) rather than two passes; active tiles use
+  // the two passes, since the streaming cannot skip tiles.
+  bool fusedSpeciesStream = true;
+  // Threads per rank (hybrid MPI + threads, see TileExecutor): with
+  // threads > 1 the functionals of a step run on tiles of threadTileSize
+  // cells and the collide-and-stream sweeps on slabs of the blocks,
+  // concurrently; pinThreads holds each thread to one CPU of the rank.
+  unsigned threads = 1;
+  plint threadTileSize = 32;
+  bool pinThreads = false;
+  // Temporal blocking of the species: with speciesBlocking = k > 1 they
+  // are advanced k steps at a time (BlockedSpeciesCollideAndStream2D), in
+  // tiles of speciesBlockingTile cells that stay in cache, from the phi
+  // density of each step, recorded meanwhile. c1 and c2 get an envelope
+  // of k cells. Needs the fused sweep with the reaction in the collision
+  // and no active tiles; ignored otherwise.
+  plint speciesBlocking = 1;
+  plint speciesBlockingTile = 64;
+  // momentum and surface tension
+  double tauP = 1.0, beta = 0.01, kappa = 0.01;
+  InterfaceStencil stencil = InterfaceStencil::centralDifference;
+};
+
+// Where the blocks of a model live. A distributed model spreads its domain
+// over all processes with the Palabos defaults; a local model is held in
+// one block by the calling process and uses the serial communicator and
+// statistics, so that it never calls MPI and independent local models can
+// advance concurrently on threads (see EnsembleRunner).
+enum class Placement { distributed, local };
+
+// One block covering nx x ny cells, owned by the calling process.
+inline MultiBlockManagement2D localMultiBlockManagement(plint nx, plint ny,
+                                                        plint envelopeWidth) {
+  std::map<plint, int> attribution;
+  attribution[0] = global::mpi().getRank();
+  return MultiBlockManagement2D(createRegularDistribution2D(nx, ny, 1, 1),
+                                new ExplicitThreadAttribution(attribution),
+                                envelopeWidth);
+}
+
+inline BlockCommunicator2D *createBlockCommunicator(Placement placement) {
+  if (placement == Placement::local) {
+    return new SerialBlockCommunicator2D();
+  }
+  return defaultMultiBlockPolicy2D().getBlockCommunicator();
+}
+
+inline CombinedStatistics *createCombinedStatistics(Placement placement) {
+  if (placement == Placement::local) {
+    return new SerialCombinedStatistics();
+  }
+  return defaultMultiBlockPolicy2D().getCombinedStatistics();
+}
+
+// All coupled lattices share one multi-block management so that coupling
+// functionals see identical local coordinates on every block. The one
+// exception is the wider envelope of c1 and c2 with temporal blocking;
+// the functionals that run on them together with phi in that mode
+// (initialization, diagnostics) allow for the offset.
+template <typename T, template <typename U> class Descriptor>
+std::unique_ptr<MultiBlockLattice2D<T, Descriptor>>
+createLattice(MultiBlockManagement2D const &management,
+              Dynamics<T, Descriptor> *dynamics,
+              Placement placement = Placement::distributed) {
+  return std::unique_ptr<MultiBlockLattice2D<T, Descriptor>>(
+      new MultiBlockLattice2D<T, Descriptor>(
+          management, createBlockCommunicator(placement),
+          createCombinedStatistics(placement),
+          defaultMultiBlockPolicy2D().getMultiCellAccess<T, Descriptor>(),
+          dynamics));
+}
+
+// Phase field, two reacting species and momentum, advanced by a
+// StepScheduler. Stages, resources and their envelope coverage are declared
+// in buildSchedule(); the scheduler derives the order and the exchanges.
+template <typename T, template <typename U> class Descriptor>
+class DropletModel {
+public:
+  // Streaming needs one envelope layer on every lattice. The phi density
+  // gets a second layer so the interface stencil can also be evaluated on
+  // the lattice envelope, which spares an exchange of the phi externals.
+  static const plint latticeEnvelope = 1;
+  static const plint stencilEnvelope = 2;
+
+  // Steps the species advance at a time: speciesBlocking where it applies,
+  // otherwise 1.
+  static plint speciesBlockingDepth(DropletParameters const &params) {
+    const bool applies = params.fusedSpeciesStream && params.tileSize == 0 &&
+                         params.reaction == ReactionScheme::explicitSource;
+    return applies ? std::max((plint)1, params.speciesBlocking) : 1;
+  }
+
+  // Envelope of c1 and c2: one layer for streaming, or one per step they
+  // advance at a time.
+  static plint speciesEnvelope(DropletParameters const &params) {
+    return std::max(latticeEnvelope, speciesBlockingDepth(params));
+  }
+
+  explicit DropletModel(DropletParameters const &params)
+      : DropletModel(params,
+                     defaultMultiBlockPolicy2D().getMultiBlockManagement(
+                         params.nx, params.ny, latticeEnvelope)) {}
+
+  // Local model on the calling process (Placement::local).
+  DropletModel(DropletParameters const &params, Placement placement)
+      : DropletModel(params,
+                     placement == Placement::local
+                         ? localMultiBlockManagement(params.nx, params.ny,
+                                                     latticeEnvelope)
+                         : defaultMultiBlockPolicy2D().getMultiBlockManagement(
+                               params.nx, params.ny, latticeEnvelope),
+                     placement) {}
+
+  DropletModel(DropletParameters const &params,
+               MultiBlockManagement2D const &management,
+               Placement placement = Placement::distributed)
+      : params_(params), placement_(placement) {
+    allocate(management);
+    if (params.tileSize > 0) {
+      tiles_.reset(new ActiveTiles(phiLattice_->getBoundingBox(),
+                                   params.tileSize,
+                                   placement == Placement::distributed));
+    }
+    if (params.threads > 1) {
+      executor_.reset(new TileExecutor(params.threads, params.threadTileSize,
+                                       params.pinThreads));
+    }
+
+    buildSchedule();
+  }
+
+  // Droplet at the domain centre in a uniform species bath at rest.
+  void initialize() { initialize(params_.nx / 2, params_.ny / 2); }
+
+  // Droplet of radius r0 centred at (cx, cy).
+  void initialize(plint cx, plint cy) {
+    DropletSpec droplet;
+    droplet.x = (double)cx;
+    droplet.y = (double)cy;
+    droplet.r = params_.r0;
+    initialize(std::vector<DropletSpec>(1, droplet));
+  }
+
+  // Any number of droplets (see DropletField), e.g. from readDropletFile().
+  void initialize(std::vector<DropletSpec> const &droplets) {
+    ProfileScope scope("initialize", "initialize");
+    Box2D domain = phiLattice_->getBoundingBox();
+    DropletField field(droplets, params_.zeta, params_.c_bulk);
+    std::vector<MultiBlock2D *> species{phiLattice_.get(), c1Lattice_.get(),
+                                        c2Lattice_.get()};
+    applyProcessingFunctional(
+        threaded(new InitializeDropletsFunctional2D<T, Descriptor>(&field)),
+        domain, species);
+    initializeAtEquilibrium(*pLattice_, domain, (T)1, Array<T, 2>(0.0, 0.0));
+
+    phiLattice_->initialize();
+    c1Lattice_->initialize();
+    c2Lattice_->initialize();
+    pLattice_->initialize();
+
+    pendingSpeciesSteps_ = 0;
+    refreshDerivedFields();
+  }
+
+  // Recomputes the phi density, the interface fields read by the next phi
+  // collision and the tile mask from the populations, e.g. after they were
+  // set from outside the schedule.
+  void refreshDerivedFields() {
+    scheduler_.run("phi.density");
+    scheduler_.run("interface.stencil");
+    if (tiles_) {
+      scheduler_.run("tiles.update");
+    }
+  }
+
+  void step() { scheduler_.step(); }
+
+  // Droplet diagnostics of the current state, in one pass over the
+  // lattices. Collective unless the model is local.
+  DropletDiagnostics diagnose() {
+    ProfileScope scope("diagnostics", "diagnostics");
+    catchUpSpecies();
+    DiagnosticsSums sums;
+    std::vector<MultiBlockLattice2D<T, Descriptor> *> lattices = {
+        phiLattice_.get(), c1Lattice_.get(), c2Lattice_.get(),
+        pLattice_.get()};
+    applyProcessingFunctional(
+        new DropletDiagnosticsFunctional2D<T, Descriptor>(&sums),
+        phiLattice_->getBoundingBox(), lattices);
+    if (placement_ == Placement::distributed) {
+      sums.allReduce();
+    }
+    return sums.finish(scheduler_.getNumSteps());
+  }
+
+  // Moves the model onto management, another distribution of the same
+  // domain (e.g. from LoadBalancer): the populations and externals of all
+  // four lattices migrate to their new ranks. Collective.
+  void repartition(MultiBlockManagement2D const &management) {
+    ProfileScope scope("repartition", "transfer");
+    catchUpSpecies();
+    std::vector<std::unique_ptr<MultiBlockLattice2D<T, Descriptor>>> old;
+    old.push_back(std::move(phiLattice_));
+    old.push_back(std::move(c1Lattice_));
+    old.push_back(std::move(c2Lattice_));
+    old.push_back(std::move(pLattice_));
+    allocate(management);
+
+    std::vector<MultiBlockLattice2D<T, Descriptor> *> next = {
+        phiLattice_.get(), c1Lattice_.get(), c2Lattice_.get(),
+        pLattice_.get()};
+    Box2D domain = phiLattice_->getBoundingBox();
+    for (pluint i = 0; i < next.size(); ++i) {
+      copy(*old[i], domain, *next[i], domain, modif::staticVariables);
+      old[i].reset();
+      next[i]->duplicateOverlaps(modif::staticVariables);
+    }
+    refreshDerivedFields();
+  }
+
+  // Populations and externals of all four lattices.
+  void saveCheckpoint(std::string const &fileName, plint step) {
+    catchUpSpecies();
+    ::saveCheckpoint(fileName, step, checkpointLattices());
+  }
+
+  // Replaces initialize() when resuming; returns the step to resume at.
+  plint restart(std::string const &fileName) {
+    // the interface quantities come back with the phi externals, and the
+    // phi density is recomputed before its first use
+    plint step = loadCheckpoint(fileName, checkpointLattices());
+    scheduler_.setNumSteps(step);
+    pendingSpeciesSteps_ = 0;
+    return step;
+  }
+
+  DropletParameters const &getParameters() const { return params_; }
+  StepScheduler &getScheduler() { return scheduler_; }
+  // nullptr unless tileSize > 0
+  ActiveTiles const *getActiveTiles() const { return tiles_.get(); }
+  // nullptr unless threads > 1
+  TileExecutor const *getTileExecutor() const { return executor_.get(); }
+
+  // With temporal blocking the species may lag behind phi and momentum by
+  // up to speciesBlocking - 1 steps; they catch up before diagnostics,
+  // checkpoints and repartitions. Callers that read c1 or c2 call this
+  // first, on every rank: getC1() and getC2() do not communicate.
+  // Collective unless the model is local.
+  void catchUpSpecies() {
+    if (pendingSpeciesSteps_ > 0) {
+      scheduler_.run("species.collideAndStream");
+    }
+  }
+
+  MultiBlockLattice2D<T, Descriptor> &getPhi() { return *phiLattice_; }
+  // The species lattices; catchUpSpecies() must have run since the last
+  // step.
+  MultiBlockLattice2D<T, Descriptor> &getC1() {
+    PLB_PRECONDITION(pendingSpeciesSteps_ == 0);
+    return *c1Lattice_;
+  }
+  MultiBlockLattice2D<T, Descriptor> &getC2() {
+    PLB_PRECONDITION(pendingSpeciesSteps_ == 0);
+    return *c2Lattice_;
+  }
+  MultiBlockLattice2D<T, Descriptor> &getMomentum() { return *pLattice_; }
+
+  MultiScalarField2D<T> &getPhiDensity() { return *phiDensity_; }
+
+private:
+  // Lattices and phi density on management; c1, c2 and the phi history
+  // on the same blocks with the envelope of speciesEnvelope().
+  void allocate(MultiBlockManagement2D const &management) {
+    MultiBlockManagement2D speciesManagement(management);
+    speciesManagement.changeEnvelopeWidth(speciesEnvelope(params_));
+    phiLattice_ = createLattice<T, Descriptor>(
+        management,
+        new phi<T, Descriptor>(params_.M, params_.zeta,
+                               params_.phaseCollision, params_.magic),
+        placement_);
+    c1Lattice_ = createLattice<T, Descriptor>(
+        speciesManagement, new BGKdynamics<T, Descriptor>((T)1 / params_.tau1),
+        placement_);
+    c2Lattice_ = createLattice<T, Descriptor>(
+        speciesManagement, new BGKdynamics<T, Descriptor>((T)1 / params_.tau2),
+        placement_);
+    pLattice_ = createLattice<T, Descriptor>(
+        management, new DynamicsMomentum<T, Descriptor>((T)1 / params_.tauP),
+        placement_);
+
+    MultiBlockManagement2D densityManagement(management);
+    densityManagement.changeEnvelopeWidth(
+        std::max(stencilEnvelope, management.getEnvelopeWidth() + 1));
+    phiDensity_.reset(new MultiScalarField2D<T>(
+        densityManagement, createBlockCommunicator(placement_),
+        createCombinedStatistics(placement_),
+        defaultMultiBlockPolicy2D().getMultiScalarAccess<T>()));
+
+    phiHistory_.clear();
+    const plint depth = speciesBlockingDepth(params_);
+    for (plint step = 0; depth > 1 && step < depth; ++step) {
+      phiHistory_.emplace_back(new MultiScalarField2D<T>(
+          speciesManagement, createBlockCommunicator(placement_),
+          createCombinedStatistics(placement_),
+          defaultMultiBlockPolicy2D().getMultiScalarAccess<T>()));
+    }
+    scheduler_.setNumCells(countLocalCells(management));
+  }
+
+  static plint countLocalCells(MultiBlockManagement2D const &management) {
+    plint cells = 0;
+    for (plint blockId : management.getLocalInfo().getBlocks()) {
+      Box2D bulk;
+      management.getSparseBlockStructure().getBulk(blockId, bulk);
+      cells += bulk.nCells();
+    }
+    return cells;
+  }
+
+  std::vector<std::pair<std::string, MultiBlockLattice2D<T, Descriptor> *>>
+  checkpointLattices() {
+    return {{"phi", phiLattice_.get()},
+            {"c1", c1Lattice_.get()},
+            {"c2", c2Lattice_.get()},
+            {"momentum", pLattice_.get()}};
+  }
+
+  void buildSchedule() {
+    typedef StepScheduler S;
+
+    scheduler_.addResource("phi.populations", [this]() {
+      phiLattice_->duplicateOverlaps(modif::staticVariables);
+    });
+    scheduler_.addResource("c1.populations", [this]() {
+      c1Lattice_->duplicateOverlaps(modif::staticVariables);
+    });
+    scheduler_.addResource("c2.populations", [this]() {
+      c2Lattice_->duplicateOverlaps(modif::staticVariables);
+    });
+    scheduler_.addResource("momentum.populations", [this]() {
+      pLattice_->duplicateOverlaps(modif::staticVariables);
+    });
+    scheduler_.addResource("phi.density", [this]() {
+      phiDensity_->duplicateOverlaps(modif::staticVariables);
+    });
+    // externals live in the lattice cells, so they travel with the lattice
+    S::Action phiExternals = [this]() {
+      phiLattice_->duplicateOverlaps(modif::staticVariables);
+    };
+    scheduler_.addResource("PHI_NORMGRAD_FIELD", phiExternals);
+    scheduler_.addResource("PHI_GRAD_FIELD", phiExternals);
+    scheduler_.addResource("PHI_LAPLACE_FIELD", phiExternals);
+    scheduler_.addResource("PHI_MU_FIELD", phiExternals);
+    scheduler_.addResource("FORCE_FIELD", [this]() {
+      pLattice_->duplicateOverlaps(modif::staticVariables);
+    });
+    scheduler_.addResource("phi.history", [this]() {
+      for (std::unique_ptr<MultiScalarField2D<T>> &phi : phiHistory_) {
+        phi->duplicateOverlaps(modif::staticVariables);
+      }
+    });
+
+    // ---- phase field ----
+    scheduler_
+        .addStage("phi.collideAndStream",
+                  [this]() { collideAndStream(*phiLattice_); })
+        .readsPrevious("PHI_NORMGRAD_FIELD")
+        .writes("phi.populations", S::bulkAndEnvelope);
+
+    scheduler_
+        .addStage("phi.density",
+                  [this]() {
+                    applyDeferred(
+                        threaded(new BoxDensityFunctional2D<T, Descriptor>()),
+                        BlockDomain::bulk, phiLattice_.get(),
+                        phiDensity_.get());
+                  })
+        .reads("phi.populations")
+        .writes("phi.density");
+
+    scheduler_
+        .addStage("interface.stencil",
+                  [this]() {
+                    applyDeferred(
+                        threaded(tiled(
+                            new FusedInterfaceFunctional2D<T, Descriptor>(
+                                params_.beta, params_.kappa,
+                                phiLattice_->getBoundingBox(),
+                                params_.stencil))),
+                        BlockDomain::bulkAndEnvelope, phiLattice_.get(),
+                        phiDensity_.get());
+                  })
+        .reads("phi.density", S::stencil)
+        .writes("PHI_NORMGRAD_FIELD", S::bulkAndEnvelope)
+        .writes("PHI_GRAD_FIELD", S::bulkAndEnvelope)
+        .writes("PHI_LAPLACE_FIELD", S::bulkAndEnvelope)
+        .writes("PHI_MU_FIELD", S::bulkAndEnvelope);
+
+    // ---- species: reaction-diffusion collision, then streaming ----
+    // The coupling is cell-local, so running it on the envelope as well
+    // leaves post-collision populations there and streaming needs no
+    // exchange. The fused sweep does both at once and leaves the envelope
+    // stale, so it is exchanged once before the next sweep (or reaction,
+    // which updates the envelope in place).
+    const bool splitReaction =
+        params_.reaction != ReactionScheme::explicitSource;
+    if (splitReaction) {
+      // registered before the coupling, so it acts on the streamed
+      // populations of the previous step
+      scheduler_
+          .addStage("species.reaction",
+                    [this]() {
+                      C span = (C)(params_.reactionPeriod * params_.timeStep);
+                      applyDeferred(
+                          threaded(tiled(new SpeciesReaction2D<T, Descriptor>(
+                              reactionKinetics(), reactionIntegrator(), span))),
+                          BlockDomain::bulkAndEnvelope, c1Lattice_.get(),
+                          c2Lattice_.get(), phiLattice_.get());
+                    })
+          .every(params_.reactionPeriod)
+          .reads("phi.populations")
+          .reads("c1.populations", S::stencil)
+          .reads("c2.populations", S::stencil)
+          .writes("c1.populations", S::bulkAndEnvelope)
+          .writes("c2.populations", S::bulkAndEnvelope);
+    }
+
+    const plint blocking = speciesBlockingDepth(params_);
+    if (blocking > 1) {
+      // Nothing reads the species back within a step, so they may fall
+      // behind: each step records the phi density they collide with, and
+      // every `blocking` steps (or on catchUpSpecies()) they go through
+      // the recorded steps in one blocked sweep. Only c1, c2 and the
+      // recorded densities have an envelope as wide as the steps; it is
+      // exchanged once per sweep, while phi and momentum keep one layer.
+      scheduler_
+          .addStage("species.record",
+                    [this]() {
+                      applyDeferred(
+                          threaded(new BoxDensityFunctional2D<T, Descriptor>()),
+                          BlockDomain::bulkAndEnvelope, phiLattice_.get(),
+                          phiHistory_[pendingSpeciesSteps_].get());
+                      ++pendingSpeciesSteps_;
+                    })
+          .reads("phi.populations")
+          .writes("phi.history");
+
+      scheduler_
+          .addStage("species.collideAndStream",
+                    [this]() { advanceSpecies(); })
+          .every(blocking)
+          .reads("phi.history", S::stencil)
+          .reads("c1.populations", S::stencil)
+          .reads("c2.populations", S::stencil)
+          .writes("c1.populations")
+          .writes("c2.populations");
+    } else if (params_.fusedSpeciesStream && !tiles_) {
+      scheduler_
+          .addStage("species.collideAndStream",
+                    [this, splitReaction]() {
+                      applyDeferred(
+                          new SpeciesCollideAndStream2D<T, Descriptor>(
+                              params_.chi, params_.mu, params_.a, params_.b,
+                              params_.epsilon, params_.c_bulk, params_.tau1,
+                              params_.tau2, !splitReaction, executor_.get()),
+                          BlockDomain::bulkAndEnvelope, c1Lattice_.get(),
+                          c2Lattice_.get(), phiLattice_.get());
+                    })
+          .reads("phi.populations")
+          .reads("c1.populations", S::stencil)
+          .reads("c2.populations", S::stencil)
+          .writes("c1.populations")
+          .writes("c2.populations");
+    } else {
+      scheduler_
+          .addStage("species.coupling",
+                    [this, splitReaction]() {
+                      applyDeferred(
+                          threaded(tiled(new lattice_coupling<T, Descriptor>(
+                              (T)1 / params_.tau1, params_.chi, params_.mu,
+                              params_.a, params_.b, params_.epsilon,
+                              params_.c_bulk, params_.tau1, params_.tau2,
+                              !splitReaction))),
+                          BlockDomain::bulkAndEnvelope, c1Lattice_.get(),
+                          c2Lattice_.get(), phiLattice_.get());
+                    })
+          .reads("phi.populations")
+          .writes("c1.populations", S::bulkAndEnvelope)
+          .writes("c2.populations", S::bulkAndEnvelope);
+
+      scheduler_
+          .addStage("species.stream",
+                    [this]() {
+                      c1Lattice_->stream();
+                      c2Lattice_->stream();
+                    })
+          .reads("c1.populations", S::stencil)
+          .reads("c2.populations", S::stencil)
+          .writes("c1.populations", S::bulkAndEnvelope)
+          .writes("c2.populations", S::bulkAndEnvelope);
+    }
+
+    // ---- momentum ----
+    scheduler_
+        .addStage("surface.force",
+                  [this]() {
+                    applyDeferred(
+                        threaded(tiled(new PhiPcoupling2D<T, Descriptor>())),
+                        BlockDomain::bulkAndEnvelope,
+                                  phiLattice_.get(), pLattice_.get());
+                  })
+        .reads("PHI_GRAD_FIELD")
+        .reads("PHI_MU_FIELD")
+        .writes("FORCE_FIELD", S::bulkAndEnvelope);
+
+    scheduler_
+        .addStage("momentum.collideAndStream",
+                  [this]() { collideAndStream(*pLattice_); })
+        .reads("FORCE_FIELD")
+        .writes("momentum.populations", S::bulkAndEnvelope);
+
+    // ---- active tiles ----
+    // Phase field and momentum still collide and stream everywhere; the
+    // mask only gates the functionals wrapped in tiled().
+    if (tiles_) {
+      scheduler_
+          .addStage("tiles.update",
+                    [this]() {
+                      tiles_->beginUpdate();
+                      applyDeferred(
+                          new UpdateActiveTilesFunctional2D<T, Descriptor>(
+                              tiles_.get(), reactionKinetics(),
+                              (C)params_.tileTolerance),
+                          BlockDomain::bulk, c1Lattice_.get(),
+                          c2Lattice_.get(), phiLattice_.get());
+                      tiles_->finishUpdate();
+                    })
+          .every(params_.tileSize)
+          .reads("phi.populations")
+          .reads("c1.populations")
+          .reads("c2.populations");
+    }
+  }
+
+  // Restricts functional to the active tiles, if enabled.
+  BoxProcessingFunctional2D *tiled(BoxProcessingFunctional2D *functional) {
+    if (!tiles_) {
+      return functional;
+    }
+    return new TiledFunctional2D(functional, tiles_.get());
+  }
+
+  // Spreads functional over the tile threads, if enabled. The tiles.update
+  // and diagnostics functionals accumulate into shared state and stay on
+  // the calling thread.
+  BoxProcessingFunctional2D *threaded(BoxProcessingFunctional2D *functional) {
+    if (!executor_) {
+      return functional;
+    }
+    return new ThreadedFunctional2D(functional, executor_.get());
+  }
+
+  // Collides and streams lattice and refreshes its envelope; with tile
+  // threads as a sweep over slabs of each block (CollideAndStream2D).
+  void collideAndStream(MultiBlockLattice2D<T, Descriptor> &lattice) {
+    if (!executor_) {
+      lattice.collideAndStream();
+      return;
+    }
+    applyDeferred(new CollideAndStream2D<T, Descriptor>(executor_.get()),
+                  BlockDomain::bulk, &lattice);
+    lattice.duplicateOverlaps(modif::staticVariables);
+  }
+
+  // Takes the species through the steps recorded in phiHistory_, in one
+  // blocked sweep.
+  void advanceSpecies() {
+    std::vector<MultiBlock2D *> blocks{c1Lattice_.get(), c2Lattice_.get()};
+    for (plint step = 0; step < pendingSpeciesSteps_; ++step) {
+      blocks.push_back(phiHistory_[step].get());
+    }
+    Box2D domain = c1Lattice_->getBoundingBox();
+    applyProcessingFunctional(
+        new DeferredSyncFunctional2D(
+            new BlockedSpeciesCollideAndStream2D<T, Descriptor>(
+                params_.chi, params_.mu, params_.a, params_.b,
+                params_.epsilon, params_.c_bulk, params_.tau1, params_.tau2,
+                domain, params_.speciesBlockingTile, executor_.get()),
+            BlockDomain::bulk),
+        domain, blocks);
+    pendingSpeciesSteps_ = 0;
+  }
+
+  // the kinetics run in the arithmetic type of the cell kernels
+  typedef typename ComputeType<T>::type C;
+
+  ReactionKinetics<C> reactionKinetics() const {
+    return ReactionKinetics<C>{(C)params_.a, (C)params_.b,
+                               (C)params_.epsilon, (C)params_.c_bulk};
+  }
+
+  ReactionIntegrator<C> reactionIntegrator() const {
+    ReactionIntegrator<C> integrator;
+    integrator.scheme = params_.reaction;
+    integrator.substeps = params_.reactionSubsteps;
+    integrator.tolerance = (C)params_.reactionTolerance;
+    return integrator;
+  }
+
+  template <class... Blocks>
+  void applyDeferred(BoxProcessingFunctional2D *functional,
+                     BlockDomain::DomainT appliesTo, Blocks *...blocks) {
+    std::vector<MultiBlock2D *> args{blocks...};
+    applyProcessingFunctional(
+        new DeferredSyncFunctional2D(functional, appliesTo),
+        args[0]->getBoundingBox(), args);
+  }
+
+  DropletParameters params_;
+  Placement placement_;
+  std::unique_ptr<MultiBlockLattice2D<T, Descriptor>> phiLattice_;
+  std::unique_ptr<MultiBlockLattice2D<T, Descriptor>> c1Lattice_;
+  std::unique_ptr<MultiBlockLattice2D<T, Descriptor>> c2Lattice_;
+  std::unique_ptr<MultiBlockLattice2D<T, Descriptor>> pLattice_;
+  std::unique_ptr<MultiScalarField2D<T>> phiDensity_;
+  // phi density of the steps the species have yet to take, with blocking
+  std::vector<std::unique_ptr<MultiScalarField2D<T>>> phiHistory_;
+  plint pendingSpeciesSteps_ = 0;
+  std::unique_ptr<ActiveTiles> tiles_;
+  std::unique_ptr<TileExecutor> executor_;
+  StepScheduler scheduler_;
+};
+
+#endif
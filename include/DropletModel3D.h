@@ -0,0 +1,321 @@
+#ifndef DROPLET_MODEL_3D_H
+#define DROPLET_MODEL_3D_H
+
+#include "palabos3D.h"
+#include "palabos3D.hh"
+#include <memory>
+#include <vector>
+
+#include "DropletModel.h"
+#include "DynamicsMomentum.h"
+#include "InterfaceStencil3D.h"
+#include "Profiler.h"
+#include "StepScheduler.h"
+#include "lattice_coupling3D.h"
+#include "lattice_initilization3D.h"
+#include "phase_field_descriptor3D.h"
+#include "phi.h"
+
+using namespace plb;
+
+// DropletParameters of a 3D run. Active tiles and grid refinement are
+// 2D-only; tileSize is ignored.
+struct DropletParameters3D : public DropletParameters {
+  DropletParameters3D() { nx = ny = nz = 100; r0 = 20.0; }
+
+  plint nz;
+};
+
+// 3D counterpart of DeferredSyncFunctional2D.
+class DeferredSyncFunctional3D : public BoxProcessingFunctional3D {
+public:
+  DeferredSyncFunctional3D(BoxProcessingFunctional3D *functional,
+                           BlockDomain::DomainT appliesTo)
+      : functional_(functional), appliesTo_(appliesTo) {}
+
+  DeferredSyncFunctional3D(DeferredSyncFunctional3D const &rhs)
+      : BoxProcessingFunctional3D(rhs), functional_(rhs.functional_->clone()),
+        appliesTo_(rhs.appliesTo_) {}
+
+  ~DeferredSyncFunctional3D() override { delete functional_; }
+
+  void process(Box3D domain, std::vector<AtomicBlock3D *> blocks) override {
+    functional_->process(domain, blocks);
+  }
+
+  DeferredSyncFunctional3D *clone() const override {
+    return new DeferredSyncFunctional3D(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    for (pluint i = 0; i < modified.size(); ++i) {
+      modified[i] = modif::nothing;
+    }
+  }
+
+  BlockDomain::DomainT appliesTo() const override { return appliesTo_; }
+
+private:
+  DeferredSyncFunctional3D &operator=(DeferredSyncFunctional3D const &);
+
+  BoxProcessingFunctional3D *functional_;
+  BlockDomain::DomainT appliesTo_;
+};
+
+// The coupled model of DropletModel on MultiBlockLattice3D, for a 3D
+// descriptor such as PhaseFieldD3Q19Descriptor. The dynamics and the
+// per-cell species kernels are the ones of the 2D model; the stages, their
+// envelope coverage and hence the exchanges are the same, with the
+// domain spread over all processes by the default 3D policy.
+template <typename T, template <typename U> class Descriptor>
+class DropletModel3D {
+public:
+  static const plint latticeEnvelope = 1;
+  static const plint stencilEnvelope = 2;
+
+  explicit DropletModel3D(DropletParameters3D const &params)
+      : params_(params) {
+    MultiBlockManagement3D management =
+        defaultMultiBlockPolicy3D().getMultiBlockManagement(
+            params.nx, params.ny, params.nz, latticeEnvelope);
+    phiLattice_ = createLattice(
+        management, new phi<T, Descriptor>(params.M, params.zeta,
+                                           params.phaseCollision,
+                                           params.magic));
+    c1Lattice_ = createLattice(
+        management, new BGKdynamics<T, Descriptor>((T)1 / params.tau1));
+    c2Lattice_ = createLattice(
+        management, new BGKdynamics<T, Descriptor>((T)1 / params.tau2));
+    pLattice_ = createLattice(
+        management, new DynamicsMomentum<T, Descriptor>((T)1 / params.tauP));
+
+    MultiBlockManagement3D densityManagement(management);
+    densityManagement.changeEnvelopeWidth(stencilEnvelope);
+    phiDensity_.reset(new MultiScalarField3D<T>(
+        densityManagement,
+        defaultMultiBlockPolicy3D().getBlockCommunicator(),
+        defaultMultiBlockPolicy3D().getCombinedStatistics(),
+        defaultMultiBlockPolicy3D().getMultiScalarAccess<T>()));
+
+    buildSchedule();
+    scheduler_.setNumCells(countLocalCells(management));
+  }
+
+  // Droplet at the domain centre in a uniform species bath at rest.
+  void initialize() {
+    Box3D domain = phiLattice_->getBoundingBox();
+    applyProcessingFunctional(
+        new InitializePhiFunctional3D<T, Descriptor>(
+            params_.r0, params_.zeta, params_.nx / 2, params_.ny / 2,
+            params_.nz / 2),
+        domain, *phiLattice_);
+    Array<T, 3> zero(0.0, 0.0, 0.0);
+    initializeAtEquilibrium(*c1Lattice_, domain, (T)params_.c_bulk, zero);
+    initializeAtEquilibrium(*c2Lattice_, domain, (T)params_.c_bulk, zero);
+    initializeAtEquilibrium(*pLattice_, domain, (T)1, zero);
+
+    phiLattice_->initialize();
+    c1Lattice_->initialize();
+    c2Lattice_->initialize();
+    pLattice_->initialize();
+
+    scheduler_.run("phi.density");
+    scheduler_.run("interface.stencil");
+  }
+
+  void step() { scheduler_.step(); }
+
+  DropletParameters3D const &getParameters() const { return params_; }
+  StepScheduler &getScheduler() { return scheduler_; }
+
+  MultiBlockLattice3D<T, Descriptor> &getPhi() { return *phiLattice_; }
+  MultiBlockLattice3D<T, Descriptor> &getC1() { return *c1Lattice_; }
+  MultiBlockLattice3D<T, Descriptor> &getC2() { return *c2Lattice_; }
+  MultiBlockLattice3D<T, Descriptor> &getMomentum() { return *pLattice_; }
+
+private:
+  typedef typename ComputeType<T>::type C;
+
+  static std::unique_ptr<MultiBlockLattice3D<T, Descriptor>>
+  createLattice(MultiBlockManagement3D const &management,
+                Dynamics<T, Descriptor> *dynamics) {
+    return std::unique_ptr<MultiBlockLattice3D<T, Descriptor>>(
+        new MultiBlockLattice3D<T, Descriptor>(
+            management, defaultMultiBlockPolicy3D().getBlockCommunicator(),
+            defaultMultiBlockPolicy3D().getCombinedStatistics(),
+            defaultMultiBlockPolicy3D().getMultiCellAccess<T, Descriptor>(),
+            dynamics));
+  }
+
+  static plint countLocalCells(MultiBlockManagement3D const &management) {
+    plint cells = 0;
+    for (plint blockId : management.getLocalInfo().getBlocks()) {
+      Box3D bulk;
+      management.getSparseBlockStructure().getBulk(blockId, bulk);
+      cells += bulk.nCells();
+    }
+    return cells;
+  }
+
+  // Same stages and resources as DropletModel::buildSchedule(), without
+  // the active tiles.
+  void buildSchedule() {
+    typedef StepScheduler S;
+
+    scheduler_.addResource("phi.populations", [this]() {
+      phiLattice_->duplicateOverlaps(modif::staticVariables);
+    });
+    scheduler_.addResource("c1.populations", [this]() {
+      c1Lattice_->duplicateOverlaps(modif::staticVariables);
+    });
+    scheduler_.addResource("c2.populations", [this]() {
+      c2Lattice_->duplicateOverlaps(modif::staticVariables);
+    });
+    scheduler_.addResource("momentum.populations", [this]() {
+      pLattice_->duplicateOverlaps(modif::staticVariables);
+    });
+    scheduler_.addResource("phi.density", [this]() {
+      phiDensity_->duplicateOverlaps(modif::staticVariables);
+    });
+    S::Action phiExternals = [this]() {
+      phiLattice_->duplicateOverlaps(modif::staticVariables);
+    };
+    scheduler_.addResource("PHI_NORMGRAD_FIELD", phiExternals);
+    scheduler_.addResource("PHI_GRAD_FIELD", phiExternals);
+    scheduler_.addResource("PHI_LAPLACE_FIELD", phiExternals);
+    scheduler_.addResource("PHI_MU_FIELD", phiExternals);
+    scheduler_.addResource("FORCE_FIELD", [this]() {
+      pLattice_->duplicateOverlaps(modif::staticVariables);
+    });
+
+    // ---- phase field ----
+    scheduler_
+        .addStage("phi.collideAndStream",
+                  [this]() { phiLattice_->collideAndStream(); })
+        .readsPrevious("PHI_NORMGRAD_FIELD")
+        .writes("phi.populations", S::bulkAndEnvelope);
+
+    scheduler_
+        .addStage("phi.density",
+                  [this]() {
+                    applyDeferred(new BoxDensityFunctional3D<T, Descriptor>(),
+                                  BlockDomain::bulk, phiLattice_.get(),
+                                  phiDensity_.get());
+                  })
+        .reads("phi.populations")
+        .writes("phi.density");
+
+    scheduler_
+        .addStage("interface.stencil",
+                  [this]() {
+                    applyDeferred(
+                        new FusedInterfaceFunctional3D<T, Descriptor>(
+                            params_.beta, params_.kappa,
+                            phiLattice_->getBoundingBox(), params_.stencil),
+                        BlockDomain::bulkAndEnvelope, phiLattice_.get(),
+                        phiDensity_.get());
+                  })
+        .reads("phi.density", S::stencil)
+        .writes("PHI_NORMGRAD_FIELD", S::bulkAndEnvelope)
+        .writes("PHI_GRAD_FIELD", S::bulkAndEnvelope)
+        .writes("PHI_LAPLACE_FIELD", S::bulkAndEnvelope)
+        .writes("PHI_MU_FIELD", S::bulkAndEnvelope);
+
+    // ---- species ----
+    const bool splitReaction =
+        params_.reaction != ReactionScheme::explicitSource;
+    if (splitReaction) {
+      scheduler_
+          .addStage("species.reaction",
+                    [this]() {
+                      C span = (C)(params_.reactionPeriod * params_.timeStep);
+                      applyDeferred(
+                          new SpeciesReaction3D<T, Descriptor>(
+                              reactionKinetics(), reactionIntegrator(), span),
+                          BlockDomain::bulkAndEnvelope, c1Lattice_.get(),
+                          c2Lattice_.get(), phiLattice_.get());
+                    })
+          .every(params_.reactionPeriod)
+          .reads("phi.populations")
+          .writes("c1.populations", S::bulkAndEnvelope)
+          .writes("c2.populations", S::bulkAndEnvelope);
+    }
+
+    scheduler_
+        .addStage("species.coupling",
+                  [this, splitReaction]() {
+                    applyDeferred(
+                        new lattice_coupling3D<T, Descriptor>(
+                            params_.chi, params_.mu, params_.a, params_.b,
+                            params_.epsilon, params_.c_bulk, params_.tau1,
+                            params_.tau2, !splitReaction),
+                        BlockDomain::bulkAndEnvelope, c1Lattice_.get(),
+                        c2Lattice_.get(), phiLattice_.get());
+                  })
+        .reads("phi.populations")
+        .writes("c1.populations", S::bulkAndEnvelope)
+        .writes("c2.populations", S::bulkAndEnvelope);
+
+    scheduler_
+        .addStage("species.stream",
+                  [this]() {
+                    c1Lattice_->stream();
+                    c2Lattice_->stream();
+                  })
+        .reads("c1.populations", S::stencil)
+        .reads("c2.populations", S::stencil)
+        .writes("c1.populations", S::bulkAndEnvelope)
+        .writes("c2.populations", S::bulkAndEnvelope);
+
+    // ---- momentum ----
+    scheduler_
+        .addStage("surface.force",
+                  [this]() {
+                    applyDeferred(new PhiPcoupling3D<T, Descriptor>(),
+                                  BlockDomain::bulkAndEnvelope,
+                                  phiLattice_.get(), pLattice_.get());
+                  })
+        .reads("PHI_GRAD_FIELD")
+        .reads("PHI_MU_FIELD")
+        .writes("FORCE_FIELD", S::bulkAndEnvelope);
+
+    scheduler_
+        .addStage("momentum.collideAndStream",
+                  [this]() { pLattice_->collideAndStream(); })
+        .reads("FORCE_FIELD")
+        .writes("momentum.populations", S::bulkAndEnvelope);
+  }
+
+  ReactionKinetics<C> reactionKinetics() const {
+    return ReactionKinetics<C>{(C)params_.a, (C)params_.b,
+                               (C)params_.epsilon, (C)params_.c_bulk};
+  }
+
+  ReactionIntegrator<C> reactionIntegrator() const {
+    ReactionIntegrator<C> integrator;
+    integrator.scheme = params_.reaction;
+    integrator.substeps = params_.reactionSubsteps;
+    integrator.tolerance = (C)params_.reactionTolerance;
+    return integrator;
+  }
+
+  template <class... Blocks>
+  void applyDeferred(BoxProcessingFunctional3D *functional,
+                     BlockDomain::DomainT appliesTo, Blocks *...blocks) {
+    std::vector<MultiBlock3D *> args{blocks...};
+    applyProcessingFunctional(
+        new DeferredSyncFunctional3D(functional, appliesTo),
+        args[0]->getBoundingBox(), args);
+  }
+
+  DropletParameters3D params_;
+  std::unique_ptr<MultiBlockLattice3D<T, Descriptor>> phiLattice_;
+  std::unique_ptr<MultiBlockLattice3D<T, Descriptor>> c1Lattice_;
+  std::unique_ptr<MultiBlockLattice3D<T, Descriptor>> c2Lattice_;
+  std::unique_ptr<MultiBlockLattice3D<T, Descriptor>> pLattice_;
+  std::unique_ptr<MultiScalarField3D<T>> phiDensity_;
+  StepScheduler scheduler_;
+};
+
+#endif
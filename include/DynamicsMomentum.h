@@ -3,81 +3,77 @@
 #define DYNAMICS_MOMENTUM_H
 #include "palabos2D.h"
 #include "palabos2D.hh"
+#include "LatticeKernels.h"
 
 using namespace plb;
 
-#define FORCE_FIELD 25 // external field index for Fs
-
+// BGK with Guo forcing from the force externals; any lattice with
+// LatticeKernels.
 template <typename T, template <typename U> class Descriptor>
 class DynamicsMomentum : public plb::BGKdynamics<T, Descriptor> {
 public:
   DynamicsMomentum(T omega) : plb::BGKdynamics<T, Descriptor>(omega) {}
 
   // ---- Collision step with force-corrected velocity ----
+  // Evaluated in ComputeType<T>, whatever the storage precision.
   void collide(Cell<T, Descriptor> &cell,
                BlockStatistics &statistics) override {
+    typedef typename ComputeType<T>::type C;
+    typedef DescriptorKernels<C, Descriptor> K;
+    C f[K::q];
+    K::load(&cell[0], f);
 
-    // --- Step 1: Compute density and momentum ---
-    T rho = cell.computeDensity();
-    Array<T, Descriptor<T>::d> j;
-    cell.computeMomentum(j); // j = sum_i f_i * e_i
+    // --- Step 1: Compute density and momentum once per cell ---
+    C rhoBar, j[K::d];
+    K::rhoBarJ(f, rhoBar, j);
+    const C rho = Descriptor<C>::fullRho(rhoBar);
+    const C invRho = (C)1 / rho;
 
     // --- Step 2: Retrieve force field from external field ---
-    Array<T, Descriptor<T>::d> F_s =
-        cell.template getExternal<Array<T, Descriptor<T>::d>>(FORCE_FIELD);
-
-    // --- Step 3: Compute corrected velocity (Guo's formula) ---
-    Array<T, Descriptor<T>::d> u;
-    for (int d = 0; d < Descriptor<T>::d; ++d) {
-      u[d] = j[d] / rho + 0.5 * F_s[d] / rho; // Δt = 1 in lattice units
+    T const *F_s = cell.getExternal(forceBeginsAt);
+    C F[K::d], u[K::d], uForced[K::d];
+    for (int iD = 0; iD < K::d; ++iD) {
+      F[iD] = (C)F_s[iD];
+      u[iD] = j[iD] * invRho;
+      // --- Step 3: Compute corrected velocity (Guo's formula) ---
+      // Δt = 1 in lattice units
+      uForced[iD] = (j[iD] + (C)0.5 * F[iD]) * invRho;
     }
 
-    // --- Step 4: Collision step with equilibrium and forcing ---
-    T omega = this->getOmega();
-    const T cs2 = Descriptor<T>::cs2;
-    T jSqr = dot(j, j);
-
-    for (plint iPop = 0; iPop < Descriptor<T>::q; ++iPop) {
-      const Array<T, Descriptor<T>::d> &e_i = Descriptor<T>::c[iPop];
-      T w_i = Descriptor<T>::t[iPop];
-
-      // Compute equilibrium
-      T feq = this->computeEquilibrium(iPop, rho, j, jSqr);
-
-      // Guo forcing term
-      Array<T, Descriptor<T>::d> e_minus_u = e_i - u;
-      T S_i = w_i * dot(e_minus_u, F_s) / cs2;
-
-      // Standard BGK + forcing
-      T f_old = cell[iPop];
-      cell[iPop] = f_old - omega * (f_old - feq) + (1.0 - 0.5 * omega) * S_i;
-    }
+    // --- Step 4: Equilibrium (uncorrected velocity) and Guo source ---
+    C feq[K::q], S[K::q];
+    K::secondOrderEquilibria(rho, u, feq);
+    K::guoForcing(uForced, F, S);
+
+    // --- Step 5: Standard BGK + forcing, fully unrolled ---
+    const C omega = (C)this->getOmega();
+    const C sourceFactor = (C)1 - (C)0.5 * omega;
+    K::unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      f[iPop] += -omega * (f[iPop] - feq[iPop]) + sourceFactor * S[iPop];
+    });
+    K::store(f, &cell[0]);
   }
 
   // ---- Equilibrium computation ----
   T computeEquilibrium(plint iPop, T rhoBar,
                        Array<T, Descriptor<T>::d> const &j,
                        T jSqr) const override {
-    const T cs2 = Descriptor<T>::cs2;
-    const T invCs2 = Descriptor<T>::invCs2;
-    const T w_i = Descriptor<T>::t[iPop];
-    const Array<T, Descriptor<T>::d> &e_i = Descriptor<T>::c[iPop];
-
-    Array<T, 2> u(j[0] / rhoBar, j[1] / rhoBar);
-    T eu = dot(e_i, u);
-    T uu = dot(u, u);
-
-    // Compute equilibrium distribution
-    T Gamma_i =
-        (1.0 + eu / cs2 + 0.5 * (eu * eu) / (cs2 * cs2) - 0.5 * uu / cs2);
-
-    T feq = w_i * rhoBar * Gamma_i;
-    return feq;
+    typedef DescriptorKernels<T, Descriptor> K;
+    const T invRho = (T)1 / rhoBar;
+    T u[K::d];
+    for (int iD = 0; iD < K::d; ++iD) {
+      u[iD] = j[iD] * invRho;
+    }
+    return K::secondOrderEquilibrium(iPop, rhoBar, u);
   }
 
   DynamicsMomentum<T, Descriptor> *clone() const override {
     return new DynamicsMomentum<T, Descriptor>(*this);
   }
+
+private:
+  static const int forceBeginsAt = Descriptor<T>::ExternalField::forceBeginsAt;
 };
 
 #endif
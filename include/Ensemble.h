@@ -0,0 +1,152 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "DropletModel.h"
+#include "SnapshotIO.h"
+#include "ThreadPool.h"
+
+using namespace plb;
+
+// One case of a parameter sweep: a droplet run of its own, reported every
+// reportEvery steps.
+struct EnsembleCase {
+  std::string label;
+  DropletParameters params;
+  plint steps = 1000;
+  plint reportEvery = 100;
+};
+
+// Reads a sweep table: comma-separated, one case per row, the first row
+// naming the columns. A column is "label", "steps", "reportEvery" or a
+// numeric field of DropletParameters (nx, ny, r0, zeta, M, a, b, epsilon,
+// tau1, tau2, ...); fields without a column keep the value of defaults.
+// Blank lines and lines starting with # are skipped. Rows without a label
+// are numbered.
+std::vector<EnsembleCase> readEnsembleTable(std::string const &fileName,
+                                            EnsembleCase const &defaults);
+
+struct EnsembleResult {
+  std::string label;
+  plint steps = 0;
+  double seconds = 0;
+  // at the last report
+  DropletDiagnostics last;
+  // empty unless the case failed, e.g. diverged
+  std::string error;
+};
+
+// Runs the cases of a sweep as independent local DropletModels (see
+// Placement::local) on a thread pool; with several ranks, case i runs on
+// rank i % size. Each case writes
+//   <prefix>case_<label>.csv  DropletDiagnostics per report
+//   <prefix>case_<label>.lbm  final phi, c1 and c2
+// A failing case is reported in its result and does not stop the others.
+//
+// Palabos registers every multi-block in a process-wide table, so models
+// are created and destroyed one at a time; stepping runs concurrently.
+template <typename T, template <typename U> class Descriptor>
+class EnsembleRunner {
+public:
+  EnsembleRunner(std::vector<EnsembleCase> const &cases,
+                 std::string const &prefix, unsigned numThreads = 0)
+      : cases_(cases), prefix_(prefix), numThreads_(numThreads) {}
+
+  // Results of the cases of this rank, in table order.
+  std::vector<EnsembleResult> run() {
+    const pluint rank = (pluint)global::mpi().getRank();
+    const pluint size = (pluint)global::mpi().getSize();
+    std::vector<EnsembleResult> results(cases_.size());
+    {
+      ThreadPool pool(numThreads_);
+      for (pluint i = rank; i < cases_.size(); i += size) {
+        pool.submit([this, i, &results]() { results[i] = runCase(cases_[i]); });
+      }
+      pool.wait();
+    }
+    std::vector<EnsembleResult> local;
+    for (pluint i = rank; i < cases_.size(); i += size) {
+      local.push_back(results[i]);
+    }
+    return local;
+  }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  static std::mutex &registrationMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  EnsembleResult runCase(EnsembleCase const &c) {
+    EnsembleResult result;
+    result.label = c.label;
+    Clock::time_point begin = Clock::now();
+    std::unique_ptr<DropletModel<T, Descriptor>> model;
+    try {
+      {
+        std::lock_guard<std::mutex> lock(registrationMutex());
+        model.reset(
+            new DropletModel<T, Descriptor>(c.params, Placement::local));
+      }
+      model->initialize();
+
+      std::string fileName = prefix_ + "case_" + c.label;
+      std::ofstream series((fileName + ".csv").c_str());
+      if (!series) {
+        throw PlbIOException("EnsembleRunner: cannot open " + fileName +
+                             ".csv");
+      }
+      series << DropletDiagnostics::csvHeader() << "\n";
+      for (plint iT = 0; iT <= c.steps; ++iT) {
+        if (iT % c.reportEvery == 0 || iT == c.steps) {
+          result.last = model->diagnose();
+          series << result.last.csvRow() << "\n";
+          if (!std::isfinite(result.last.mass) ||
+              !std::isfinite(result.last.c1Inside + result.last.c1Outside)) {
+            throw PlbLogicErrorException("diverged before step " +
+                                         std::to_string(iT));
+          }
+        }
+        if (iT < c.steps) {
+          model->step();
+          result.steps = iT + 1;
+        }
+      }
+
+      model->catchUpSpecies();
+      SnapshotFrame last;
+      last.step = c.steps;
+      stageSnapshotDensity(last, "phi", model->getPhi());
+      stageSnapshotDensity(last, "c1", model->getC1());
+      stageSnapshotDensity(last, "c2", model->getC2());
+      writeSnapshotLocal(last, fileName + ".lbm");
+    } catch (std::exception const &error) {
+      result.error = error.what();
+    }
+    {
+      std::lock_guard<std::mutex> lock(registrationMutex());
+      model.reset();
+    }
+    result.seconds =
+        std::chrono::duration<double>(Clock::now() - begin).count();
+    return result;
+  }
+
+  std::vector<EnsembleCase> cases_;
+  std::string prefix_;
+  unsigned numThreads_;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef FIELD_STENCIL_H
+#define FIELD_STENCIL_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include "SimdStencil.h"
+#include <vector>
+
+using namespace plb;
+
+// Palabos adaptors of the SIMD stencil engine. ScalarField2D keeps y
+// contiguous, so every x-row of a domain is one StencilRow. domain is in
+// the coordinates of the input field; the input must be readable one cell
+// around it.
+
+// Distance between input(x, y) and input(x + 1, y): the field stores one
+// column of getNy() cells per x. Taken from the allocation, since a block
+// one cell wide has no x + 1 to measure it from.
+inline std::ptrdiff_t stencilStrideX(ScalarField2D<double> const &in) {
+  return (std::ptrdiff_t)in.getNy();
+}
+
+// Calls consume(iX, y0, length, outputs) after each row, with the planar
+// outputs of the operator in rows[k][0..length).
+template <class Op, class Consume>
+void forEachStencilRow(Op const &op, Box2D domain, ScalarField2D<double> &in,
+                       Consume consume) {
+  if (domain.getNx() <= 0 || domain.getNy() <= 0) {
+    return;
+  }
+  std::ptrdiff_t length = domain.getNy();
+  std::vector<double> scratch(Op::numOutputs * length);
+  StencilRow row;
+  row.strideX = stencilStrideX(in);
+  row.length = length;
+  for (int k = 0; k < Op::numOutputs; ++k) {
+    row.out[k] = &scratch[k * length];
+  }
+  for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+    row.center = &in.get(iX, domain.y0);
+    runStencilRow(op, row);
+    consume(iX, domain.y0, length, row.out);
+  }
+}
+
+// One scalar output, written in place.
+template <class Op>
+void applyRowStencil(Op const &op, Box2D domain, ScalarField2D<double> &in,
+                     ScalarField2D<double> &out) {
+  static_assert(Op::numOutputs == 1, "operator must have one output");
+  if (domain.getNx() <= 0 || domain.getNy() <= 0) {
+    return;
+  }
+  Dot2D offset = computeRelativeDisplacement(in, out);
+  StencilRow row;
+  row.strideX = stencilStrideX(in);
+  row.length = domain.getNy();
+  for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+    row.center = &in.get(iX, domain.y0);
+    row.out[0] = &out.get(iX + offset.x, domain.y0 + offset.y);
+    runStencilRow(op, row);
+  }
+}
+
+// Two outputs, interleaved into the components of a tensor field.
+template <class Op>
+void applyRowStencil(Op const &op, Box2D domain, ScalarField2D<double> &in,
+                     TensorField2D<double, 2> &out) {
+  static_assert(Op::numOutputs == 2, "operator must have two outputs");
+  Dot2D offset = computeRelativeDisplacement(in, out);
+  forEachStencilRow(op, domain, in,
+                    [&](plint iX, plint y0, std::ptrdiff_t length,
+                        double *const *rows) {
+                      double *dst =
+                          &out.get(iX + offset.x, y0 + offset.y)[0];
+                      for (std::ptrdiff_t i = 0; i < length; ++i) {
+                        dst[2 * i] = rows[0][i];
+                        dst[2 * i + 1] = rows[1][i];
+                      }
+                    });
+}
+
+#endif
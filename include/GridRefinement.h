@@ -0,0 +1,355 @@
+#ifndef GRID_REFINEMENT_H
+#define GRID_REFINEMENT_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include "D2Q9Kernels.h"
+#include "DropletModel.h"
+#include "phase_field_descriptor.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace plb;
+
+// Two-level grid refinement of the droplet model: a fine patch around the
+// phi = 1/2 band on top of a coarse lattice that covers the whole domain.
+// Levels are vertex-centred, coarse node X coincides with fine node
+// ratio * (X - patch.x0), and use convective scaling (dx and dt both shrink
+// by ratio).
+
+struct RefinementParameters {
+  // fine cells per coarse cell; 1 disables refinement
+  plint ratio = 2;
+  // margin, in coarse cells, kept between the interface band and the edge
+  // of the fine patch
+  plint bandWidth = 8;
+  // coarse steps between band checks
+  plint regridEvery = 10;
+  // phi in (bandTolerance, 1 - bandTolerance) counts as interface
+  double bandTolerance = 1e-3;
+  // zeta and M of the fine level in fine cells; 0 scales them from the
+  // coarse level like the other parameters. fineZeta also sets kappa and
+  // beta, see RefinedDropletModel::makeFine().
+  double fineZeta = 0;
+  double fineM = 0;
+};
+
+// Parameters of the fine level over a patch of coarse nodes: lattice
+// diffusivities grow by ratio (tau - 1/2 scaled), lengths by ratio and the
+// reaction advances 1 / ratio per step. kappa scales with ratio^2 so that
+// mu_phi is unchanged and the lattice force Fs = mu grad(phi) shrinks by
+// 1 / ratio, as convective scaling requires.
+inline DropletParameters refineParameters(DropletParameters const &coarse,
+                                          plint ratio, Box2D patch) {
+  DropletParameters fine = coarse;
+  const double r = (double)ratio;
+  fine.nx = ratio * (patch.getNx() - 1) + 1;
+  fine.ny = ratio * (patch.getNy() - 1) + 1;
+  fine.r0 = coarse.r0 * r;
+  fine.zeta = coarse.zeta * r;
+  fine.M = coarse.M * r;
+  fine.tau1 = 0.5 + r * (coarse.tau1 - 0.5);
+  fine.tau2 = 0.5 + r * (coarse.tau2 - 0.5);
+  fine.tauP = 0.5 + r * (coarse.tauP - 0.5);
+  fine.kappa = coarse.kappa * r * r;
+  fine.timeStep = coarse.timeStep / r;
+  fine.tileSize = coarse.tileSize * ratio;
+  return fine;
+}
+
+// Per-node records of the four lattices of a level over a box of coarse
+// nodes, replicated on all ranks. Gathering functionals fill the nodes of
+// their bulk and allReduce() combines the ranks. A record holds rho, j and
+// the non-equilibrium populations.
+class LevelBuffer {
+public:
+  static const int numLattices = 4; // phi, c1, c2, momentum
+  static const int recordSize = 12;
+
+  LevelBuffer() {}
+  explicit LevelBuffer(Box2D box);
+
+  Box2D const &getBox() const { return box_; }
+  bool contains(plint x, plint y) const {
+    return x >= box_.x0 && x <= box_.x1 && y >= box_.y0 && y <= box_.y1;
+  }
+  double *record(plint x, plint y, int iLattice) {
+    return &data_[index(x, y, iLattice)];
+  }
+  double const *record(plint x, plint y, int iLattice) const {
+    return &data_[index(x, y, iLattice)];
+  }
+
+  void clear();
+  void allReduce();
+
+private:
+  std::size_t index(plint x, plint y, int iLattice) const {
+    return (((std::size_t)(x - box_.x0) * box_.getNy() + (y - box_.y0)) *
+                numLattices +
+            iLattice) *
+           recordSize;
+  }
+
+  Box2D box_;
+  std::vector<double> data_;
+};
+
+// Smallest box containing the boxes of all ranks; empty boxes have
+// x0 > x1.
+void allReduceBoundingBox(Box2D &box);
+
+// Equilibria the four lattices of one level relax to in their collisions,
+// their relaxation times and the cell size in coarse cells.
+template <typename T, template <typename U> class Descriptor>
+struct LevelPhysics {
+  typedef D2Q9Kernels<T> K;
+
+  DropletParameters params;
+  T dx;
+
+  T tau(int iLattice) const {
+    switch (iLattice) {
+    case 0:
+      return (T)params.M * K::invCs2 + (T)0.5;
+    case 1:
+      return (T)params.tau1;
+    case 2:
+      return (T)params.tau2;
+    default:
+      return (T)params.tauP;
+    }
+  }
+
+  // phiCell supplies n-hat for the phase-field equilibrium.
+  void equilibria(int iLattice, T rho, T jx, T jy,
+                  Cell<T, Descriptor> &phiCell, T *feq) const {
+    const T invRho = (T)1 / ((std::abs(rho) < (T)1e-18) ? (T)1e-18 : rho);
+    const T ux = jx * invRho;
+    const T uy = jy * invRho;
+    switch (iLattice) {
+    case 0: {
+      Array<T, 2> nHat = getExternalVector(phiCell, PHI_NORMGRAD_FIELD);
+      K::phaseFieldEquilibria(rho, ux, uy, nHat[0], nHat[1], (T)params.M,
+                              (T)params.zeta, feq);
+      for (int iPop = 0; iPop < K::q; ++iPop) {
+        feq[iPop] -= K::t[iPop];
+      }
+      break;
+    }
+    case 1:
+    case 2:
+      K::reactionDiffusionEquilibria(std::max(rho, (T)1e-12), ux, uy,
+                                     (T)(params.chi * params.mu), feq);
+      break;
+    default:
+      K::secondOrderEquilibria(rho, ux, uy, feq);
+    }
+  }
+};
+
+// Maps the nodes of a level to coarse node coordinates:
+// X = origin + x / ratio, with x the global coordinate on the level.
+struct LevelMap {
+  Dot2D origin;
+  plint ratio;
+};
+
+// Writes the records of the nodes of {phi, c1, c2, momentum} of one level
+// that coincide with a node of the buffer. Apply on the bulk.
+template <typename T, template <typename U> class Descriptor>
+class GatherLevelFunctional2D
+    : public LatticeBoxProcessingFunctional2D<T, Descriptor> {
+public:
+  GatherLevelFunctional2D(LevelBuffer *buffer,
+                          LevelPhysics<T, Descriptor> const &physics,
+                          LevelMap map)
+      : buffer_(buffer), physics_(physics), map_(map) {}
+
+  void process(Box2D domain,
+               std::vector<BlockLattice2D<T, Descriptor> *> lattices) override {
+    PLB_PRECONDITION(lattices.size() == LevelBuffer::numLattices);
+    typedef D2Q9Kernels<T> K;
+    Dot2D location = lattices[0]->getLocation();
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      plint gX = iX + location.x;
+      if (gX % map_.ratio != 0) {
+        continue;
+      }
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        plint gY = iY + location.y;
+        plint X = map_.origin.x + gX / map_.ratio;
+        plint Y = map_.origin.y + gY / map_.ratio;
+        if (gY % map_.ratio != 0 || !buffer_->contains(X, Y)) {
+          continue;
+        }
+        Cell<T, Descriptor> &phiCell = lattices[0]->get(iX, iY);
+        for (int l = 0; l < LevelBuffer::numLattices; ++l) {
+          T *f = &lattices[l]->get(iX, iY)[0];
+          T rhoBar, jx, jy, feq[K::q];
+          K::rhoBarJ(f, rhoBar, jx, jy);
+          T rho = Descriptor<T>::fullRho(rhoBar);
+          physics_.equilibria(l, rho, jx, jy, phiCell, feq);
+
+          double *record = buffer_->record(X, Y, l);
+          record[0] = rho;
+          record[1] = jx;
+          record[2] = jy;
+          for (int iPop = 0; iPop < K::q; ++iPop) {
+            record[3 + iPop] = f[iPop] - feq[iPop];
+          }
+        }
+      }
+    }
+  }
+
+  GatherLevelFunctional2D<T, Descriptor> *clone() const override {
+    return new GatherLevelFunctional2D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    for (pluint i = 0; i < modified.size(); ++i) {
+      modified[i] = modif::nothing;
+    }
+  }
+
+private:
+  LevelBuffer *buffer_;
+  LevelPhysics<T, Descriptor> physics_;
+  LevelMap map_;
+};
+
+// Sets the populations of {phi, c1, c2, momentum} of one level from the
+// records of another, bilinear in space and linear in time between older
+// and newer (weight alpha on newer). The non-equilibrium part is rescaled
+// by (tau_to dx_to) / (tau_from dx_from), after Dupuis and Chopard.
+// Cell-local, so it may be applied on bulk and envelope.
+template <typename T, template <typename U> class Descriptor>
+class ScatterLevelFunctional2D
+    : public LatticeBoxProcessingFunctional2D<T, Descriptor> {
+public:
+  ScatterLevelFunctional2D(LevelBuffer const *older, LevelBuffer const *newer,
+                           T alpha, LevelPhysics<T, Descriptor> const &from,
+                           LevelPhysics<T, Descriptor> const &to,
+                           LevelMap map)
+      : older_(older), newer_(newer), alpha_(alpha), from_(from), to_(to),
+        map_(map) {}
+
+  void process(Box2D domain,
+               std::vector<BlockLattice2D<T, Descriptor> *> lattices) override {
+    PLB_PRECONDITION(lattices.size() == LevelBuffer::numLattices);
+    typedef D2Q9Kernels<T> K;
+    const int size = LevelBuffer::recordSize;
+    T scale[LevelBuffer::numLattices];
+    for (int l = 0; l < LevelBuffer::numLattices; ++l) {
+      scale[l] = (to_.tau(l) * to_.dx) / (from_.tau(l) * from_.dx);
+    }
+
+    Dot2D location = lattices[0]->getLocation();
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        // bilinear stencil in coarse nodes
+        plint Xs[2], Ys[2];
+        T wx, wy;
+        locate(iX + location.x, map_.origin.x, Xs, wx);
+        locate(iY + location.y, map_.origin.y, Ys, wy);
+        PLB_ASSERT(newer_->contains(Xs[0], Ys[0]) &&
+                   newer_->contains(Xs[1], Ys[1]));
+
+        Cell<T, Descriptor> &phiCell = lattices[0]->get(iX, iY);
+        for (int l = 0; l < LevelBuffer::numLattices; ++l) {
+          T record[size] = {};
+          for (int a = 0; a < 2; ++a) {
+            for (int b = 0; b < 2; ++b) {
+              T w = (a ? wx : (T)1 - wx) * (b ? wy : (T)1 - wy);
+              if (w == (T)0) {
+                continue;
+              }
+              double const *o = older_->record(Xs[a], Ys[b], l);
+              double const *n = newer_->record(Xs[a], Ys[b], l);
+              for (int k = 0; k < size; ++k) {
+                record[k] += w * (((T)1 - alpha_) * o[k] + alpha_ * n[k]);
+              }
+            }
+          }
+
+          T feq[K::q];
+          to_.equilibria(l, record[0], record[1], record[2], phiCell, feq);
+          T *f = &lattices[l]->get(iX, iY)[0];
+          for (int iPop = 0; iPop < K::q; ++iPop) {
+            f[iPop] = feq[iPop] + scale[l] * record[3 + iPop];
+          }
+        }
+      }
+    }
+  }
+
+  ScatterLevelFunctional2D<T, Descriptor> *clone() const override {
+    return new ScatterLevelFunctional2D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    for (pluint i = 0; i < modified.size(); ++i) {
+      modified[i] = modif::staticVariables;
+    }
+  }
+
+private:
+  // coarse nodes around the level coordinate x, and the weight of the
+  // upper one
+  void locate(plint x, plint origin, plint (&nodes)[2], T &weight) const {
+    plint base = x / map_.ratio;
+    plint rest = x % map_.ratio;
+    nodes[0] = origin + base;
+    nodes[1] = rest ? nodes[0] + 1 : nodes[0];
+    weight = (T)rest / (T)map_.ratio;
+  }
+
+  LevelBuffer const *older_, *newer_;
+  T alpha_;
+  LevelPhysics<T, Descriptor> from_, to_;
+  LevelMap map_;
+};
+
+// Bounding box of the interface band of a phi density field, in global
+// coordinates, accumulated over the blocks of this rank into *band.
+template <typename T>
+class BandBoxFunctional2D : public BoxProcessingFunctional2D_S<T> {
+public:
+  BandBoxFunctional2D(Box2D *band, T tolerance)
+      : band_(band), tolerance_(tolerance) {}
+
+  void process(Box2D domain, ScalarField2D<T> &phi) override {
+    Dot2D location = phi.getLocation();
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        T value = phi.get(iX, iY);
+        if (value > tolerance_ && value < (T)1 - tolerance_) {
+          band_->x0 = std::min(band_->x0, iX + location.x);
+          band_->x1 = std::max(band_->x1, iX + location.x);
+          band_->y0 = std::min(band_->y0, iY + location.y);
+          band_->y1 = std::max(band_->y1, iY + location.y);
+        }
+      }
+    }
+  }
+
+  BandBoxFunctional2D<T> *clone() const override {
+    return new BandBoxFunctional2D<T>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::nothing;
+  }
+
+private:
+  Box2D *band_;
+  T tolerance_;
+};
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef INTERFACE_STENCIL_H
+#define INTERFACE_STENCIL_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include "D2Q9Kernels.h"
+#include "FieldStencil.h"
+#include "phase_field_descriptor.h"
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+using namespace plb;
+
+// Finite-difference stencil used for grad(phi) and lap(phi).
+enum class InterfaceStencil {
+  // central differences and the 5-point Laplacian, as in
+  // BoxNormGradientFunctional2D and BoxLaplacianFunctional2D
+  centralDifference,
+  // D2Q9-weighted: grad = 1/cs2 sum_i t_i c_i phi(x + c_i),
+  //                lap  = 2/cs2 sum_i t_i (phi(x + c_i) - phi(x))
+  isotropicD2Q9
+};
+
+// Interface quantities of one cell from its 3x3 neighbourhood
+// nb[1 + dx][1 + dy].
+template <typename T> struct InterfaceKernels {
+  typedef D2Q9Kernels<T> K;
+
+  static inline void gradLaplacian(T const (&nb)[3][3],
+                                   InterfaceStencil stencil, T &gx, T &gy,
+                                   T &lap) {
+    if (stencil == InterfaceStencil::isotropicD2Q9) {
+      gx = gy = lap = (T)0;
+      K::unroll([&](auto i) {
+        constexpr int iPop = decltype(i)::value;
+        const T value = nb[1 + K::cx[iPop]][1 + K::cy[iPop]];
+        gx += K::t[iPop] * (T)K::cx[iPop] * value;
+        gy += K::t[iPop] * (T)K::cy[iPop] * value;
+        lap += K::t[iPop] * (value - nb[1][1]);
+      });
+      gx *= K::invCs2;
+      gy *= K::invCs2;
+      lap *= (T)2 * K::invCs2;
+    } else {
+      gx = (nb[2][1] - nb[0][1]) / (T)2;
+      gy = (nb[1][2] - nb[1][0]) / (T)2;
+      lap = nb[2][1] + nb[0][1] + nb[1][2] + nb[1][0] - (T)4 * nb[1][1];
+    }
+  }
+
+  // Bulk chemical potential of the double well minus the gradient term.
+  static inline T chemicalPotential(T phi, T lap, T beta, T kappa) {
+    return (T)4 * beta * phi * (phi - (T)0.5) * (phi - (T)1) - kappa * lap;
+  }
+};
+
+// Single pass over the phi density that writes grad(phi), n-hat, lap(phi)
+// and mu_phi into the external scalars of the phi lattice, where the phi
+// dynamics and the surface-tension coupling read them. Applied to
+// {phi lattice, phi density}; the density needs one envelope layer more
+// than the lattice so the stencil also covers the lattice envelope.
+// Neighbours outside the global domain are clamped to its edge, as in the
+// one-sided edge treatment of BoxNormGradientFunctional2D. With T = double
+// the interior rows go through the SIMD stencil engine.
+template <typename T, template <typename U> class Descriptor>
+class FusedInterfaceFunctional2D
+    : public BoxProcessingFunctional2D_LS<T, Descriptor, T> {
+public:
+  FusedInterfaceFunctional2D(T beta, T kappa, Box2D globalDomain,
+                             InterfaceStencil stencil)
+      : beta_(beta), kappa_(kappa), globalDomain_(globalDomain),
+        stencil_(stencil) {}
+
+  void process(Box2D domain, BlockLattice2D<T, Descriptor> &lattice,
+               ScalarField2D<T> &phi) override {
+    Dot2D offset = computeRelativeDisplacement(lattice, phi);
+    Dot2D location = lattice.getLocation();
+
+    // cells whose whole 3x3 neighbourhood lies inside the global domain
+    Box2D interior(
+        std::max(domain.x0, globalDomain_.x0 + 1 - location.x),
+        std::min(domain.x1, globalDomain_.x1 - 1 - location.x),
+        std::max(domain.y0, globalDomain_.y0 + 1 - location.y),
+        std::min(domain.y1, globalDomain_.y1 - 1 - location.y));
+    bool simd = std::is_same<T, double>::value && interior.getNx() > 0 &&
+                interior.getNy() > 0;
+    if (simd) {
+      processRows(interior, lattice, phi, offset);
+    }
+
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      bool rowDone = simd && iX >= interior.x0 && iX <= interior.x1;
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        if (rowDone && iY == interior.y0) {
+          iY = interior.y1;
+          continue;
+        }
+        processCell(iX, iY, lattice, phi, offset, location);
+      }
+    }
+  }
+
+  FusedInterfaceFunctional2D<T, Descriptor> *clone() const override {
+    return new FusedInterfaceFunctional2D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables; // phi lattice externals
+    modified[1] = modif::nothing;         // phi density
+  }
+
+  BlockDomain::DomainT appliesTo() const override {
+    return BlockDomain::bulkAndEnvelope;
+  }
+
+private:
+  static void store(Cell<T, Descriptor> &cell, T gx, T gy, T nx, T ny, T lap,
+                    T mu) {
+    T *grad = cell.getExternal(PHI_GRAD_FIELD);
+    grad[0] = gx;
+    grad[1] = gy;
+    T *nHat = cell.getExternal(PHI_NORMGRAD_FIELD);
+    nHat[0] = nx;
+    nHat[1] = ny;
+    *cell.getExternal(PHI_LAPLACE_FIELD) = lap;
+    *cell.getExternal(PHI_MU_FIELD) = mu;
+  }
+
+  // One cell, with neighbours clamped to the global domain.
+  void processCell(plint iX, plint iY, BlockLattice2D<T, Descriptor> &lattice,
+                   ScalarField2D<T> &phi, Dot2D offset, Dot2D location) const {
+    typedef typename ComputeType<T>::type C;
+    typedef InterfaceKernels<C> IK;
+    plint gX = iX + location.x;
+    plint gY = iY + location.y;
+    plint xs[3] = {std::max(gX - 1, globalDomain_.x0) - location.x + offset.x,
+                   iX + offset.x,
+                   std::min(gX + 1, globalDomain_.x1) - location.x + offset.x};
+    plint ys[3] = {std::max(gY - 1, globalDomain_.y0) - location.y + offset.y,
+                   iY + offset.y,
+                   std::min(gY + 1, globalDomain_.y1) - location.y + offset.y};
+
+    C nb[3][3];
+    for (int dx = 0; dx < 3; ++dx) {
+      for (int dy = 0; dy < 3; ++dy) {
+        nb[dx][dy] = (C)phi.get(xs[dx], ys[dy]);
+      }
+    }
+
+    C gx, gy, lap;
+    IK::gradLaplacian(nb, stencil_, gx, gy, lap);
+    C mag = std::sqrt(gx * gx + gy * gy + (C)1e-16);
+    store(lattice.get(iX, iY), (T)gx, (T)gy, (T)(gx / mag), (T)(gy / mag),
+          (T)lap, (T)IK::chemicalPotential(nb[1][1], lap, (C)beta_, (C)kappa_));
+  }
+
+  // Interior rows through the SIMD stencil engine (double only).
+  void processRows(Box2D interior, BlockLattice2D<T, Descriptor> &lattice,
+                   ScalarField2D<T> &phi, Dot2D offset) const {
+    if constexpr (std::is_same<T, double>::value) {
+      if (stencil_ == InterfaceStencil::isotropicD2Q9) {
+        processRows(PhaseInterfaceStencil<true>{beta_, kappa_}, interior,
+                    lattice, phi, offset);
+      } else {
+        processRows(PhaseInterfaceStencil<false>{beta_, kappa_}, interior,
+                    lattice, phi, offset);
+      }
+    }
+  }
+
+  template <class Op>
+  void processRows(Op const &op, Box2D interior,
+                   BlockLattice2D<T, Descriptor> &lattice,
+                   ScalarField2D<double> &phi, Dot2D offset) const {
+    forEachStencilRow(
+        op, interior.shift(offset.x, offset.y), phi,
+        [&](plint iX, plint y0, std::ptrdiff_t length, double *const *rows) {
+          for (std::ptrdiff_t i = 0; i < length; ++i) {
+            store(lattice.get(iX - offset.x, y0 - offset.y + i), rows[0][i],
+                  rows[1][i], rows[2][i], rows[3][i], rows[4][i], rows[5][i]);
+          }
+        });
+  }
+
+  T beta_, kappa_;
+  Box2D globalDomain_;
+  InterfaceStencil stencil_;
+};
+
+#endif
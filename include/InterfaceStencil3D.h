@@ -0,0 +1,166 @@
+#ifndef INTERFACE_STENCIL_3D_H
+#define INTERFACE_STENCIL_3D_H
+
+#include "palabos3D.h"
+#include "palabos3D.hh"
+#include <algorithm>
+#include <cmath>
+
+#include "InterfaceStencil.h"
+#include "LatticeKernels.h"
+
+using namespace plb;
+
+// Interface quantities of one cell from the phase field at its lattice
+// neighbours, nb[i] = phi(x + c_i), for any velocity set of LatticeKernels.
+// InterfaceStencil::isotropicD2Q9 selects the weights of the velocity set
+// in use (D3Q19 or D3Q27 in 3D); central differences use the 2d axis
+// neighbours, which every velocity set contains.
+template <typename T, class Stencil> struct LatticeInterfaceKernels {
+  typedef LatticeKernels<T, Stencil> K;
+
+  static inline void gradLaplacian(T const *nb, InterfaceStencil stencil,
+                                   T *grad, T &lap) {
+    for (int iD = 0; iD < K::d; ++iD) {
+      grad[iD] = (T)0;
+    }
+    if (stencil == InterfaceStencil::isotropicD2Q9) {
+      lap = (T)0;
+      K::unroll([&](auto i) {
+        constexpr int iPop = decltype(i)::value;
+        K::unrollDims([&](auto a) {
+          constexpr int iD = decltype(a)::value;
+          if constexpr (K::template c<iPop, iD>() != 0) {
+            grad[iD] += K::t[iPop] * (T)K::template c<iPop, iD>() * nb[iPop];
+          }
+        });
+        lap += K::t[iPop] * (nb[iPop] - nb[0]);
+      });
+      for (int iD = 0; iD < K::d; ++iD) {
+        grad[iD] *= K::invCs2;
+      }
+      lap *= (T)2 * K::invCs2;
+    } else {
+      lap = -(T)(2 * K::d) * nb[0];
+      K::unroll([&](auto i) {
+        constexpr int iPop = decltype(i)::value;
+        if constexpr (isAxis(iPop)) {
+          K::unrollDims([&](auto a) {
+            constexpr int iD = decltype(a)::value;
+            if constexpr (K::template c<iPop, iD>() != 0) {
+              grad[iD] += (T)K::template c<iPop, iD>() * (T)0.5 * nb[iPop];
+            }
+          });
+          lap += nb[iPop];
+        }
+      });
+    }
+  }
+
+private:
+  static constexpr bool isAxis(int iPop) {
+    int norm = 0;
+    for (int iD = 0; iD < K::d; ++iD) {
+      norm += Stencil::c[iPop][iD] * Stencil::c[iPop][iD];
+    }
+    return norm == 1;
+  }
+};
+
+// 3D version of FusedInterfaceFunctional2D: one pass over the phi density
+// writing grad(phi), n-hat, lap(phi) and mu_phi into the phi externals
+// (offsets from ExternalField). Applied to {phi lattice, phi density} on
+// bulk and envelope, with the density one envelope layer wider than the
+// lattice; neighbours outside the global domain are clamped to its edge.
+template <typename T, template <typename U> class Descriptor>
+class FusedInterfaceFunctional3D
+    : public BoxProcessingFunctional3D_LS<T, Descriptor, T> {
+public:
+  FusedInterfaceFunctional3D(T beta, T kappa, Box3D globalDomain,
+                             InterfaceStencil stencil)
+      : beta_(beta), kappa_(kappa), globalDomain_(globalDomain),
+        stencil_(stencil) {}
+
+  void process(Box3D domain, BlockLattice3D<T, Descriptor> &lattice,
+               ScalarField3D<T> &phi) override {
+    typedef typename ComputeType<T>::type C;
+    typedef typename StencilOf<Descriptor<T>::d, Descriptor<T>::q>::type
+        Stencil;
+    typedef LatticeKernels<C, Stencil> K;
+    typedef LatticeInterfaceKernels<C, Stencil> IK;
+    typedef typename Descriptor<T>::ExternalField Externals;
+
+    Dot3D offset = computeRelativeDisplacement(lattice, phi);
+    Dot3D location = lattice.getLocation();
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      plint xs[3];
+      neighbours(iX, location.x, offset.x, globalDomain_.x0,
+                 globalDomain_.x1, xs);
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        plint ys[3];
+        neighbours(iY, location.y, offset.y, globalDomain_.y0,
+                   globalDomain_.y1, ys);
+        for (plint iZ = domain.z0; iZ <= domain.z1; ++iZ) {
+          plint zs[3];
+          neighbours(iZ, location.z, offset.z, globalDomain_.z0,
+                     globalDomain_.z1, zs);
+
+          C nb[K::q];
+          K::unroll([&](auto i) {
+            constexpr int iPop = decltype(i)::value;
+            nb[iPop] = (C)phi.get(xs[1 + K::template c<iPop, 0>()],
+                                  ys[1 + K::template c<iPop, 1>()],
+                                  zs[1 + K::template c<iPop, 2>()]);
+          });
+
+          C grad[3], lap;
+          IK::gradLaplacian(nb, stencil_, grad, lap);
+          const C invMag = (C)1 / std::sqrt(K::normSqr(grad) + (C)1e-16);
+          const C mu = InterfaceKernels<C>::chemicalPotential(
+              nb[0], lap, (C)beta_, (C)kappa_);
+
+          Cell<T, Descriptor> &cell = lattice.get(iX, iY, iZ);
+          T *storedGrad = cell.getExternal(Externals::gradBeginsAt);
+          T *nHat = cell.getExternal(Externals::normGradBeginsAt);
+          for (int iD = 0; iD < 3; ++iD) {
+            storedGrad[iD] = (T)grad[iD];
+            nHat[iD] = (T)(grad[iD] * invMag);
+          }
+          *cell.getExternal(Externals::laplaceBeginsAt) = (T)lap;
+          *cell.getExternal(Externals::muBeginsAt) = (T)mu;
+        }
+      }
+    }
+  }
+
+  FusedInterfaceFunctional3D<T, Descriptor> *clone() const override {
+    return new FusedInterfaceFunctional3D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables; // phi lattice externals
+    modified[1] = modif::nothing;         // phi density
+  }
+
+  BlockDomain::DomainT appliesTo() const override {
+    return BlockDomain::bulkAndEnvelope;
+  }
+
+private:
+  // Density indices of the cell at local coordinate i and its two
+  // neighbours along one axis, clamped to the global domain [g0, g1].
+  static void neighbours(plint i, plint location, plint offset, plint g0,
+                         plint g1, plint (&out)[3]) {
+    plint g = i + location;
+    out[0] = std::max(g - 1, g0) - location + offset;
+    out[1] = i + offset;
+    out[2] = std::min(g + 1, g1) - location + offset;
+  }
+
+  T beta_, kappa_;
+  Box3D globalDomain_;
+  InterfaceStencil stencil_;
+};
+
+#endif
@@ -0,0 +1,384 @@
+#ifndef LATTICE_KERNELS_H
+#define LATTICE_KERNELS_H
+
+#include <array>
+#include <type_traits>
+#include <utility>
+
+// Arithmetic type of the per-cell kernels for populations stored as T.
+// Single-precision storage is evaluated in double: moments, equilibria and
+// source terms are computed from widened populations, and rounding happens
+// only when the post-collision populations are stored back.
+template <typename T> struct ComputeType {
+  typedef T type;
+};
+template <> struct ComputeType<float> {
+  typedef double type;
+};
+
+// Velocity sets in the ordering of the Palabos descriptors of the same
+// name; the weights are w[i] / weightDenominator.
+struct D2Q9Stencil {
+  static constexpr int d = 2;
+  static constexpr int q = 9;
+  static constexpr int c[q][d] = {{0, 0},  {-1, 1}, {-1, 0}, {-1, -1}, {0, -1},
+                                  {1, -1}, {1, 0},  {1, 1},  {0, 1}};
+  static constexpr int w[q] = {16, 1, 4, 1, 4, 1, 4, 1, 4};
+  static constexpr int weightDenominator = 36;
+};
+
+struct D3Q19Stencil {
+  static constexpr int d = 3;
+  static constexpr int q = 19;
+  static constexpr int c[q][d] = {
+      {0, 0, 0},   {-1, 0, 0}, {0, -1, 0}, {0, 0, -1}, {-1, -1, 0},
+      {-1, 1, 0},  {-1, 0, -1}, {-1, 0, 1}, {0, -1, -1}, {0, -1, 1},
+      {1, 0, 0},   {0, 1, 0},  {0, 0, 1},  {1, 1, 0},  {1, -1, 0},
+      {1, 0, 1},   {1, 0, -1}, {0, 1, 1},  {0, 1, -1}};
+  static constexpr int w[q] = {12, 2, 2, 2, 1, 1, 1, 1, 1, 1,
+                               2,  2, 2, 1, 1, 1, 1, 1, 1};
+  static constexpr int weightDenominator = 36;
+};
+
+struct D3Q27Stencil {
+  static constexpr int d = 3;
+  static constexpr int q = 27;
+  static constexpr int c[q][d] = {
+      {0, 0, 0},    {-1, 0, 0},  {0, -1, 0},  {0, 0, -1},  {-1, -1, 0},
+      {-1, 1, 0},   {-1, 0, -1}, {-1, 0, 1},  {0, -1, -1}, {0, -1, 1},
+      {-1, -1, -1}, {-1, -1, 1}, {-1, 1, -1}, {-1, 1, 1},  {1, 0, 0},
+      {0, 1, 0},    {0, 0, 1},   {1, 1, 0},   {1, -1, 0},  {1, 0, 1},
+      {1, 0, -1},   {0, 1, 1},   {0, 1, -1},  {1, 1, 1},   {1, 1, -1},
+      {1, -1, 1},   {1, -1, -1}};
+  static constexpr int w[q] = {64, 16, 16, 16, 4, 4,  4,  4,  4,
+                               4,  1,  1,  1,  1, 16, 16, 16, 4,
+                               4,  4,  4,  4,  4, 1,  1,  1,  1};
+  static constexpr int weightDenominator = 216;
+};
+
+// The velocity set of a Palabos descriptor with d dimensions and q
+// populations.
+template <int d, int q> struct StencilOf;
+template <> struct StencilOf<2, 9> {
+  typedef D2Q9Stencil type;
+};
+template <> struct StencilOf<3, 19> {
+  typedef D3Q19Stencil type;
+};
+template <> struct StencilOf<3, 27> {
+  typedef D3Q27Stencil type;
+};
+
+namespace lattice_kernels_detail {
+
+template <typename T, class Stencil, int... I>
+constexpr std::array<T, Stencil::q> weights(std::integer_sequence<int, I...>) {
+  return {{((T)Stencil::w[I] / (T)Stencil::weightDenominator)...}};
+}
+
+template <class Stencil, int iD, int... I>
+constexpr std::array<int, Stencil::q>
+components(std::integer_sequence<int, I...>) {
+  return {{Stencil::c[I][iD]...}};
+}
+
+template <class Stencil> constexpr int findOpposite(int iPop) {
+  for (int j = 0; j < Stencil::q; ++j) {
+    bool opposite = true;
+    for (int iD = 0; iD < Stencil::d; ++iD) {
+      opposite = opposite && Stencil::c[j][iD] == -Stencil::c[iPop][iD];
+    }
+    if (opposite) {
+      return j;
+    }
+  }
+  return -1;
+}
+
+template <class Stencil, int... I>
+constexpr std::array<int, Stencil::q>
+opposites(std::integer_sequence<int, I...>) {
+  return {{findOpposite<Stencil>(I)...}};
+}
+
+// sum_{i>0} t_i^2 and sum_i t_i^2 c_ix^2 (the same for every axis)
+template <typename T, class Stencil> constexpr T sumSquaredWeights() {
+  T sum = (T)0;
+  for (int iPop = 1; iPop < Stencil::q; ++iPop) {
+    const T w = (T)Stencil::w[iPop] / (T)Stencil::weightDenominator;
+    sum += w * w;
+  }
+  return sum;
+}
+
+template <typename T, class Stencil> constexpr T secondMomentSquaredWeights() {
+  T sum = (T)0;
+  for (int iPop = 1; iPop < Stencil::q; ++iPop) {
+    const T w = (T)Stencil::w[iPop] / (T)Stencil::weightDenominator;
+    sum += w * w * (T)(Stencil::c[iPop][0] * Stencil::c[iPop][0]);
+  }
+  return sum;
+}
+
+} // namespace lattice_kernels_detail
+
+// Fully unrolled per-cell kernels for any of the velocity sets above, on
+// the raw populations of a Cell (Palabos stores f_i - t_i). Vectors are
+// T[d] arrays. Products with the lattice velocities are resolved at compile
+// time, so a component of c_i that is 0 costs nothing and +-1 is an add or
+// a subtract, as in hand-written D2Q9 code. The dynamics and the cell
+// kernels shared by the 2D and 3D models use these; D2Q9Kernels adds the
+// scalar 2D interface of the 2D-only functionals and the SIMD engine.
+template <typename T, class Stencil> struct LatticeKernels {
+  static constexpr int d = Stencil::d;
+  static constexpr int q = Stencil::q;
+
+  static constexpr T cs2 = (T)1 / (T)3;
+  static constexpr T invCs2 = (T)3;
+
+  template <int iPop, int iD> static constexpr int c() {
+    return Stencil::c[iPop][iD];
+  }
+
+  static constexpr std::array<T, q> t =
+      lattice_kernels_detail::weights<T, Stencil>(
+          std::make_integer_sequence<int, q>{});
+  // opposite[i] is the direction with c = -c_i
+  static constexpr std::array<int, q> opposite =
+      lattice_kernels_detail::opposites<Stencil>(
+          std::make_integer_sequence<int, q>{});
+
+  // Calls op(std::integral_constant<int, iPop>) for iPop = 0..q-1, so the
+  // body sees the direction as a compile-time constant.
+  template <class Op> static inline void unroll(Op &&op) {
+    unrollImpl(op, std::make_integer_sequence<int, q>{});
+  }
+
+  // Calls op(std::integral_constant<int, iD>) for iD = 0..d-1.
+  template <class Op> static inline void unrollDims(Op &&op) {
+    unrollImpl(op, std::make_integer_sequence<int, d>{});
+  }
+
+  // Copies the populations of a cell stored as S into f and back.
+  template <typename S> static inline void load(S const *stored, T *f) {
+    unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      f[iPop] = (T)stored[iPop];
+    });
+  }
+
+  template <typename S> static inline void store(T const *f, S *stored) {
+    unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      stored[iPop] = (S)f[iPop];
+    });
+  }
+
+  // c_iPop . v, with the zero components dropped at compile time.
+  template <int iPop> static inline T dot(T const *v) {
+    T sum = (T)0;
+    unrollDims([&](auto a) {
+      constexpr int iD = decltype(a)::value;
+      if constexpr (c<iPop, iD>() == 1) {
+        sum += v[iD];
+      } else if constexpr (c<iPop, iD>() == -1) {
+        sum -= v[iD];
+      }
+    });
+    return sum;
+  }
+
+  // Run-time direction, for Dynamics::computeEquilibrium().
+  static inline T dot(int iPop, T const *v) {
+    T sum = (T)0;
+    for (int iD = 0; iD < d; ++iD) {
+      sum += (T)Stencil::c[iPop][iD] * v[iD];
+    }
+    return sum;
+  }
+
+  static inline T normSqr(T const *v) {
+    T sum = (T)0;
+    unrollDims([&](auto a) {
+      constexpr int iD = decltype(a)::value;
+      sum += v[iD] * v[iD];
+    });
+    return sum;
+  }
+
+  // ---- Moments ----
+
+  // rhoBar = sum_i f_i and j = sum_i f_i c_i of the raw populations. With
+  // Palabos' shifted storage the full density is rhoBar + 1.
+  static inline void rhoBarJ(T const *f, T &rhoBar, T *j) {
+    rhoBar = (T)0;
+    unrollDims([&](auto a) { j[decltype(a)::value] = (T)0; });
+    unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      rhoBar += f[iPop];
+      unrollDims([&](auto a) {
+        constexpr int iD = decltype(a)::value;
+        if constexpr (c<iPop, iD>() == 1) {
+          j[iD] += f[iPop];
+        } else if constexpr (c<iPop, iD>() == -1) {
+          j[iD] -= f[iPop];
+        }
+      });
+    });
+  }
+
+  // 1 + e.u/cs2 + (e.u)^2/(2 cs4) - u.u/(2 cs2) for e.u = eu.
+  static inline T gamma(T eu, T uu) {
+    return (T)1 + invCs2 * eu + (T)0.5 * invCs2 * invCs2 * eu * eu -
+           (T)0.5 * invCs2 * uu;
+  }
+
+  // ---- Equilibria ----
+
+  // Standard second-order equilibrium t_i rho Gamma_i.
+  static inline void secondOrderEquilibria(T rho, T const *u, T *feq) {
+    const T uu = normSqr(u);
+    unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      feq[iPop] = t[iPop] * rho * gamma(dot<iPop>(u), uu);
+    });
+  }
+
+  static inline T secondOrderEquilibrium(int iPop, T rho, T const *u) {
+    return t[iPop] * rho * gamma(dot(iPop, u), normSqr(u));
+  }
+
+  // Reaction-diffusion equilibrium of custom_dynamics:
+  //   f_i = t_i chiMu/cs2 + rho t_i (t_i Gamma_i - t_i),   i > 0,
+  //   f_0 = rho - sum_{i>0} f_i.
+  // Odd moments cancel in the sum, which leaves
+  //   sum_{i>0} f_i = (1 - t_0) chiMu/cs2
+  //                 + rho u.u (sum t_i^2 c_ix^2 / (2 cs4) - sum t_i^2/(2 cs2))
+  // (5/3 chiMu + 5/108 rho u.u on D2Q9), so the rest population is O(1).
+  static constexpr T restDiffusive = ((T)1 - t[0]) * invCs2;
+  static constexpr T restKinetic =
+      (T)0.5 * invCs2 * invCs2 *
+          lattice_kernels_detail::secondMomentSquaredWeights<T, Stencil>() -
+      (T)0.5 * invCs2 *
+          lattice_kernels_detail::sumSquaredWeights<T, Stencil>();
+
+  static inline T reactionDiffusionEquilibrium(int iPop, T rho, T const *u,
+                                               T chiMu) {
+    const T uu = normSqr(u);
+    if (iPop == 0) {
+      return rho - restDiffusive * chiMu - restKinetic * rho * uu;
+    }
+    const T w = t[iPop];
+    return w * chiMu * invCs2 + rho * w * w * (gamma(dot(iPop, u), uu) - (T)1);
+  }
+
+  static inline void reactionDiffusionEquilibria(T rho, T const *u, T chiMu,
+                                                 T *feq) {
+    const T uu = normSqr(u);
+    feq[0] = rho - restDiffusive * chiMu - restKinetic * rho * uu;
+    const T diffusive = chiMu * invCs2;
+    unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      if constexpr (iPop > 0) {
+        constexpr T w = t[iPop];
+        feq[iPop] =
+            w * diffusive + rho * w * w * (gamma(dot<iPop>(u), uu) - (T)1);
+      }
+    });
+  }
+
+  // Conservative Allen-Cahn equilibrium of the phi dynamics:
+  //   f_i = t_i rho Gamma_i + t_i M/cs2 (4/zeta) rho (1 - rho) e_i.n
+  static inline T phaseFieldEquilibrium(int iPop, T rho, T const *u,
+                                        T const *n, T M, T zeta) {
+    return t[iPop] *
+           (rho * gamma(dot(iPop, u), normSqr(u)) +
+            M * invCs2 * ((T)4 / zeta) * rho * ((T)1 - rho) * dot(iPop, n));
+  }
+
+  static inline void phaseFieldEquilibria(T rho, T const *u, T const *n, T M,
+                                          T zeta, T *feq) {
+    const T uu = normSqr(u);
+    const T sharpening = M * invCs2 * ((T)4 / zeta) * rho * ((T)1 - rho);
+    unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      feq[iPop] = t[iPop] * (rho * gamma(dot<iPop>(u), uu) +
+                             sharpening * dot<iPop>(n));
+    });
+  }
+
+  // ---- Sources and relaxation ----
+
+  // Guo forcing S_i = t_i (e_i - u).F / cs2.
+  static inline void guoForcing(T const *u, T const *F, T *S) {
+    T uF = (T)0;
+    unrollDims([&](auto a) {
+      constexpr int iD = decltype(a)::value;
+      uF += u[iD] * F[iD];
+    });
+    unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      S[iPop] = t[iPop] * invCs2 * (dot<iPop>(F) - uF);
+    });
+  }
+
+  // f_i <- f_i - omega (f_i - feq_i)
+  static inline void bgkRelax(T *f, T const *feq, T omega) {
+    unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      f[iPop] -= omega * (f[iPop] - feq[iPop]);
+    });
+  }
+
+  // Two-relaxation-time collision: the parts of f - feq that are even and
+  // odd under c -> -c relax with omegaPlus and omegaMinus.
+  static inline void trtRelax(T *f, T const *feq, T omegaPlus,
+                              T omegaMinus) {
+    f[0] -= omegaPlus * (f[0] - feq[0]);
+    unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      constexpr int opp = opposite[iPop];
+      if constexpr (iPop > 0 && iPop < opp) {
+        const T neqPlus =
+            (T)0.5 * ((f[iPop] - feq[iPop]) + (f[opp] - feq[opp]));
+        const T neqMinus =
+            (T)0.5 * ((f[iPop] - feq[iPop]) - (f[opp] - feq[opp]));
+        f[iPop] -= omegaPlus * neqPlus + omegaMinus * neqMinus;
+        f[opp] -= omegaPlus * neqPlus - omegaMinus * neqMinus;
+      }
+    });
+  }
+
+  // Regularized collision for advection-diffusion: f - feq is replaced by
+  // its first-order Hermite projection t_i c_i.jNeq / cs2 before relaxing,
+  // which removes the non-hydrodynamic (ghost) modes that limit BGK.
+  static inline void regularizedFirstOrderRelax(T *f, T const *feq, T omega) {
+    T neq[q];
+    unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      neq[iPop] = f[iPop] - feq[iPop];
+    });
+    T jNeq[d];
+    T rhoBarNeq;
+    rhoBarJ(neq, rhoBarNeq, jNeq);
+    const T keep = (T)1 - omega;
+    unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      f[iPop] = feq[iPop] + keep * t[iPop] * invCs2 * dot<iPop>(jNeq);
+    });
+  }
+
+private:
+  template <class Op, int... I>
+  static inline void unrollImpl(Op &op, std::integer_sequence<int, I...>) {
+    (op(std::integral_constant<int, I>{}), ...);
+  }
+};
+
+// Kernels of the velocity set of a Palabos descriptor, evaluated in T.
+template <typename T, template <typename U> class Descriptor>
+using DescriptorKernels =
+    LatticeKernels<T, typename StencilOf<Descriptor<double>::d,
+                                         Descriptor<double>::q>::type>;
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef LIVE_VIEW_H
+#define LIVE_VIEW_H
+
+#include "palabos2D.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SnapshotIO.h"
+
+using namespace plb;
+
+// Latest fields of a running simulation in a memory-mapped ring of frames,
+// so that a monitor (python/lbm_live.py) can map the file and look at them
+// without copies, parsing or any effect on the solver. Every process
+// publishes its own blocks to its own file, e.g.
+// /dev/shm/live_p0000.lbmlive.
+//
+// Layout, little-endian, fixed by the first published frame:
+//   header (headerSize bytes)
+//     char[8]  magic "LBMLIVE", written last once the layout is complete
+//     uint32   version, header size
+//     int64    nx, ny
+//     uint32   number of fields, number of blocks, number of slots, 0
+//     uint64   slot size in bytes, offset of the first slot
+//     uint64   frames published so far; frame n lives in slot (n-1) % slots
+//     fields:  char[16] name (zero padded), uint32 components, 0
+//     blocks:  int64 x0, x1, y0, y1 (global, inclusive)
+//   slots, each slotSize bytes and 64-byte aligned
+//     uint64   sequence: 2n-1 while frame n is written into the slot, 2n
+//              once it is complete
+//     int64    step
+//     float32  values, field by field and within a field block by block,
+//              x-major with y fastest and components interleaved per cell
+//
+// Readers never block the writer (a seqlock): read the sequence of a slot,
+// skip it if odd, read the values, then read the sequence again; the frame
+// is torn unless both reads return the same even number. With more slots a
+// reader has more time before the slot it reads is reused.
+class LiveView {
+public:
+  static const std::uint32_t version = 1;
+  static const pluint maxNameLength = 16;
+
+  // Creates (or truncates) fileName; the file is sized and mapped at the
+  // first publish().
+  LiveView(std::string const &fileName, plint numSlots = 4);
+  // Unmaps the file and leaves it in place for late readers.
+  ~LiveView();
+
+  LiveView(LiveView const &) = delete;
+  LiveView &operator=(LiveView const &) = delete;
+
+  // Copies a staged frame into the next slot. One writer thread at a time;
+  // every frame must have the fields and blocks of the first one.
+  void publish(SnapshotFrame const &frame);
+
+  std::string const &getFileName() const { return fileName_; }
+  std::uint64_t getNumPublished() const { return published_; }
+
+  // <directory>/live_p<rank>.lbmlive
+  static std::string fileNameFor(std::string const &directory, int rank);
+
+private:
+  void map(SnapshotFrame const &frame);
+
+  std::string fileName_;
+  plint numSlots_;
+  int fd_ = -1;
+  char *data_ = nullptr;
+  std::size_t size_ = 0;
+  std::uint64_t slotSize_ = 0, dataOffset_ = 0;
+  std::uint64_t published_ = 0;
+  // layout of the mapped frames
+  std::vector<SnapshotField> fields_;
+  std::vector<Box2D> blocks_;
+};
+
+#endif
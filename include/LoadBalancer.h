@@ -0,0 +1,253 @@
+#ifndef LOAD_BALANCER_H
+#define LOAD_BALANCER_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "DropletModel.h"
+#include "Profiler.h"
+
+using namespace plb;
+
+// When and how a distributed model is repartitioned, and the relative cost
+// of a cell update by the state of the cell: every cell collides and
+// streams the four lattices; inside the droplet the species collision
+// adds the reaction term, and in the interface band the stencil, the
+// surface force and the phase-field forcing do real work. The default
+// weights are estimates; calibrate them with lbm_bench on the target.
+struct BalanceParameters {
+  // steps between checks of the imbalance; 0 never checks
+  plint every = 0;
+  // repartition when the most loaded rank exceeds the mean by this factor
+  double threshold = 1.1;
+  // resolution of the cost map and granularity of the cuts, in cells
+  plint tileSize = 8;
+  double bulkCost = 1.0, dropletCost = 0.3, interfaceCost = 0.6;
+  // cells with interfaceBand < phi < 1 - interfaceBand are interface
+  double interfaceBand = 0.01;
+};
+
+// Cost of one step per tile of the global domain, accumulated by the
+// blocks of each rank and combined over all ranks, so that every rank
+// holds the whole map and the cost of every rank. Tiles are tileSize wide
+// except the last of a row, which takes the remainder, so none is thinner
+// than tileSize (or the domain).
+class CostMap {
+public:
+  CostMap(Box2D domain, plint tileSize);
+
+  void add(plint x, plint y, double cost) {
+    tiles_[tileX(x) * numTilesY_ + tileY(y)] += cost;
+    localCost_ += cost;
+  }
+  // Sums the tiles over the ranks and gathers the cost of each rank.
+  // Collective.
+  void combineRanks();
+
+  Box2D getDomain() const { return domain_; }
+  plint getNumTilesX() const { return numTilesX_; }
+  plint getNumTilesY() const { return numTilesY_; }
+  double getTile(plint tileX, plint tileY) const {
+    return tiles_[tileX * numTilesY_ + tileY];
+  }
+  // Cells of the tiles tileX0..tileX1 x tileY0..tileY1.
+  Box2D cellsOf(plint tileX0, plint tileX1, plint tileY0,
+                plint tileY1) const;
+
+  // After combineRanks().
+  std::vector<double> const &getRankCosts() const { return rankCosts_; }
+  // Cost of the most loaded rank over the mean, 1 when balanced.
+  double getImbalance() const;
+
+private:
+  plint tileX(plint x) const {
+    return std::min((x - domain_.x0) / tileSize_, numTilesX_ - 1);
+  }
+  plint tileY(plint y) const {
+    return std::min((y - domain_.y0) / tileSize_, numTilesY_ - 1);
+  }
+
+  Box2D domain_;
+  plint tileSize_;
+  plint numTilesX_, numTilesY_;
+  std::vector<double> tiles_;
+  double localCost_ = 0;
+  std::vector<double> rankCosts_;
+};
+
+// Cuts the domain of costs into numParts boxes of about equal cost by
+// orthogonal recursive bisection: each box is split across its longer
+// side at the tile boundary that shares its cost in proportion to the
+// parts on either side. A box of a single tile goes whole to its first
+// part; the others are then empty (x1 < x0).
+std::vector<Box2D> bisectByCost(CostMap const &costs, plint numParts);
+
+// Cost of each box of parts, at the resolution of the tiles; boxes must
+// be unions of tiles, as from bisectByCost().
+std::vector<double> costOfParts(CostMap const &costs,
+                                std::vector<Box2D> const &parts);
+
+// One block per non-empty part, part i on rank i.
+MultiBlockManagement2D partitionManagement(Box2D domain,
+                                           std::vector<Box2D> const &parts,
+                                           plint envelopeWidth);
+
+// Adds the cost of every cell of the phi lattice to a CostMap, by the
+// weights of BalanceParameters. Apply on the bulk.
+template <typename T, template <typename U> class Descriptor>
+class CellCostFunctional2D : public BoxProcessingFunctional2D_L<T, Descriptor> {
+public:
+  CellCostFunctional2D(CostMap *costs, BalanceParameters const &params)
+      : costs_(costs), params_(params) {}
+
+  void process(Box2D domain, BlockLattice2D<T, Descriptor> &phi) override {
+    Dot2D location = phi.getLocation();
+    const double band = params_.interfaceBand;
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        double value = (double)phi.get(iX, iY).computeDensity();
+        double cost = params_.bulkCost;
+        if (value >= 0.5) {
+          cost += params_.dropletCost;
+        }
+        if (value > band && value < 1. - band) {
+          cost += params_.interfaceCost;
+        }
+        costs_->add(iX + location.x, iY + location.y, cost);
+      }
+    }
+  }
+
+  CellCostFunctional2D<T, Descriptor> *clone() const override {
+    return new CellCostFunctional2D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::nothing;
+  }
+
+private:
+  CostMap *costs_;
+  BalanceParameters params_;
+};
+
+// Keeps the ranks of a distributed DropletModel evenly loaded as the
+// droplet moves. Every `every` steps it maps the cell costs of the current
+// state; if the imbalance exceeds the threshold and a new cut
+// (bisectByCost, one block per rank) would lower it, the model migrates
+// to the new cut (DropletModel::repartition). Each repartition is logged
+// with what it cost, and at the next check with the step time it saved.
+template <typename T, template <typename U> class Descriptor>
+class LoadBalancer {
+public:
+  explicit LoadBalancer(BalanceParameters const &params) : params_(params) {}
+
+  // Advances model by one step, then checks the balance when due.
+  // Collective.
+  void step(DropletModel<T, Descriptor> &model) {
+    Clock::time_point begin = Clock::now();
+    model.step();
+    stepSeconds_ +=
+        std::chrono::duration<double>(Clock::now() - begin).count();
+    ++numSteps_;
+    if (params_.every > 0 &&
+        model.getScheduler().getNumSteps() % params_.every == 0) {
+      check(model);
+    }
+  }
+
+  plint getNumRepartitions() const { return numRepartitions_; }
+  double getRepartitionSeconds() const { return repartitionSeconds_; }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  void check(DropletModel<T, Descriptor> &model) {
+    ProfileScope scope("balance.check", "transfer");
+    plint step = model.getScheduler().getNumSteps();
+    // the slowest rank sets the pace
+    double meanStep = maxOverRanks(stepSeconds_) / (double)numSteps_;
+    stepSeconds_ = 0;
+    numSteps_ = 0;
+    if (pending_) {
+      double saved = lastStepTime_ - meanStep;
+      pcout << "balance: step time " << lastStepTime_ << " s before the "
+            << "repartition at step " << lastRepartitionStep_ << ", "
+            << meanStep << " s after; ";
+      if (saved > 0) {
+        pcout << "its " << lastRepartitionCost_ << " s are repaid after "
+              << (plint)std::ceil(lastRepartitionCost_ / saved) << " steps"
+              << std::endl;
+      } else {
+        pcout << "no time saved for its " << lastRepartitionCost_ << " s"
+              << std::endl;
+      }
+      pending_ = false;
+    }
+
+    Box2D domain = model.getPhi().getBoundingBox();
+    CostMap costs(domain, params_.tileSize);
+    applyProcessingFunctional(
+        new CellCostFunctional2D<T, Descriptor>(&costs, params_), domain,
+        model.getPhi());
+    costs.combineRanks();
+    double imbalance = costs.getImbalance();
+    if (imbalance <= params_.threshold) {
+      return;
+    }
+    std::vector<Box2D> parts =
+        bisectByCost(costs, (plint)global::mpi().getSize());
+    std::vector<double> partCosts = costOfParts(costs, parts);
+    double total = 0, largest = 0;
+    for (double cost : partCosts) {
+      total += cost;
+      largest = std::max(largest, cost);
+    }
+    // not worth a migration unless the cut gains a good part of the margin
+    double predicted = largest * (double)partCosts.size() / total;
+    if (imbalance - predicted < 0.5 * (params_.threshold - 1.)) {
+      return;
+    }
+
+    Clock::time_point begin = Clock::now();
+    model.repartition(partitionManagement(
+        domain, parts, DropletModel<T, Descriptor>::latticeEnvelope));
+    double seconds = maxOverRanks(
+        std::chrono::duration<double>(Clock::now() - begin).count());
+    pcout << "balance: step " << step << ", cost imbalance " << imbalance
+          << ", repartitioned to " << predicted << " in " << seconds << " s"
+          << std::endl;
+
+    ++numRepartitions_;
+    repartitionSeconds_ += seconds;
+    pending_ = true;
+    lastRepartitionStep_ = step;
+    lastRepartitionCost_ = seconds;
+    lastStepTime_ = meanStep;
+  }
+
+  static double maxOverRanks(double value) {
+#ifdef PLB_MPI_PARALLEL
+    MPI_Allreduce(MPI_IN_PLACE, &value, 1, MPI_DOUBLE, MPI_MAX,
+                  global::mpi().getGlobalCommunicator());
+#endif
+    return value;
+  }
+
+  BalanceParameters params_;
+  double stepSeconds_ = 0;
+  plint numSteps_ = 0;
+  plint numRepartitions_ = 0;
+  double repartitionSeconds_ = 0;
+  // the last repartition, reported at the next check
+  bool pending_ = false;
+  plint lastRepartitionStep_ = 0;
+  double lastRepartitionCost_ = 0, lastStepTime_ = 0;
+};
+
+#endif
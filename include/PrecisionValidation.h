@@ -0,0 +1,102 @@
+#ifndef PRECISION_VALIDATION_H
+#define PRECISION_VALIDATION_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include <cmath>
+#include <vector>
+
+#include "DropletModel.h"
+
+using namespace plb;
+
+// Quantities compared between a double-precision reference and a model
+// stored in another precision: the phi integral (droplet mass), the radius
+// of the disc of that area and the phi, c1 and c2 profiles along the
+// horizontal line through the droplet centre.
+struct DropletSample {
+  double mass = 0;
+  double radius = 0;
+  std::vector<double> phi, c1, c2;
+};
+
+struct PrecisionDeviation {
+  // relative to the reference
+  double mass = 0, radius = 0;
+  // largest absolute difference along the profile
+  double phi = 0, c1 = 0, c2 = 0;
+
+  void takeMax(PrecisionDeviation const &other);
+};
+
+// Sums the samples of all ranks into every rank and sets the radius.
+void allReduce(DropletSample &sample);
+PrecisionDeviation compare(DropletSample const &reference,
+                           DropletSample const &other);
+
+// Accumulates the phi integral and the profiles of row y of {c1, c2, phi}
+// for the local blocks; allReduce() combines the ranks.
+template <typename T, template <typename U> class Descriptor>
+class SampleDropletFunctional2D
+    : public LatticeBoxProcessingFunctional2D<T, Descriptor> {
+public:
+  SampleDropletFunctional2D(DropletSample *sample, plint y)
+      : sample_(sample), y_(y) {}
+
+  void process(Box2D domain,
+               std::vector<BlockLattice2D<T, Descriptor> *> lattices) override {
+    PLB_PRECONDITION(lattices.size() == 3);
+    Dot2D location = lattices[0]->getLocation();
+    // c1 and c2 may have a wider envelope than phi (temporal blocking)
+    Dot2D offset = computeRelativeDisplacement(*lattices[0], *lattices[2]);
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        double phi = (double)lattices[2]
+                         ->get(iX + offset.x, iY + offset.y)
+                         .computeDensity();
+        sample_->mass += phi;
+        if (iY + location.y == y_) {
+          plint x = iX + location.x;
+          sample_->phi[x] = phi;
+          sample_->c1[x] = (double)lattices[0]->get(iX, iY).computeDensity();
+          sample_->c2[x] = (double)lattices[1]->get(iX, iY).computeDensity();
+        }
+      }
+    }
+  }
+
+  SampleDropletFunctional2D<T, Descriptor> *clone() const override {
+    return new SampleDropletFunctional2D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::nothing;
+    modified[1] = modif::nothing;
+    modified[2] = modif::nothing;
+  }
+
+private:
+  DropletSample *sample_;
+  plint y_;
+};
+
+// Collective.
+template <typename T, template <typename U> class Descriptor>
+DropletSample sampleDroplet(DropletModel<T, Descriptor> &model) {
+  DropletParameters const &params = model.getParameters();
+  DropletSample sample;
+  sample.phi.assign(params.nx, 0.);
+  sample.c1.assign(params.nx, 0.);
+  sample.c2.assign(params.nx, 0.);
+  model.catchUpSpecies();
+  std::vector<MultiBlockLattice2D<T, Descriptor> *> lattices = {
+      &model.getC1(), &model.getC2(), &model.getPhi()};
+  applyProcessingFunctional(
+      new SampleDropletFunctional2D<T, Descriptor>(&sample, params.ny / 2),
+      model.getPhi().getBoundingBox(), lattices);
+  allReduce(sample);
+  return sample;
+}
+
+#endif
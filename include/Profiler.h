@@ -0,0 +1,107 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "palabos2D.h"
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+using namespace plb;
+
+// Timeline of named scopes on every thread of a rank: scheduler stages,
+// envelope exchanges, output and level transfers. Each thread appends to
+// its own buffer, so recording takes no lock; when the profiler is
+// disabled a scope costs one relaxed load.
+//
+// Enabled from the environment (Profiler::configure()): LBM_PROFILE is a
+// comma-separated list of
+//   on        record scopes;
+//   sync      time a barrier before each exchange, so that the wait for the
+//             slowest rank (load imbalance) is reported apart from the
+//             communication itself;
+//   counters  read cycles, instructions and cache misses of the thread
+//             around each scope (Linux perf events; ignored when the kernel
+//             refuses them).
+// sync and counters imply on.
+class Profiler {
+public:
+  enum Counter { cycles, instructions, cacheMisses, numCounters };
+
+  struct Event {
+    // Copy owned by the profiler, which outlives the named object.
+    char const *name;
+    char const *category;
+    std::int64_t begin;    // ns since the profiler was enabled
+    std::int64_t duration; // ns
+    std::int64_t wait;     // ns spent waiting for other ranks
+    plint cells;
+    std::uint64_t counters[numCounters];
+  };
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+  static bool measuresImbalance() { return sync_; }
+  static bool readsCounters() { return counters_; }
+
+  static void configure();
+  static void enable(bool sync = false, bool counters = false);
+  static void disable() { enabled_.store(false); }
+  // Drops the recorded events of all threads; call while the other threads
+  // are idle.
+  static void clear();
+
+  // Label of the calling thread in the trace.
+  static void setThreadName(std::string const &name);
+  static std::int64_t now();
+  // Hardware counters of the calling thread; zeros without counters.
+  static void readCounters(std::uint64_t values[numCounters]);
+  static void record(Event const &event);
+
+  // The exports read the buffers of all threads: call them while the other
+  // threads are idle (e.g. after AsyncOutputWriter::flush()).
+  //
+  // Chrome trace of this rank (chrome://tracing, ui.perfetto.dev), with
+  // the rank as process and the threads as tracks. Not collective.
+  static void writeChromeTrace(std::string const &fileName);
+  // Per scope name: calls, total and maximum time, wait, throughput and,
+  // with counters, instructions per cycle and misses per cell; the totals
+  // are averaged over the ranks and the slowest rank is shown as well.
+  // Collective; only rank 0 writes.
+  static void printSummary(std::ostream &out);
+
+private:
+  static std::atomic<bool> enabled_;
+  static bool sync_;
+  static bool counters_;
+};
+
+// Records the enclosing block as one event of the calling thread.
+class ProfileScope {
+public:
+  ProfileScope(char const *name, char const *category, plint cells = 0)
+      : active_(Profiler::enabled()) {
+    if (active_) {
+      begin(name, category, cells);
+    }
+  }
+
+  ~ProfileScope() {
+    if (active_) {
+      end();
+    }
+  }
+
+  void addWait(std::int64_t nanoseconds) { event_.wait += nanoseconds; }
+
+private:
+  ProfileScope(ProfileScope const &);
+  ProfileScope &operator=(ProfileScope const &);
+
+  void begin(char const *name, char const *category, plint cells);
+  void end();
+
+  bool active_;
+  Profiler::Event event_;
+};
+
+#endif
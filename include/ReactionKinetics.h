@@ -0,0 +1,143 @@
+#ifndef REACTION_KINETICS_H
+#define REACTION_KINETICS_H
+
+#include <algorithm>
+#include <cmath>
+
+// How the species reaction is advanced.
+enum class ReactionScheme {
+  // source added inside the species collision at every step
+  explicitSource,
+  // operator split, backward Euler with Newton iterations; stable for any
+  // epsilon and any reaction period
+  implicitEuler,
+  // operator split, embedded Heun-Euler pair with error-controlled substeps
+  adaptiveRK
+};
+
+// Cell-local kinetics of the two species,
+//   inside the droplet (phi >= 1/2):
+//     dc1/dt = (1/epsilon) (c1 (c1 - 1) - b c2 (c1 - a) / (c1 + a))
+//     dc2/dt = c1 - c2
+//   outside, relaxation to the bath:
+//     dc/dt = -(c - cBulk)
+template <typename T> struct ReactionKinetics {
+  T a, b, epsilon, cBulk;
+
+  void rates(bool inside, T c1, T c2, T &r1, T &r2) const {
+    if (inside) {
+      r1 = (c1 * (c1 - (T)1) - b * c2 * (c1 - a) / (c1 + a)) / epsilon;
+      r2 = c1 - c2;
+    } else {
+      r1 = -(c1 - cBulk);
+      r2 = -(c2 - cBulk);
+    }
+  }
+
+  // J[k][l] = d r_k / d c_l
+  void jacobian(bool inside, T c1, T c2, T (&J)[2][2]) const {
+    if (inside) {
+      const T s = c1 + a;
+      J[0][0] = ((T)2 * c1 - (T)1 - b * c2 * (T)2 * a / (s * s)) / epsilon;
+      J[0][1] = -b * (c1 - a) / s / epsilon;
+      J[1][0] = (T)1;
+      J[1][1] = (T)-1;
+    } else {
+      J[0][0] = J[1][1] = (T)-1;
+      J[0][1] = J[1][0] = (T)0;
+    }
+  }
+};
+
+// Advances the kinetics of one cell over a time span. Concentrations are
+// kept non-negative, as the density floor of lattice_coupling does.
+template <typename T> struct ReactionIntegrator {
+  ReactionScheme scheme = ReactionScheme::implicitEuler;
+  // implicitEuler: fixed number of substeps per span;
+  // adaptiveRK: initial number of substeps
+  int substeps = 1;
+  // adaptiveRK: local error tolerance, relative to 1 + |c|
+  T tolerance = (T)1e-6;
+
+  static const int maxNewtonIterations = 20;
+  static const int maxAdaptiveSteps = 100000;
+
+  // Returns the number of substeps taken.
+  int advance(ReactionKinetics<T> const &kinetics, bool inside, T &c1, T &c2,
+              T dt) const {
+    if (scheme == ReactionScheme::adaptiveRK) {
+      return advanceAdaptive(kinetics, inside, c1, c2, dt);
+    }
+    const int n = std::max(substeps, 1);
+    for (int i = 0; i < n; ++i) {
+      backwardEuler(kinetics, inside, c1, c2, dt / (T)n);
+    }
+    return n;
+  }
+
+  // Solves c - c0 - h r(c) = 0 by Newton's method from c = c0.
+  static void backwardEuler(ReactionKinetics<T> const &kinetics, bool inside,
+                            T &c1, T &c2, T h) {
+    const T c10 = c1, c20 = c2;
+    for (int iter = 0; iter < maxNewtonIterations; ++iter) {
+      T r1, r2, J[2][2];
+      kinetics.rates(inside, c1, c2, r1, r2);
+      kinetics.jacobian(inside, c1, c2, J);
+      const T g1 = c1 - c10 - h * r1;
+      const T g2 = c2 - c20 - h * r2;
+      const T m00 = (T)1 - h * J[0][0], m01 = -h * J[0][1];
+      const T m10 = -h * J[1][0], m11 = (T)1 - h * J[1][1];
+      const T det = m00 * m11 - m01 * m10;
+      if (std::abs(det) < (T)1e-300) {
+        break;
+      }
+      const T d1 = (-g1 * m11 + g2 * m01) / det;
+      const T d2 = (-g2 * m00 + g1 * m10) / det;
+      c1 = std::max(c1 + d1, (T)0);
+      c2 = std::max(c2 + d2, (T)0);
+      if (std::abs(d1) + std::abs(d2) <=
+          (T)1e-12 * ((T)1 + std::abs(c1) + std::abs(c2))) {
+        break;
+      }
+    }
+  }
+
+  // Heun's method with the embedded Euler step as error estimate. Falls back
+  // to backward Euler for the rest of the span if the kinetics are too stiff
+  // for maxAdaptiveSteps explicit substeps.
+  int advanceAdaptive(ReactionKinetics<T> const &kinetics, bool inside, T &c1,
+                      T &c2, T dt) const {
+    T t = (T)0;
+    T h = dt / (T)std::max(substeps, 1);
+    int numSteps = 0;
+    while (t < dt) {
+      if (numSteps == maxAdaptiveSteps) {
+        backwardEuler(kinetics, inside, c1, c2, dt - t);
+        return numSteps + 1;
+      }
+      h = std::min(h, dt - t);
+      T k11, k12, k21, k22;
+      kinetics.rates(inside, c1, c2, k11, k12);
+      const T e1 = std::max(c1 + h * k11, (T)0);
+      const T e2 = std::max(c2 + h * k12, (T)0);
+      kinetics.rates(inside, e1, e2, k21, k22);
+      const T n1 = c1 + (T)0.5 * h * (k11 + k21);
+      const T n2 = c2 + (T)0.5 * h * (k12 + k22);
+      const T err = std::max(std::abs(n1 - e1) / ((T)1 + std::abs(n1)),
+                             std::abs(n2 - e2) / ((T)1 + std::abs(n2))) /
+                    tolerance;
+      ++numSteps;
+      if (err <= (T)1) {
+        t += h;
+        c1 = std::max(n1, (T)0);
+        c2 = std::max(n2, (T)0);
+      }
+      const T factor =
+          (err > (T)0) ? (T)0.9 / std::sqrt(err) : (T)4;
+      h *= std::min((T)4, std::max((T)0.2, factor));
+    }
+    return numSteps;
+  }
+};
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef REFINED_DROPLET_MODEL_H
+#define REFINED_DROPLET_MODEL_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include <array>
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "DropletModel.h"
+#include "GridRefinement.h"
+#include "Profiler.h"
+#include "StepScheduler.h"
+
+using namespace plb;
+
+// Droplet model on two levels: a coarse DropletModel over the whole domain
+// and a fine DropletModel over a patch of coarse nodes that follows the
+// interface band. The parameters describe the coarse level; the fine level
+// gets them from refineParameters(), with the zeta and M of the refinement
+// parameters where these are set, so that the interface can be thinner
+// there than the coarse level resolves. A zeta set this way also rescales
+// kappa and beta, so that the free-energy interface has that width too and
+// the surface tension is unchanged.
+//
+// One coarse step:
+//  1. the coarse level steps; the records on the patch edge before and
+//     after the step bound the fine boundary in time;
+//  2. the fine level takes ratio steps, each after resetting its outer
+//     ring of cells from the coarse edge records (bilinear in space,
+//     linear in time, non-equilibrium rescaled);
+//  3. the coarse nodes inside the patch are overwritten with the
+//     coinciding fine nodes (restriction).
+// Every regridEvery coarse steps the band is located on the coarse phi
+// density; if it has come closer than bandWidth / 2 to the patch edge, a
+// new patch is built: interpolated from the coarse level and overwritten
+// with the old fine data where the patches overlap.
+//
+// The reaction must be operator split, since the fine level advances it
+// by 1 / ratio per step.
+template <typename T, template <typename U> class Descriptor>
+class RefinedDropletModel {
+public:
+  RefinedDropletModel(DropletParameters const &params,
+                      RefinementParameters const &refinement)
+      : params_(params), refinement_(refinement), coarse_(params) {
+    PLB_PRECONDITION(refinement.ratio >= 2);
+    if (params.reaction == ReactionScheme::explicitSource) {
+      throw PlbLogicErrorException(
+          "RefinedDropletModel: the reaction must be operator split "
+          "(implicitEuler or adaptiveRK)");
+    }
+  }
+
+  // Droplet at the domain centre, resolved on the fine patch from the start.
+  void initialize() {
+    coarse_.initialize();
+    plint cx = params_.nx / 2;
+    plint cy = params_.ny / 2;
+    plint extent = (plint)std::ceil(params_.r0 + params_.zeta);
+    patch_ = patchAround(Box2D(cx - extent, cx + extent, cy - extent,
+                               cy + extent));
+    fine_ = makeFine(patch_);
+    plint r = refinement_.ratio;
+    fine_->initialize(r * (cx - patch_.x0), r * (cy - patch_.y0));
+
+    restrictToCoarse();
+    coarse_.refreshDerivedFields();
+    setRing();
+  }
+
+  void step() {
+    std::swap(ringOld_, ringNew_);
+    coarse_.step();
+    gatherRing(ringNew_);
+
+    const plint r = refinement_.ratio;
+    for (plint s = 0; s < r; ++s) {
+      scatterRing((T)s / (T)r);
+      fine_->step();
+    }
+    restrictToCoarse();
+    coarse_.refreshDerivedFields();
+
+    ++numSteps_;
+    if (refinement_.regridEvery > 0 &&
+        numSteps_ % refinement_.regridEvery == 0) {
+      checkBand();
+    }
+  }
+
+  DropletModel<T, Descriptor> &getCoarse() { return coarse_; }
+  DropletModel<T, Descriptor> &getFine() { return *fine_; }
+  RefinementParameters const &getRefinement() const { return refinement_; }
+  // Coarse nodes covered by the fine level.
+  Box2D getPatch() const { return patch_; }
+  plint getNumRegrids() const { return numRegrids_; }
+
+private:
+  typedef std::vector<MultiBlockLattice2D<T, Descriptor> *> Lattices;
+
+  static Lattices lattices(DropletModel<T, Descriptor> &model) {
+    return {&model.getPhi(), &model.getC1(), &model.getC2(),
+            &model.getMomentum()};
+  }
+
+  LevelPhysics<T, Descriptor> coarsePhysics() const {
+    return LevelPhysics<T, Descriptor>{params_, (T)1};
+  }
+
+  LevelPhysics<T, Descriptor> finePhysics(DropletModel<T, Descriptor> &fine) {
+    return LevelPhysics<T, Descriptor>{fine.getParameters(),
+                                       (T)1 / (T)refinement_.ratio};
+  }
+
+  std::unique_ptr<DropletModel<T, Descriptor>> makeFine(Box2D patch) {
+    DropletParameters fine =
+        refineParameters(params_, refinement_.ratio, patch);
+    if (refinement_.fineZeta > 0) {
+      // The free-energy interface width goes as sqrt(kappa / beta) and the
+      // surface tension as sqrt(kappa beta): scale the width by s like zeta
+      // and keep the tension refineParameters() gives.
+      const double s = refinement_.fineZeta / fine.zeta;
+      fine.zeta = refinement_.fineZeta;
+      fine.kappa *= s;
+      fine.beta /= s;
+    }
+    if (refinement_.fineM > 0) {
+      fine.M = refinement_.fineM;
+    }
+    return std::unique_ptr<DropletModel<T, Descriptor>>(
+        new DropletModel<T, Descriptor>(fine));
+  }
+
+  // band enlarged by bandWidth, clipped to the domain
+  Box2D patchAround(Box2D band) {
+    Box2D patch;
+    intersect(band.enlarge(refinement_.bandWidth),
+              coarse_.getPhi().getBoundingBox(), patch);
+    return patch;
+  }
+
+  // fine coordinates of a box of coarse nodes of patch
+  Box2D toFine(Box2D box, Box2D patch) const {
+    plint r = refinement_.ratio;
+    return Box2D(r * (box.x0 - patch.x0), r * (box.x1 - patch.x0),
+                 r * (box.y0 - patch.y0), r * (box.y1 - patch.y0));
+  }
+
+  static bool inside(Box2D box, Box2D outer) {
+    return box.x0 >= outer.x0 && box.x1 <= outer.x1 && box.y0 >= outer.y0 &&
+           box.y1 <= outer.y1;
+  }
+
+  void gather(LevelBuffer &buffer, DropletModel<T, Descriptor> &model,
+              LevelPhysics<T, Descriptor> const &physics, LevelMap map,
+              Box2D domain) {
+    buffer.clear();
+    applyProcessingFunctional(
+        new GatherLevelFunctional2D<T, Descriptor>(&buffer, physics, map),
+        domain, lattices(model));
+    buffer.allReduce();
+  }
+
+  // Like DropletModel's stages, leaves the envelopes consistent without an
+  // exchange by writing them as well.
+  void scatter(LevelBuffer const &older, LevelBuffer const &newer, T alpha,
+               LevelPhysics<T, Descriptor> const &from,
+               LevelPhysics<T, Descriptor> const &to, LevelMap map,
+               DropletModel<T, Descriptor> &model, Box2D domain) {
+    Lattices target = lattices(model);
+    std::vector<MultiBlock2D *> blocks(target.begin(), target.end());
+    applyProcessingFunctional(
+        new DeferredSyncFunctional2D(
+            new ScatterLevelFunctional2D<T, Descriptor>(&older, &newer, alpha,
+                                                        from, to, map),
+            BlockDomain::bulkAndEnvelope),
+        domain, blocks);
+  }
+
+  // the four edges of a patch, as boxes of coarse nodes
+  static std::array<Box2D, 4> edges(Box2D patch) {
+    return {Box2D(patch.x0, patch.x0, patch.y0, patch.y1),
+            Box2D(patch.x1, patch.x1, patch.y0, patch.y1),
+            Box2D(patch.x0, patch.x1, patch.y0, patch.y0),
+            Box2D(patch.x0, patch.x1, patch.y1, patch.y1)};
+  }
+
+  void setRing() {
+    std::array<Box2D, 4> boxes = edges(patch_);
+    for (int i = 0; i < 4; ++i) {
+      ringOld_[i] = LevelBuffer(boxes[i]);
+      ringNew_[i] = LevelBuffer(boxes[i]);
+    }
+    gatherRing(ringNew_);
+  }
+
+  void gatherRing(std::array<LevelBuffer, 4> &ring) {
+    ProfileScope scope("refine.gatherRing", "transfer");
+    for (LevelBuffer &edge : ring) {
+      gather(edge, coarse_, coarsePhysics(), LevelMap{Dot2D(0, 0), 1},
+             edge.getBox());
+    }
+  }
+
+  // outer ring of the fine level at coarse time t + alpha
+  void scatterRing(T alpha) {
+    ProfileScope scope("refine.scatterRing", "transfer");
+    LevelMap map{Dot2D(patch_.x0, patch_.y0), refinement_.ratio};
+    for (int i = 0; i < 4; ++i) {
+      scatter(ringOld_[i], ringNew_[i], alpha, coarsePhysics(),
+              finePhysics(*fine_), map, *fine_,
+              toFine(ringNew_[i].getBox(), patch_));
+    }
+  }
+
+  // coarse nodes strictly inside the patch from the coinciding fine nodes
+  void restrictToCoarse() {
+    Box2D interior = patch_.enlarge(-1);
+    if (interior.getNx() <= 0 || interior.getNy() <= 0) {
+      return;
+    }
+    ProfileScope scope("refine.restrict", "transfer");
+    LevelBuffer buffer(interior);
+    gather(buffer, *fine_, finePhysics(*fine_),
+           LevelMap{Dot2D(patch_.x0, patch_.y0), refinement_.ratio},
+           toFine(interior, patch_));
+    scatter(buffer, buffer, (T)0, finePhysics(*fine_), coarsePhysics(),
+            LevelMap{Dot2D(0, 0), 1}, coarse_, interior);
+  }
+
+  void checkBand() {
+    ProfileScope scope("refine.checkBand", "transfer");
+    Box2D band(std::numeric_limits<plint>::max(),
+               std::numeric_limits<plint>::min(),
+               std::numeric_limits<plint>::max(),
+               std::numeric_limits<plint>::min());
+    applyProcessingFunctional(
+        new BandBoxFunctional2D<T>(&band, (T)refinement_.bandTolerance),
+        coarse_.getPhiDensity().getBoundingBox(), coarse_.getPhiDensity());
+    allReduceBoundingBox(band);
+    if (band.x0 > band.x1) {
+      return; // no interface left
+    }
+    Box2D safe;
+    intersect(band.enlarge(refinement_.bandWidth / 2),
+              coarse_.getPhi().getBoundingBox(), safe);
+    if (!inside(safe, patch_)) {
+      regrid(patchAround(band));
+    }
+  }
+
+  void regrid(Box2D patch) {
+    ProfileScope scope("refine.regrid", "transfer");
+    std::unique_ptr<DropletModel<T, Descriptor>> next = makeFine(patch);
+    Lattices nextLattices = lattices(*next);
+
+    // everything from the coarse level ...
+    LevelBuffer all(patch);
+    gather(all, coarse_, coarsePhysics(), LevelMap{Dot2D(0, 0), 1}, patch);
+    scatter(all, all, (T)0, coarsePhysics(), finePhysics(*next),
+            LevelMap{Dot2D(patch.x0, patch.y0), refinement_.ratio}, *next,
+            next->getPhi().getBoundingBox());
+
+    // ... and the resolved state where the old patch overlaps
+    Box2D overlap;
+    if (intersect(patch_, patch, overlap)) {
+      Lattices oldLattices = lattices(*fine_);
+      for (pluint i = 0; i < oldLattices.size(); ++i) {
+        copy(*oldLattices[i], toFine(overlap, patch_), *nextLattices[i],
+             toFine(overlap, patch), modif::staticVariables);
+      }
+    }
+    for (MultiBlockLattice2D<T, Descriptor> *lattice : nextLattices) {
+      lattice->duplicateOverlaps(modif::staticVariables);
+    }
+    next->getScheduler().setNumSteps(fine_->getScheduler().getNumSteps());
+    next->refreshDerivedFields();
+
+    fine_ = std::move(next);
+    patch_ = patch;
+    ++numRegrids_;
+    setRing();
+  }
+
+  DropletParameters params_;
+  RefinementParameters refinement_;
+  DropletModel<T, Descriptor> coarse_;
+  std::unique_ptr<DropletModel<T, Descriptor>> fine_;
+  Box2D patch_;
+  std::array<LevelBuffer, 4> ringOld_, ringNew_;
+  plint numSteps_ = 0;
+  plint numRegrids_ = 0;
+};
+
+#endif
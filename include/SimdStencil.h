@@ -0,0 +1,181 @@
+#ifndef SIMD_STENCIL_H
+#define SIMD_STENCIL_H
+
+#include "D2Q9Kernels.h"
+#include "SimdVec.h"
+#include <cstddef>
+
+// Row-wise 3x3 stencil engine over contiguous double fields.
+//
+// A stencil operator is a struct with
+//   static constexpr int numOutputs;
+//   template <class V, class Nb> void apply(Nb const &nb, V *out) const;
+// where nb(dx, dy) loads the input at offset (dx, dy) as a vector V of
+// consecutive y cells and out[k] receives output k. V supports + - * /,
+// a broadcast constructor from double and rsqrt(). The engine runs the
+// operator over one x-row at a time, width cells per call, and finishes the
+// row with a ScalarLane of the same ISA. To make a new operator available to
+// the AVX2 and AVX-512 kernels, add it to LBM_STENCIL_OPERATORS.
+
+enum class SimdLevel { scalar = 0, avx2 = 1, avx512 = 2 };
+
+// Widest level supported by both the build and the CPU, capped by the
+// environment variable LBM_SIMD (scalar, avx2 or avx512) when set.
+SimdLevel activeSimdLevel();
+char const *simdLevelName(SimdLevel level);
+
+// One x-row of the input and planar output rows.
+struct StencilRow {
+  static constexpr int maxOutputs = 6;
+
+  double const *center;     // input(x, y0); input(x, y0 + i) = center[i]
+  std::ptrdiff_t strideX;   // distance to input(x + 1, y0)
+  std::ptrdiff_t length;    // number of y cells
+  double *out[maxOutputs];  // out[k][i] receives output k of cell y0 + i
+};
+
+template <class V> struct StencilNeighbourhood {
+  double const *center;
+  std::ptrdiff_t strideX;
+
+  V operator()(int dx, int dy) const {
+    return V::load(center + dx * strideX + dy);
+  }
+};
+
+// ---- Operators ----
+
+// 5-point Laplacian, as BoxLaplacianFunctional2D.
+struct LaplacianStencil {
+  static constexpr int numOutputs = 1;
+
+  template <class V, class Nb> void apply(Nb const &nb, V *out) const {
+    out[0] = nb(1, 0) + nb(-1, 0) + nb(0, 1) + nb(0, -1) - V(4.) * nb(0, 0);
+  }
+};
+
+// Central-difference gradient, as FusedInterfaceFunctional2D with
+// InterfaceStencil::centralDifference.
+struct GradientStencil {
+  static constexpr int numOutputs = 2;
+
+  template <class V, class Nb> void apply(Nb const &nb, V *out) const {
+    out[0] = (nb(1, 0) - nb(-1, 0)) * V(0.5);
+    out[1] = (nb(0, 1) - nb(0, -1)) * V(0.5);
+  }
+};
+
+// Normalized central-difference gradient, as BoxNormGradientFunctional2D.
+struct NormGradientStencil {
+  static constexpr int numOutputs = 2;
+
+  template <class V, class Nb> void apply(Nb const &nb, V *out) const {
+    V gx = (nb(1, 0) - nb(-1, 0)) * V(0.5);
+    V gy = (nb(0, 1) - nb(0, -1)) * V(0.5);
+    V invMag = rsqrt(gx * gx + gy * gy + V(1e-16));
+    out[0] = gx * invMag;
+    out[1] = gy * invMag;
+  }
+};
+
+// grad(phi), n-hat, lap(phi) and mu_phi of the phase field; the outputs
+// are gx, gy, nx, ny, lap, mu. Isotropic selects the D2Q9-weighted stencil
+// over central differences (see InterfaceStencil).
+template <bool Isotropic> struct PhaseInterfaceStencil {
+  static constexpr int numOutputs = 6;
+  double beta, kappa;
+
+  template <class V, class Nb> void apply(Nb const &nb, V *out) const {
+    typedef D2Q9Kernels<double> K;
+    V center = nb(0, 0);
+    V gx(0.), gy(0.), lap(0.);
+    if (Isotropic) {
+      K::unroll([&](auto i) {
+        constexpr int iPop = decltype(i)::value;
+        if (iPop > 0) {
+          V value = nb(K::cx[iPop], K::cy[iPop]);
+          if (K::cx[iPop] != 0) {
+            gx = gx + V(K::t[iPop] * K::cx[iPop]) * value;
+          }
+          if (K::cy[iPop] != 0) {
+            gy = gy + V(K::t[iPop] * K::cy[iPop]) * value;
+          }
+          lap = lap + V(K::t[iPop]) * (value - center);
+        }
+      });
+      gx = gx * V(K::invCs2);
+      gy = gy * V(K::invCs2);
+      lap = lap * V(2. * K::invCs2);
+    } else {
+      gx = (nb(1, 0) - nb(-1, 0)) * V(0.5);
+      gy = (nb(0, 1) - nb(0, -1)) * V(0.5);
+      lap = nb(1, 0) + nb(-1, 0) + nb(0, 1) + nb(0, -1) - V(4.) * center;
+    }
+    V invMag = rsqrt(gx * gx + gy * gy + V(1e-16));
+    out[0] = gx;
+    out[1] = gy;
+    out[2] = gx * invMag;
+    out[3] = gy * invMag;
+    out[4] = lap;
+    out[5] = V(4. * beta) * center * (center - V(0.5)) * (center - V(1.)) -
+             V(kappa) * lap;
+  }
+};
+
+#define LBM_STENCIL_OPERATORS(X)                                               \
+  X(LaplacianStencil)                                                          \
+  X(GradientStencil)                                                           \
+  X(NormGradientStencil)                                                       \
+  X(PhaseInterfaceStencil<false>)                                              \
+  X(PhaseInterfaceStencil<true>)
+
+// ---- Engine ----
+
+// V is the vector type, Tail the ScalarLane of the same translation unit.
+template <class V, class Tail, class Op>
+inline void stencilRowKernel(Op const &op, StencilRow const &row) {
+  std::ptrdiff_t i = 0;
+  for (; i + V::width <= row.length; i += V::width) {
+    StencilNeighbourhood<V> nb{row.center + i, row.strideX};
+    V out[Op::numOutputs];
+    op.apply(nb, out);
+    for (int k = 0; k < Op::numOutputs; ++k) {
+      out[k].store(row.out[k] + i);
+    }
+  }
+  for (; i < row.length; ++i) {
+    StencilNeighbourhood<Tail> nb{row.center + i, row.strideX};
+    Tail out[Op::numOutputs];
+    op.apply(nb, out);
+    for (int k = 0; k < Op::numOutputs; ++k) {
+      out[k].store(row.out[k] + i);
+    }
+  }
+}
+
+// Per-ISA entry points, explicitly instantiated for every operator of
+// LBM_STENCIL_OPERATORS in SimdStencil*.cpp.
+template <class Op> void stencilRowScalar(Op const &op, StencilRow const &row);
+template <class Op> void stencilRowAvx2(Op const &op, StencilRow const &row);
+template <class Op>
+void stencilRowAvx512(Op const &op, StencilRow const &row);
+
+template <class Op>
+inline void runStencilRow(Op const &op, StencilRow const &row) {
+  switch (activeSimdLevel()) {
+#ifdef LBM_SIMD_AVX512
+  case SimdLevel::avx512:
+    stencilRowAvx512(op, row);
+    return;
+#endif
+#ifdef LBM_SIMD_AVX2
+  case SimdLevel::avx2:
+    stencilRowAvx2(op, row);
+    return;
+#endif
+  default:
+    stencilRowScalar(op, row);
+  }
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef SIMD_VEC_H
+#define SIMD_VEC_H
+
+#include <cmath>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// Minimal double-precision vector types for the stencil engine. Each offers
+// a broadcast constructor, unaligned load/store, + - * / and rsqrt(). The
+// AVX types only exist in translation units compiled for that ISA (see
+// SimdStencilAvx2.cpp and SimdStencilAvx512.cpp).
+
+// One double. Isa is the SimdLevel of the translation unit that uses it:
+// the AVX kernels finish their rows with their own ScalarLane, so that
+// every template instantiated for it (the lane itself, the operators, the
+// D2Q9Kernels helpers they inline) is a symbol of its own, built for that
+// ISA, which the linker cannot substitute for the baseline one.
+template <int Isa> struct ScalarLane {
+  static constexpr int width = 1;
+  double v;
+
+  ScalarLane() = default;
+  ScalarLane(double x) : v(x) {}
+  static ScalarLane load(double const *p) { return ScalarLane(*p); }
+  void store(double *p) const { *p = v; }
+
+  friend ScalarLane operator+(ScalarLane a, ScalarLane b) { return a.v + b.v; }
+  friend ScalarLane operator-(ScalarLane a, ScalarLane b) { return a.v - b.v; }
+  friend ScalarLane operator*(ScalarLane a, ScalarLane b) { return a.v * b.v; }
+  friend ScalarLane operator/(ScalarLane a, ScalarLane b) { return a.v / b.v; }
+  friend ScalarLane rsqrt(ScalarLane a) { return 1. / std::sqrt(a.v); }
+};
+
+typedef ScalarLane<0> ScalarVec;
+
+#if defined(__AVX2__)
+struct Avx2Vec {
+  static constexpr int width = 4;
+  __m256d v;
+
+  Avx2Vec() = default;
+  Avx2Vec(double x) : v(_mm256_set1_pd(x)) {}
+  Avx2Vec(__m256d x) : v(x) {}
+  static Avx2Vec load(double const *p) { return _mm256_loadu_pd(p); }
+  void store(double *p) const { _mm256_storeu_pd(p, v); }
+
+  friend Avx2Vec operator+(Avx2Vec a, Avx2Vec b) {
+    return _mm256_add_pd(a.v, b.v);
+  }
+  friend Avx2Vec operator-(Avx2Vec a, Avx2Vec b) {
+    return _mm256_sub_pd(a.v, b.v);
+  }
+  friend Avx2Vec operator*(Avx2Vec a, Avx2Vec b) {
+    return _mm256_mul_pd(a.v, b.v);
+  }
+  friend Avx2Vec operator/(Avx2Vec a, Avx2Vec b) {
+    return _mm256_div_pd(a.v, b.v);
+  }
+  // 12-bit single-precision estimate refined by two Newton steps.
+  friend Avx2Vec rsqrt(Avx2Vec a) {
+    Avx2Vec y = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(a.v)));
+    Avx2Vec halfA = a * Avx2Vec(0.5);
+    y = y * (Avx2Vec(1.5) - halfA * y * y);
+    y = y * (Avx2Vec(1.5) - halfA * y * y);
+    return y;
+  }
+};
+#endif
+
+#if defined(__AVX512F__)
+struct Avx512Vec {
+  static constexpr int width = 8;
+  __m512d v;
+
+  Avx512Vec() = default;
+  Avx512Vec(double x) : v(_mm512_set1_pd(x)) {}
+  Avx512Vec(__m512d x) : v(x) {}
+  static Avx512Vec load(double const *p) { return _mm512_loadu_pd(p); }
+  void store(double *p) const { _mm512_storeu_pd(p, v); }
+
+  friend Avx512Vec operator+(Avx512Vec a, Avx512Vec b) {
+    return _mm512_add_pd(a.v, b.v);
+  }
+  friend Avx512Vec operator-(Avx512Vec a, Avx512Vec b) {
+    return _mm512_sub_pd(a.v, b.v);
+  }
+  friend Avx512Vec operator*(Avx512Vec a, Avx512Vec b) {
+    return _mm512_mul_pd(a.v, b.v);
+  }
+  friend Avx512Vec operator/(Avx512Vec a, Avx512Vec b) {
+    return _mm512_div_pd(a.v, b.v);
+  }
+  // 14-bit estimate refined by two Newton steps.
+  friend Avx512Vec rsqrt(Avx512Vec a) {
+    Avx512Vec y = _mm512_rsqrt14_pd(a.v);
+    Avx512Vec halfA = a * Avx512Vec(0.5);
+    y = y * (Avx512Vec(1.5) - halfA * y * y);
+    y = y * (Avx512Vec(1.5) - halfA * y * y);
+    return y;
+  }
+};
+#endif
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef SNAPSHOT_IO_H
+#define SNAPSHOT_IO_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace plb;
+
+// Self-describing binary snapshot of 2D fields (file extension .lbm).
+//
+// Layout, little-endian:
+//   char[8]  magic "LBMSNAP"
+//   uint32   version, header size in bytes
+//   int64    nx, ny, step
+//   uint32   number of fields, number of block records
+//   uint8    dtype (0 float64, 1 float32), codec (0 raw, 1 xor-delta/RLE)
+//   fields:  uint16 name length, name, uint8 number of components
+//   blocks:  int64 x0, x1, y0, y1 (global, inclusive), then per field
+//            uint64 encoded size and the encoded values. Values are stored
+//            x-major with y fastest and components interleaved per cell.
+//
+// The xor-delta/RLE codec XORs every word with its predecessor and stores
+// runs of zero words as a count, so regions where phi sits at exactly 0 or
+// 1 cost a few bytes. It is lossless; python/lbm_snapshot.py reads it.
+
+enum class SnapshotDType : std::uint8_t { float64 = 0, float32 = 1 };
+enum class SnapshotCodec : std::uint8_t { raw = 0, xorDeltaRle = 1 };
+
+struct SnapshotOptions {
+  SnapshotDType dtype = SnapshotDType::float64;
+  SnapshotCodec codec = SnapshotCodec::xorDeltaRle;
+};
+
+struct SnapshotField {
+  std::string name;
+  plint numComponents;
+};
+
+struct SnapshotBlock {
+  Box2D bulk;
+  // one array per field, bulk.nCells() * numComponents values each; a
+  // recycled frame may hold more arrays than fields, the extra ones unused
+  std::vector<std::vector<double>> values;
+};
+
+struct SnapshotFrame {
+  plint nx = 0, ny = 0;
+  plint step = 0;
+  std::vector<SnapshotField> fields;
+  std::vector<SnapshotBlock> blocks;
+
+  // Adds a field and returns its index; blocks are created by the first
+  // staged field and shared by all following ones.
+  plint addField(std::string const &name, plint numComponents);
+  void clear();
+  // Forgets the fields but keeps the block storage, so that staging the
+  // same fields again into a pooled frame does not allocate.
+  void recycle();
+};
+
+// Collective: every process contributes its blocks to one shared file.
+void writeSnapshot(SnapshotFrame const &frame, std::string const &fileName,
+                   SnapshotOptions const &options = SnapshotOptions());
+
+// Writes only the blocks of the calling process to its own file.
+void writeSnapshotLocal(SnapshotFrame const &frame, std::string const &fileName,
+                        SnapshotOptions const &options = SnapshotOptions());
+
+// Codec entry points, on the bytes of the stored dtype.
+std::vector<char> encodeSnapshotData(std::vector<double> const &values,
+                                     SnapshotOptions const &options);
+std::vector<double> decodeSnapshotData(std::vector<char> const &encoded,
+                                       pluint numValues,
+                                       SnapshotOptions const &options);
+
+// ---- Staging of multi-block fields (local blocks only) ----
+
+namespace snapshot_detail {
+
+template <class MultiField, class Extract>
+void stageField(SnapshotFrame &frame, std::string const &name,
+                plint numComponents, MultiField &field, Extract extract) {
+  plint iField = frame.addField(name, numComponents);
+  MultiBlockManagement2D const &management = field.getMultiBlockManagement();
+  std::vector<plint> const &localBlocks = management.getLocalInfo().getBlocks();
+  bool newBlocks = (iField == 0);
+  PLB_ASSERT(newBlocks || frame.blocks.size() == localBlocks.size());
+  if (newBlocks) {
+    frame.nx = field.getNx();
+    frame.ny = field.getNy();
+    frame.blocks.resize(localBlocks.size());
+  }
+
+  for (pluint iBlock = 0; iBlock < localBlocks.size(); ++iBlock) {
+    SnapshotBlock &block = frame.blocks[iBlock];
+    Box2D bulk;
+    management.getSparseBlockStructure().getBulk(localBlocks[iBlock], bulk);
+    if (newBlocks) {
+      block.bulk = bulk;
+    }
+    if (block.values.size() < frame.fields.size()) {
+      block.values.resize(frame.fields.size());
+    }
+
+    auto &component = field.getComponent(localBlocks[iBlock]);
+    Dot2D location = component.getLocation();
+    std::vector<double> &values = block.values[iField];
+    values.resize(bulk.nCells() * numComponents);
+    pluint pos = 0;
+    for (plint iX = bulk.x0; iX <= bulk.x1; ++iX) {
+      for (plint iY = bulk.y0; iY <= bulk.y1; ++iY) {
+        extract(component, iX - location.x, iY - location.y, &values[pos]);
+        pos += numComponents;
+      }
+    }
+  }
+}
+
+} // namespace snapshot_detail
+
+template <typename T>
+void stageSnapshotField(SnapshotFrame &frame, std::string const &name,
+                        MultiScalarField2D<T> &field) {
+  snapshot_detail::stageField(
+      frame, name, 1, field,
+      [](ScalarField2D<T> &f, plint iX, plint iY, double *out) {
+        out[0] = (double)f.get(iX, iY);
+      });
+}
+
+template <typename T, int nDim>
+void stageSnapshotField(SnapshotFrame &frame, std::string const &name,
+                        MultiTensorField2D<T, nDim> &field) {
+  snapshot_detail::stageField(
+      frame, name, nDim, field,
+      [](TensorField2D<T, nDim> &f, plint iX, plint iY, double *out) {
+        for (int iD = 0; iD < nDim; ++iD) {
+          out[iD] = (double)f.get(iX, iY)[iD];
+        }
+      });
+}
+
+// Density of a lattice, evaluated cell by cell while staging.
+template <typename T, template <typename U> class Descriptor>
+void stageSnapshotDensity(SnapshotFrame &frame, std::string const &name,
+                          MultiBlockLattice2D<T, Descriptor> &lattice) {
+  snapshot_detail::stageField(
+      frame, name, 1, lattice,
+      [](BlockLattice2D<T, Descriptor> &l, plint iX, plint iY, double *out) {
+        out[0] = (double)l.get(iX, iY).computeDensity();
+      });
+}
+
+template <typename T, template <typename U> class Descriptor>
+void stageSnapshotVelocity(SnapshotFrame &frame, std::string const &name,
+                           MultiBlockLattice2D<T, Descriptor> &lattice) {
+  snapshot_detail::stageField(
+      frame, name, 2, lattice,
+      [](BlockLattice2D<T, Descriptor> &l, plint iX, plint iY, double *out) {
+        Array<T, 2> u;
+        l.get(iX, iY).computeVelocity(u);
+        out[0] = (double)u[0];
+        out[1] = (double)u[1];
+      });
+}
+
+// numComponents external scalars of a lattice, starting at offset.
+template <typename T, template <typename U> class Descriptor>
+void stageSnapshotExternal(SnapshotFrame &frame, std::string const &name,
+                           MultiBlockLattice2D<T, Descriptor> &lattice,
+                           plint offset, plint numComponents) {
+  snapshot_detail::stageField(
+      frame, name, numComponents, lattice,
+      [offset, numComponents](BlockLattice2D<T, Descriptor> &l, plint iX,
+                              plint iY, double *out) {
+        T const *external = l.get(iX, iY).getExternal(offset);
+        for (plint iD = 0; iD < numComponents; ++iD) {
+          out[iD] = (double)external[iD];
+        }
+      });
+}
+
+#endif
@@ -0,0 +1,241 @@
+#ifndef SPECIES_KERNELS_H
+#define SPECIES_KERNELS_H
+
+#include <algorithm>
+#include <cstddef>
+
+#include "LatticeKernels.h"
+#include "ReactionKinetics.h"
+
+// Per-cell updates of the two species lattices, shared by the 2D and 3D
+// functionals (lattice_coupling, SpeciesReaction2D and their 3D
+// counterparts). They act on the raw populations of one cell of each
+// species and work on any velocity set of LatticeKernels; the arithmetic is
+// done in ComputeType<T>.
+
+// Reaction-diffusion collision switched by the local phase. The source is
+// added as t_i S, so the concentration changes by S per step, as with
+// SpeciesReactionCell. Until this was weighted every population got S and
+// the concentration changed by q S (9 S on D2Q9): explicitSource runs from
+// before then reacted q times faster and need their rates recalibrated.
+// With withReaction = false only the diffusive collision is done and the
+// reaction is left to SpeciesReactionCell (operator splitting).
+template <typename T, template <typename U> class Descriptor>
+class SpeciesCollisionCell {
+public:
+  typedef typename ComputeType<T>::type C;
+  typedef DescriptorKernels<C, Descriptor> K;
+
+  SpeciesCollisionCell(T chi, T mu, T a, T b, T epsilon, T c_bulk, T tau1,
+                       T tau2, bool withReaction)
+      : chiMu_((C)chi * (C)mu), a_((C)a), b_((C)b), epsilon_((C)epsilon),
+        c_bulk_((C)c_bulk), invTau1_((C)1 / (C)tau1),
+        invTau2_((C)1 / (C)tau2), withReaction_(withReaction) {}
+
+  void operator()(T *stored1, T *stored2, T phi) const {
+    const C density_floor = (C)1e-12;
+    C f1[K::q], f2[K::q];
+    K::load(stored1, f1);
+    K::load(stored2, f2);
+
+    // moments computed once per cell; u = j / rho as in computeVelocity
+    C rhoBar1, u1[K::d], rhoBar2, u2[K::d];
+    K::rhoBarJ(f1, rhoBar1, u1);
+    K::rhoBarJ(f2, rhoBar2, u2);
+    const C rho1 = Descriptor<C>::fullRho(rhoBar1);
+    const C rho2 = Descriptor<C>::fullRho(rhoBar2);
+    for (int iD = 0; iD < K::d; ++iD) {
+      u1[iD] /= rho1;
+      u2[iD] /= rho2;
+    }
+
+    // densities with floor
+    C c1 = std::max(rho1, density_floor);
+    C c2 = std::max(rho2, density_floor);
+    C phi_val = std::max((C)phi, density_floor);
+
+    // reaction / source terms
+    C Sj1 = (C)0;
+    C Sj2 = (C)0;
+
+    if (withReaction_ && phi_val >= (C)0.5) {
+      C J1 = ((C)1 / epsilon_) *
+             (c1 * (c1 - (C)1) - ((b_ * c2 * (c1 - a_)) / (c1 + a_)));
+      C J2 = c1 - c2;
+      Sj1 = J1;
+      Sj2 = J2;
+    } else if (withReaction_) {
+      Sj1 = -(c1 - c_bulk_);
+      Sj2 = -(c2 - c_bulk_);
+    }
+
+    // collision step: equilibria for all q from the cell moments
+    C feq1[K::q], feq2[K::q];
+    K::reactionDiffusionEquilibria(c1, u1, chiMu_, feq1);
+    K::reactionDiffusionEquilibria(c2, u2, chiMu_, feq2);
+
+    K::unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      f1[iPop] += -(f1[iPop] - feq1[iPop]) * invTau1_ + K::t[iPop] * Sj1;
+      f2[iPop] += -(f2[iPop] - feq2[iPop]) * invTau2_ + K::t[iPop] * Sj2;
+    });
+    K::store(f1, stored1);
+    K::store(f2, stored2);
+  }
+
+  // The same collision on lanes consecutive cells of a record that stores
+  // each value in runs (SoA or AoSoA): population i of cell k at
+  // stored[i * stride + k], its phi at phi[k]. The cells are gathered into
+  // local arrays and collided by a loop over them with unit stride, no calls
+  // and no branches, which vectorizes; the arithmetic is done in the order
+  // of the cell-wise operator.
+  template <int lanes>
+  void block(T *stored1, T *stored2, T const *phi,
+             std::ptrdiff_t stride) const {
+    if (withReaction_) {
+      block<lanes, true>(stored1, stored2, phi, stride);
+    } else {
+      block<lanes, false>(stored1, stored2, phi, stride);
+    }
+  }
+
+private:
+  template <int lanes, bool withReaction>
+  void block(T *stored1, T *stored2, T const *phi,
+             std::ptrdiff_t stride) const {
+    const C density_floor = (C)1e-12;
+    const C diffusive = chiMu_ * K::invCs2;
+    const C chiMu = chiMu_, a = a_, b = b_, invEpsilon = (C)1 / epsilon_;
+    const C c_bulk = c_bulk_, invTau1 = invTau1_, invTau2 = invTau2_;
+    C f1[K::q][lanes], f2[K::q][lanes];
+    for (int iPop = 0; iPop < K::q; ++iPop) {
+      for (int k = 0; k < lanes; ++k) {
+        f1[iPop][k] = (C)stored1[iPop * stride + k];
+        f2[iPop][k] = (C)stored2[iPop * stride + k];
+      }
+    }
+    for (int k = 0; k < lanes; ++k) {
+      C rhoBar1 = (C)0, rhoBar2 = (C)0, u1[K::d], u2[K::d];
+      K::unrollDims([&](auto dim) {
+        constexpr int iD = decltype(dim)::value;
+        u1[iD] = (C)0;
+        u2[iD] = (C)0;
+      });
+      K::unroll([&](auto i) {
+        constexpr int iPop = decltype(i)::value;
+        rhoBar1 += f1[iPop][k];
+        rhoBar2 += f2[iPop][k];
+        K::unrollDims([&](auto dim) {
+          constexpr int iD = decltype(dim)::value;
+          if constexpr (K::template c<iPop, iD>() == 1) {
+            u1[iD] += f1[iPop][k];
+            u2[iD] += f2[iPop][k];
+          } else if constexpr (K::template c<iPop, iD>() == -1) {
+            u1[iD] -= f1[iPop][k];
+            u2[iD] -= f2[iPop][k];
+          }
+        });
+      });
+      const C rho1 = Descriptor<C>::fullRho(rhoBar1);
+      const C rho2 = Descriptor<C>::fullRho(rhoBar2);
+      C uu1 = (C)0, uu2 = (C)0;
+      K::unrollDims([&](auto dim) {
+        constexpr int iD = decltype(dim)::value;
+        u1[iD] /= rho1;
+        u2[iD] /= rho2;
+      });
+      K::unrollDims([&](auto dim) {
+        constexpr int iD = decltype(dim)::value;
+        uu1 += u1[iD] * u1[iD];
+        uu2 += u2[iD] * u2[iD];
+      });
+
+      const C c1 = rho1 < density_floor ? density_floor : rho1;
+      const C c2 = rho2 < density_floor ? density_floor : rho2;
+      const C phi_val = (C)phi[k] < density_floor ? density_floor : (C)phi[k];
+      C Sj1 = (C)0;
+      C Sj2 = (C)0;
+      if constexpr (withReaction) {
+        const bool inside = phi_val >= (C)0.5;
+        const C J1 = invEpsilon * (c1 * (c1 - (C)1) -
+                                   ((b * c2 * (c1 - a)) / (c1 + a)));
+        Sj1 = inside ? J1 : -(c1 - c_bulk);
+        Sj2 = inside ? c1 - c2 : -(c2 - c_bulk);
+      }
+
+      K::unroll([&](auto i) {
+        constexpr int iPop = decltype(i)::value;
+        C feq1, feq2;
+        if constexpr (iPop == 0) {
+          feq1 = c1 - K::restDiffusive * chiMu - K::restKinetic * c1 * uu1;
+          feq2 = c2 - K::restDiffusive * chiMu - K::restKinetic * c2 * uu2;
+        } else {
+          constexpr C w = K::t[iPop];
+          const C gamma1 = K::gamma(K::template dot<iPop>(u1), uu1);
+          const C gamma2 = K::gamma(K::template dot<iPop>(u2), uu2);
+          feq1 = w * diffusive + c1 * w * w * (gamma1 - (C)1);
+          feq2 = w * diffusive + c2 * w * w * (gamma2 - (C)1);
+        }
+        f1[iPop][k] += -(f1[iPop][k] - feq1) * invTau1 + K::t[iPop] * Sj1;
+        f2[iPop][k] += -(f2[iPop][k] - feq2) * invTau2 + K::t[iPop] * Sj2;
+      });
+    }
+    for (int iPop = 0; iPop < K::q; ++iPop) {
+      for (int k = 0; k < lanes; ++k) {
+        stored1[iPop * stride + k] = (T)f1[iPop][k];
+        stored2[iPop * stride + k] = (T)f2[iPop][k];
+      }
+    }
+  }
+
+  C chiMu_, a_, b_, epsilon_, c_bulk_, invTau1_, invTau2_;
+  bool withReaction_;
+};
+
+// Reaction half of the operator-split species update: integrates the
+// kinetics of the cell over dt lattice steps and adds the concentration
+// change to the populations as t_i dc, which leaves the species momentum
+// untouched.
+template <typename T, template <typename U> class Descriptor>
+class SpeciesReactionCell {
+public:
+  typedef typename ComputeType<T>::type C;
+  typedef DescriptorKernels<C, Descriptor> K;
+
+  SpeciesReactionCell(ReactionKinetics<C> const &kinetics,
+                      ReactionIntegrator<C> const &integrator, C dt)
+      : kinetics_(kinetics), integrator_(integrator), dt_(dt) {}
+
+  void operator()(T *stored1, T *stored2, bool inside) const {
+    C f1[K::q], f2[K::q];
+    K::load(stored1, f1);
+    K::load(stored2, f2);
+
+    C rhoBar1, j1[K::d], rhoBar2, j2[K::d];
+    K::rhoBarJ(f1, rhoBar1, j1);
+    K::rhoBarJ(f2, rhoBar2, j2);
+    const C c1 = Descriptor<C>::fullRho(rhoBar1);
+    const C c2 = Descriptor<C>::fullRho(rhoBar2);
+
+    C new1 = std::max(c1, (C)0);
+    C new2 = std::max(c2, (C)0);
+    integrator_.advance(kinetics_, inside, new1, new2, dt_);
+
+    const C dc1 = new1 - c1;
+    const C dc2 = new2 - c2;
+    K::unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      f1[iPop] += K::t[iPop] * dc1;
+      f2[iPop] += K::t[iPop] * dc2;
+    });
+    K::store(f1, stored1);
+    K::store(f2, stored2);
+  }
+
+private:
+  ReactionKinetics<C> kinetics_;
+  ReactionIntegrator<C> integrator_;
+  C dt_;
+};
+
+#endif
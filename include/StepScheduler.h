@@ -0,0 +1,143 @@
+#ifndef STEP_SCHEDULER_H
+#define STEP_SCHEDULER_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace plb;
+
+// Forwards to a box functional but reports no modification, so Palabos does
+// not exchange envelopes after it ran. The StepScheduler decides when an
+// exchange is actually required.
+class DeferredSyncFunctional2D : public BoxProcessingFunctional2D {
+public:
+  DeferredSyncFunctional2D(BoxProcessingFunctional2D *functional,
+                           BlockDomain::DomainT appliesTo)
+      : functional_(functional), appliesTo_(appliesTo) {}
+
+  DeferredSyncFunctional2D(DeferredSyncFunctional2D const &rhs)
+      : BoxProcessingFunctional2D(rhs), functional_(rhs.functional_->clone()),
+        appliesTo_(rhs.appliesTo_) {}
+
+  ~DeferredSyncFunctional2D() override { delete functional_; }
+
+  void process(Box2D domain, std::vector<AtomicBlock2D *> blocks) override {
+    functional_->process(domain, blocks);
+  }
+
+  DeferredSyncFunctional2D *clone() const override {
+    return new DeferredSyncFunctional2D(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    for (pluint i = 0; i < modified.size(); ++i) {
+      modified[i] = modif::nothing;
+    }
+  }
+
+  BlockDomain::DomainT appliesTo() const override { return appliesTo_; }
+
+private:
+  DeferredSyncFunctional2D &operator=(DeferredSyncFunctional2D const &);
+
+  BoxProcessingFunctional2D *functional_;
+  BlockDomain::DomainT appliesTo_;
+};
+
+// Executes the processors of one coupled time step in an order derived from
+// their declared read and write sets, and refreshes the envelope of a
+// resource only when a stencil stage is about to read it while stale.
+//
+// Ordering rules for a resource R:
+//  - stages writing R run in registration order;
+//  - stages reading R run after its last writer;
+//  - stages reading R with readsPrevious() see the value left by the
+//    previous step and therefore run before its first writer.
+//
+// A stage declared with every(n) only runs on steps that are multiples of
+// n and must advance its quantity by n steps at once (multi-rate stepping).
+// It keeps its place in the order; on the other steps it is skipped.
+class StepScheduler {
+public:
+  typedef std::function<void()> Action;
+
+  // How a stage reads a resource.
+  enum Access { pointwise, stencil };
+  // Which part of a resource a stage leaves up to date.
+  enum Coverage { bulkOnly, bulkAndEnvelope };
+
+  class Stage {
+  public:
+    Stage &reads(std::string const &resource, Access access = pointwise);
+    Stage &readsPrevious(std::string const &resource,
+                         Access access = pointwise);
+    Stage &writes(std::string const &resource, Coverage coverage = bulkOnly);
+    Stage &every(plint steps);
+
+    std::string const &getName() const { return name; }
+    plint getPeriod() const { return period; }
+
+  private:
+    friend class StepScheduler;
+
+    struct Read {
+      std::string resource;
+      Access access;
+      bool previous;
+    };
+    struct Write {
+      std::string resource;
+      Coverage coverage;
+    };
+
+    std::string name;
+    Action action;
+    plint period = 1;
+    std::vector<Read> readSet;
+    std::vector<Write> writeSet;
+  };
+
+  // exchange refreshes the envelope of the resource.
+  void addResource(std::string const &name, Action exchange);
+  Stage &addStage(std::string const &name, Action action);
+
+  // Executes all stages once, in dependency order.
+  void step();
+  // Executes a single stage (e.g. during initialization), honouring the
+  // same envelope bookkeeping as step().
+  void run(std::string const &stageName);
+
+  plint getNumSteps() const { return numSteps; }
+  // Step counter that every() refers to, e.g. the step of a restart.
+  void setNumSteps(plint steps) { numSteps = steps; }
+  plint getNumExchanges() const { return numExchanges; }
+  // Cells this rank updates per stage, reported by the profiler.
+  void setNumCells(plint cells) { numCells = cells; }
+  std::vector<std::string> getExecutionOrder();
+
+private:
+  struct Resource {
+    Action exchange;
+    bool envelopeValid = true;
+  };
+
+  void resolveOrder();
+  void execute(Stage &stage);
+  Resource &getResource(std::string const &name);
+
+  std::map<std::string, Resource> resources;
+  std::vector<std::unique_ptr<Stage>> stages;
+  std::vector<pluint> order;
+  bool orderIsValid = false;
+  plint numSteps = 0;
+  plint numExchanges = 0;
+  plint numCells = 0;
+};
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef SWAP_STREAM_H
+#define SWAP_STREAM_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+#include "TileExecutor.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+using namespace plb;
+
+// Swap-algorithm sweep of the fused collide-and-stream functionals, over
+// the cells of block: cells are visited in lexicographic order, so the
+// neighbours x + c_i of the directions i = 1..q/2 (Palabos orders them
+// first, each with its opposite at i + q/2) are already done. Right after
+// its collision a cell hands post_i over to x + c_i and takes the value
+// that neighbour left for it in slot i, its post_{i+q/2}; it parks its own
+// post_{i+q/2} in slot i for the neighbour x - c_i, which comes later.
+// Cells outside domain stream without collision; neighbours outside block
+// are treated as beyond the edge of the atomic block.
+// populations(iX, iY, f) points f[0] to f[n - 1] to the n population
+// arrays of a cell that stream together, collide(iX, iY, f) is their
+// collision.
+template <typename T, template <typename U> class Descriptor, int n,
+          class Populations, class Collide>
+void swapStreamSweep2D(Box2D const &block, Box2D const &domain,
+                       Populations &populations, Collide &collide) {
+  const plint half = Descriptor<T>::q / 2;
+  auto swapAndStream = [half](T *f, T *next, plint iPop) {
+    T out = f[iPop];
+    f[iPop] = f[iPop + half];
+    f[iPop + half] = next[iPop];
+    next[iPop] = out;
+  };
+  for (plint iX = block.x0; iX <= block.x1; ++iX) {
+    for (plint iY = block.y0; iY <= block.y1; ++iY) {
+      T *f[n];
+      populations(iX, iY, f);
+      if (contained(iX, iY, domain)) {
+        collide(iX, iY, f);
+      }
+      for (plint iPop = 1; iPop <= half; ++iPop) {
+        plint nextX = iX + Descriptor<T>::c[iPop][0];
+        plint nextY = iY + Descriptor<T>::c[iPop][1];
+        if (contained(nextX, nextY, block)) {
+          T *next[n];
+          populations(nextX, nextY, next);
+          for (int k = 0; k < n; ++k) {
+            swapAndStream(f[k], next[k], iPop);
+          }
+        } else {
+          for (int k = 0; k < n; ++k) {
+            std::swap(f[k][iPop], f[k][iPop + half]);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Joins two slabs of a block that swapStreamSweep2D swept separately:
+// column x, the first of the right slab, with column x - 1, rows y0 to
+// y1. Across the seam each slab took the other for the block edge, so a
+// cell kept its post_i (slot i + q/2) for a direction i = 1..q/2 pointing
+// into the left slab, where the neighbour parked its post_{i+q/2} in slot
+// i; swapping the two slots completes the streaming as one sweep would.
+template <typename T, template <typename U> class Descriptor, int n,
+          class Populations>
+void swapStreamSeam2D(plint x, plint y0, plint y1, Populations &populations) {
+  const plint half = Descriptor<T>::q / 2;
+  for (plint iY = y0; iY <= y1; ++iY) {
+    T *f[n];
+    populations(x, iY, f);
+    for (plint iPop = 1; iPop <= half; ++iPop) {
+      plint nextY = iY + Descriptor<T>::c[iPop][1];
+      if (Descriptor<T>::c[iPop][0] != -1 || nextY < y0 || nextY > y1) {
+        continue;
+      }
+      T *next[n];
+      populations(x - 1, nextY, next);
+      for (int k = 0; k < n; ++k) {
+        std::swap(f[k][iPop + half], next[k][iPop]);
+      }
+    }
+  }
+}
+
+// swapStreamSweep2D over a whole block, split into one slab of columns per
+// thread of executor (serial without one); the seams are joined once all
+// slabs are done. Each slab works on its own copy of collide, which may
+// therefore keep per-thread state.
+template <typename T, template <typename U> class Descriptor, int n,
+          class Populations, class Collide>
+void swapStreamSweep2D(Box2D const &block, Box2D const &domain,
+                       TileExecutor *executor, Populations populations,
+                       Collide collide) {
+  if (!executor || executor->getNumThreads() == 1) {
+    swapStreamSweep2D<T, Descriptor, n>(block, domain, populations, collide);
+    return;
+  }
+  std::vector<Box2D> slabs = executor->slabsOf(block);
+  executor->run(slabs, [&](Box2D slab) {
+    Collide slabCollide(collide);
+    swapStreamSweep2D<T, Descriptor, n>(slab, domain, populations,
+                                        slabCollide);
+  });
+  std::vector<Box2D> seams;
+  for (pluint s = 1; s < slabs.size(); ++s) {
+    seams.push_back(Box2D(slabs[s].x0, slabs[s].x0, block.y0, block.y1));
+  }
+  executor->run(seams, [&](Box2D seam) {
+    swapStreamSeam2D<T, Descriptor, n>(seam.x0, seam.y0, seam.y1,
+                                       populations);
+  });
+}
+
+// Temporal blocking of swapStreamSweep2D: advances the cells of core by
+// numSteps steps, one tile of tileSize x tileSize cells at a time, so that
+// a tile is loaded and stored once for all the steps while they run in
+// cache. Each tile is copied with a halo of numSteps cells (within block);
+// every sweep of the copy spoils one more layer of the halo, and after the
+// last the tile itself is up to date and is written back. Cells of block
+// outside core are read, as they are before the first step, but never
+// written; core grown by numSteps should therefore lie within block,
+// except along the edges of block, which act as in a sweep of the whole
+// block. The halo cells of a tile that belong to other tiles are saved
+// before any tile is written back, so the tiles may be done in any order,
+// concurrently on the threads of executor.
+// populations(iX, iY, f) is as for swapStreamSweep2D; collide(iX, iY, step,
+// f) collides the cell in the copy at step 0 .. numSteps - 1. Each tile
+// works on its own copy of collide.
+template <typename T, template <typename U> class Descriptor, int n,
+          class Populations, class Collide>
+void blockedSwapStream2D(Box2D const &block, Box2D const &core,
+                         plint numSteps, plint tileSize,
+                         TileExecutor *executor, Populations populations,
+                         Collide collide) {
+  const plint record = n * Descriptor<T>::q;
+  tileSize = std::max((plint)1, tileSize);
+  const plint tilesY = (core.getNy() + tileSize - 1) / tileSize;
+  std::vector<Box2D> tiles;
+  for (plint x0 = core.x0; x0 <= core.x1; x0 += tileSize) {
+    for (plint y0 = core.y0; y0 <= core.y1; y0 += tileSize) {
+      tiles.push_back(Box2D(x0, std::min(core.x1, x0 + tileSize - 1), y0,
+                            std::min(core.y1, y0 + tileSize - 1)));
+    }
+  }
+  auto indexOf = [&](Box2D const &tile) {
+    return (pluint)(((tile.x0 - core.x0) / tileSize) * tilesY +
+                    (tile.y0 - core.y0) / tileSize);
+  };
+  auto grown = [&](Box2D const &tile, plint layers) {
+    Box2D box;
+    intersect(tile.enlarge(layers), block, box);
+    return box;
+  };
+  auto foreign = [&](plint iX, plint iY, Box2D const &tile) {
+    return !contained(iX, iY, tile) && contained(iX, iY, core);
+  };
+
+  std::vector<std::vector<T>> saved(tiles.size());
+  auto save = [&](Box2D tile) {
+    std::vector<T> &halo = saved[indexOf(tile)];
+    Box2D box = grown(tile, numSteps);
+    halo.reserve((box.nCells() - tile.nCells()) * record);
+    for (plint iX = box.x0; iX <= box.x1; ++iX) {
+      for (plint iY = box.y0; iY <= box.y1; ++iY) {
+        if (foreign(iX, iY, tile)) {
+          T *f[n];
+          populations(iX, iY, f);
+          for (int k = 0; k < n; ++k) {
+            halo.insert(halo.end(), f[k], f[k] + Descriptor<T>::q);
+          }
+        }
+      }
+    }
+  };
+
+  auto advance = [&](Box2D tile) {
+    // reused by the tiles of a thread, so it stays in its cache
+    static thread_local std::vector<T> copy;
+    Box2D box = grown(tile, numSteps);
+    const plint height = box.getNy();
+    copy.resize(box.nCells() * record);
+    T *data = copy.data();
+    const plint x0 = box.x0, y0 = box.y0;
+    auto local = [data, x0, y0, height, record](plint iX, plint iY, T **f) {
+      T *cell = data + ((iX - x0) * height + (iY - y0)) * record;
+      for (int k = 0; k < n; ++k) {
+        f[k] = cell + k * Descriptor<T>::q;
+      }
+    };
+
+    T const *halo = saved[indexOf(tile)].data();
+    for (plint iX = box.x0; iX <= box.x1; ++iX) {
+      for (plint iY = box.y0; iY <= box.y1; ++iY) {
+        T *to[n];
+        local(iX, iY, to);
+        if (foreign(iX, iY, tile)) {
+          std::copy(halo, halo + record, to[0]);
+          halo += record;
+        } else {
+          T *from[n];
+          populations(iX, iY, from);
+          for (int k = 0; k < n; ++k) {
+            std::copy(from[k], from[k] + Descriptor<T>::q, to[k]);
+          }
+        }
+      }
+    }
+
+    Collide tileCollide(collide);
+    for (plint step = 0; step < numSteps; ++step) {
+      Box2D region = grown(tile, numSteps - step);
+      auto collideStep = [&](plint iX, plint iY, T **f) {
+        tileCollide(iX, iY, step, f);
+      };
+      swapStreamSweep2D<T, Descriptor, n>(region, region, local, collideStep);
+    }
+
+    for (plint iX = tile.x0; iX <= tile.x1; ++iX) {
+      for (plint iY = tile.y0; iY <= tile.y1; ++iY) {
+        T *from[n], *to[n];
+        local(iX, iY, from);
+        populations(iX, iY, to);
+        for (int k = 0; k < n; ++k) {
+          std::copy(from[k], from[k] + Descriptor<T>::q, to[k]);
+        }
+      }
+    }
+  };
+
+  if (executor) {
+    executor->run(tiles, save);
+    executor->run(tiles, advance);
+  } else {
+    for (Box2D const &tile : tiles) {
+      save(tile);
+    }
+    for (Box2D const &tile : tiles) {
+      advance(tile);
+    }
+  }
+}
+
+// BlockLattice2D::collideAndStream() as a swap sweep with the dynamics of
+// each cell, so that the threads of a TileExecutor can share the block.
+// Like the Palabos call it collides every cell of the atomic block,
+// whatever the domain it is applied to; the envelope is stale afterwards.
+// The statistics the dynamics gather go to a scratch copy per slab and are
+// dropped.
+template <typename T, template <typename U> class Descriptor>
+class CollideAndStream2D : public BoxProcessingFunctional2D_L<T, Descriptor> {
+public:
+  explicit CollideAndStream2D(TileExecutor *executor = nullptr)
+      : executor_(executor) {}
+
+  void process(Box2D, BlockLattice2D<T, Descriptor> &lattice) override {
+    Box2D block(0, lattice.getNx() - 1, 0, lattice.getNy() - 1);
+    swapStreamSweep2D<T, Descriptor, 1>(
+        block, block, executor_,
+        [&lattice](plint iX, plint iY, T **f) {
+          f[0] = &lattice.get(iX, iY)[0];
+        },
+        [&lattice, statistics = lattice.getInternalStatistics()](
+            plint iX, plint iY, T **) mutable {
+          Cell<T, Descriptor> &cell = lattice.get(iX, iY);
+          cell.getDynamics().collide(cell, statistics);
+        });
+  }
+
+  CollideAndStream2D<T, Descriptor> *clone() const override {
+    return new CollideAndStream2D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables;
+  }
+
+private:
+  TileExecutor *executor_;
+};
+
+#endif
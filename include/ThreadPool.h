@@ -0,0 +1,46 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads taking tasks from one FIFO queue. The
+// workers make no MPI calls of their own; tasks that do need an MPI
+// library initialised for concurrent threads.
+class ThreadPool {
+public:
+  typedef std::function<void()> Task;
+
+  // numThreads == 0 uses std::thread::hardware_concurrency().
+  explicit ThreadPool(unsigned numThreads = 0);
+  // Finishes the queued tasks, then stops the workers.
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  void submit(Task task);
+  // Waits until the queue is empty and no task is running. Rethrows the
+  // first exception a task let escape since the last wait().
+  void wait();
+
+  unsigned getNumThreads() const { return (unsigned)workers_.size(); }
+
+private:
+  void run();
+
+  std::vector<std::thread> workers_;
+  std::deque<Task> tasks_;
+  mutable std::mutex mutex_;
+  std::condition_variable queued_, idle_;
+  unsigned running_ = 0;
+  bool stop_ = false;
+  std::exception_ptr error_;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef TILE_EXECUTOR_H
+#define TILE_EXECUTOR_H
+
+#include "palabos2D.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace plb;
+
+// Threads of one rank working on the tiles of its blocks (hybrid
+// MPI + threads). A box is cut into square tiles small enough to stay in
+// cache; thread t gets the t-th contiguous run of tiles, in the same order
+// every call, so a thread keeps touching the same part of a block from one
+// step to the next. A thread whose tiles are done steals from the far end
+// of another thread's run. The calling thread works as thread 0.
+//
+// Memory placement: the lattices are allocated and first touched by the
+// rank's main thread when they are constructed, so with one rank per
+// socket (bound to it by the MPI launcher) the pages of a rank are on its
+// own memory node. With pinning, worker t is held to the t-th CPU the rank
+// may run on, so the tiles of a worker stay in the caches of one core.
+//
+// The workers make no MPI calls. Not reentrant: a body must not call back
+// into the executor.
+class TileExecutor {
+public:
+  // numThreads == 0 uses std::thread::hardware_concurrency().
+  TileExecutor(unsigned numThreads, plint tileSize, bool pin = false);
+  ~TileExecutor();
+
+  TileExecutor(TileExecutor const &) = delete;
+  TileExecutor &operator=(TileExecutor const &) = delete;
+
+  // Tiles of tileSize x tileSize cells covering domain, in x-major order.
+  std::vector<Box2D> tilesOf(Box2D domain) const;
+  // One slab of whole columns per thread, none empty.
+  std::vector<Box2D> slabsOf(Box2D domain) const;
+
+  // Calls body once on each box, concurrently, and returns when all are
+  // done. Rethrows the first exception a body let escape.
+  void run(std::vector<Box2D> const &boxes,
+           std::function<void(Box2D)> const &body);
+  void forEachTile(Box2D domain, std::function<void(Box2D)> const &body) {
+    run(tilesOf(domain), body);
+  }
+
+  unsigned getNumThreads() const { return (unsigned)queues_.size(); }
+  plint getTileSize() const { return tileSize_; }
+  // Boxes taken from another thread's run, since construction.
+  std::uint64_t getNumStolen() const { return stolen_.load(); }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Box2D> boxes;
+  };
+
+  void worker(unsigned thread);
+  void work(unsigned thread);
+  bool take(unsigned thread, Box2D &box);
+
+  plint tileSize_;
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> workers_;
+  std::function<void(Box2D)> const *body_ = nullptr;
+  std::atomic<std::size_t> remaining_{0};
+  std::atomic<std::uint64_t> stolen_{0};
+
+  std::mutex mutex_;
+  std::condition_variable started_, finished_;
+  std::uint64_t generation_ = 0;
+  bool stop_ = false;
+  std::exception_ptr error_;
+};
+
+// Runs a box functional on the tiles of its domain with a TileExecutor,
+// like TiledFunctional2D runs it on the active tiles. The wrapped
+// functional must be safe to apply to disjoint boxes of the same blocks
+// concurrently: cell-local updates and stencils that read one field and
+// write another, not reductions into shared state.
+class ThreadedFunctional2D : public BoxProcessingFunctional2D {
+public:
+  ThreadedFunctional2D(BoxProcessingFunctional2D *functional,
+                       TileExecutor *executor)
+      : functional_(functional), executor_(executor) {}
+
+  ThreadedFunctional2D(ThreadedFunctional2D const &rhs)
+      : BoxProcessingFunctional2D(rhs), functional_(rhs.functional_->clone()),
+        executor_(rhs.executor_) {}
+
+  ~ThreadedFunctional2D() override { delete functional_; }
+
+  void process(Box2D domain, std::vector<AtomicBlock2D *> blocks) override {
+    executor_->forEachTile(
+        domain, [&](Box2D tile) { functional_->process(tile, blocks); });
+  }
+
+  ThreadedFunctional2D *clone() const override {
+    return new ThreadedFunctional2D(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    functional_->getTypeOfModification(modified);
+  }
+
+  BlockDomain::DomainT appliesTo() const override {
+    return functional_->appliesTo();
+  }
+
+private:
+  ThreadedFunctional2D &operator=(ThreadedFunctional2D const &);
+
+  BoxProcessingFunctional2D *functional_;
+  TileExecutor *executor_;
+};
+
+#endif
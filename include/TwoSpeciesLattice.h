@@ -0,0 +1,177 @@
+#ifndef TWO_SPECIES_LATTICE_H
+#define TWO_SPECIES_LATTICE_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+
+#include "lattice_coupling.h"
+#include "two_species_descriptor.h"
+
+using namespace plb;
+
+// Functionals of the interleaved species lattice (TwoSpeciesD2Q9Descriptor):
+// c1 in the populations, c2 and the cached phi in the externals of the
+// same cell. The species update then reads and writes one record of
+// 19 values per cell instead of walking the c1, c2 and phi lattices in
+// lockstep, each a cell of populations and phase-field externals. The
+// interleaved lattice needs the multi-block management of the phase-field
+// lattices, so that the mixed-descriptor functionals below see the same
+// local coordinates.
+
+// Copies phi from the phase-field lattice into the cached slot of the
+// species cells, on {species, phi}; run after phi changed and on the
+// envelope too, which the fused sweep collides.
+template <typename T, template <typename U> class SpeciesDescriptor,
+          template <typename U> class PhiDescriptor>
+class TwoSpeciesCachePhi2D
+    : public BoxProcessingFunctional2D_LL<T, SpeciesDescriptor, T,
+                                          PhiDescriptor> {
+public:
+  void process(Box2D domain, BlockLattice2D<T, SpeciesDescriptor> &species,
+               BlockLattice2D<T, PhiDescriptor> &phi) override {
+    const plint phiAt = SpeciesDescriptor<T>::ExternalField::phiBeginsAt;
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        *species.get(iX, iY).getExternal(phiAt) =
+            phi.get(iX, iY).computeDensity();
+      }
+    }
+  }
+
+  TwoSpeciesCachePhi2D<T, SpeciesDescriptor, PhiDescriptor> *
+  clone() const override {
+    return new TwoSpeciesCachePhi2D<T, SpeciesDescriptor, PhiDescriptor>(
+        *this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables; // species
+    modified[1] = modif::nothing;         // phi
+  }
+};
+
+// SpeciesCollideAndStream2D on the interleaved lattice: the same collision
+// and swap sweep, with c1, c2 and phi from one cell.
+template <typename T, template <typename U> class Descriptor>
+class TwoSpeciesCollideAndStream2D
+    : public BoxProcessingFunctional2D_L<T, Descriptor> {
+public:
+  TwoSpeciesCollideAndStream2D(T chi, T mu, T a, T b, T epsilon, T c_bulk,
+                               T tau1, T tau2, bool withReaction = true)
+      : collision_(chi, mu, a, b, epsilon, c_bulk, tau1, tau2, withReaction) {}
+
+  void process(Box2D domain, BlockLattice2D<T, Descriptor> &lattice) override {
+    typedef typename Descriptor<T>::ExternalField Externals;
+    swapStreamSweep2D<T, Descriptor, 2>(
+        Box2D(0, lattice.getNx() - 1, 0, lattice.getNy() - 1), domain,
+        nullptr,
+        [&](plint iX, plint iY, T **f) {
+          Cell<T, Descriptor> &cell = lattice.get(iX, iY);
+          f[0] = &cell[0];
+          f[1] = cell.getExternal(Externals::c2BeginsAt);
+        },
+        [&](plint, plint, T **f) {
+          collision_(f[0], f[1],
+                     f[1][Externals::phiBeginsAt - Externals::c2BeginsAt]);
+        });
+  }
+
+  TwoSpeciesCollideAndStream2D<T, Descriptor> *clone() const override {
+    return new TwoSpeciesCollideAndStream2D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables;
+  }
+
+private:
+  SpeciesCollisionCell<T, Descriptor> collision_;
+};
+
+// SpeciesReaction2D on the interleaved lattice, with the cached phi.
+template <typename T, template <typename U> class Descriptor>
+class TwoSpeciesReaction2D : public BoxProcessingFunctional2D_L<T, Descriptor> {
+public:
+  typedef typename ComputeType<T>::type C;
+
+  TwoSpeciesReaction2D(ReactionKinetics<C> const &kinetics,
+                       ReactionIntegrator<C> const &integrator, C dt)
+      : reaction_(kinetics, integrator, dt) {}
+
+  void process(Box2D domain, BlockLattice2D<T, Descriptor> &lattice) override {
+    typedef typename Descriptor<T>::ExternalField Externals;
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        Cell<T, Descriptor> &cell = lattice.get(iX, iY);
+        bool inside = *cell.getExternal(Externals::phiBeginsAt) >= (T)0.5;
+        reaction_(&cell[0], cell.getExternal(Externals::c2BeginsAt), inside);
+      }
+    }
+  }
+
+  TwoSpeciesReaction2D<T, Descriptor> *clone() const override {
+    return new TwoSpeciesReaction2D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables;
+  }
+
+private:
+  SpeciesReactionCell<T, Descriptor> reaction_;
+};
+
+// Moves one species between a separate lattice and the interleaved one, on
+// {separate, interleaved}: species 1 is c1, species 2 is c2. pack copies
+// into the interleaved lattice, unpack back, e.g. for output.
+template <typename T, template <typename U> class SeparateDescriptor,
+          template <typename U> class SpeciesDescriptor>
+class TwoSpeciesTransfer2D
+    : public BoxProcessingFunctional2D_LL<T, SeparateDescriptor, T,
+                                          SpeciesDescriptor> {
+public:
+  TwoSpeciesTransfer2D(int species, bool pack)
+      : species_(species), pack_(pack) {
+    PLB_PRECONDITION(species == 1 || species == 2);
+  }
+
+  void process(Box2D domain, BlockLattice2D<T, SeparateDescriptor> &separate,
+               BlockLattice2D<T, SpeciesDescriptor> &interleaved) override {
+    static_assert(SeparateDescriptor<T>::q == SpeciesDescriptor<T>::q,
+                  "both lattices need the same velocity set");
+    const plint q = SpeciesDescriptor<T>::q;
+    const plint c2At = SpeciesDescriptor<T>::ExternalField::c2BeginsAt;
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        T *from = &separate.get(iX, iY)[0];
+        Cell<T, SpeciesDescriptor> &cell = interleaved.get(iX, iY);
+        T *to = species_ == 1 ? &cell[0] : cell.getExternal(c2At);
+        if (!pack_) {
+          std::swap(from, to);
+        }
+        std::copy(from, from + q, to);
+      }
+    }
+  }
+
+  TwoSpeciesTransfer2D<T, SeparateDescriptor, SpeciesDescriptor> *
+  clone() const override {
+    return new TwoSpeciesTransfer2D<T, SeparateDescriptor, SpeciesDescriptor>(
+        *this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = pack_ ? modif::nothing : modif::staticVariables;
+    modified[1] = pack_ ? modif::staticVariables : modif::nothing;
+  }
+
+private:
+  int species_;
+  bool pack_;
+};
+
+#endif
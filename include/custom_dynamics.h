@@ -1,9 +1,8 @@
-
-
 #ifndef CUSTOM_DYNAMICS_H
 #define CUSTOM_DYNAMICS_H
 #include "palabos2D.h"
 #include "palabos2D.hh"
+#include "LatticeKernels.h"
 
 using namespace plb;
 
@@ -12,6 +11,7 @@ using namespace plb;
 template <typename T, template <typename U> class Descriptor>
 class custom_dynamics : public plb::BGKdynamics<T, Descriptor>
 {
+    typedef DescriptorKernels<T, Descriptor> K;
 
 public:
     custom_dynamics(T omega, T chi, T mu) : BGKdynamics<T, Descriptor>(omega), chi_(chi), mu_(mu) {}
@@ -24,52 +24,22 @@ public:
     T computeEquilibrium(plint iPop, T rhoBar, Array<T, Descriptor<T>::d> const &j, T jSqr) const override
     {
         const T rho_eps = (std::abs(rhoBar) < (T)1e-18) ? (T)1e-18 : rhoBar;
+        const T invRho = (T)1 / rho_eps;
+        T u[K::d];
+        for (int iD = 0; iD < K::d; ++iD)
+            u[iD] = j[iD] * invRho;
 
-        // calculate the usual equilibrium feq
-        const T cs2 = Descriptor<T>::cs2;
-        const T invCs2 = Descriptor<T>::invCs2;
-
-        const T w_i = Descriptor<T>::t[iPop];
-        const Array<T, Descriptor<T>::d> &e_i = Descriptor<T>::c[iPop];
-
-        Array<T, 2> u(j[0] / rho_eps, j[1] / rho_eps);
-
-        T eu = dot(e_i, u);
-        T uu = dot(u, u);
-        T Gamma_i = w_i * (1.0 + eu / cs2 +
-                           0.5 * (eu * eu) / (cs2 * cs2) -
-                           0.5 * uu / cs2);
-
-        // T feq_i = w_i * ((chi_ * mu_ * invCs2) + rhoBar * (Gamma_i - w_i));
-        if (iPop != 0)
-        {
-            T feq_i = w_i * ((chi_ * mu_ * invCs2) + rhoBar * (Gamma_i - w_i));
-            return feq_i;
-        }
-        else
-        {
-            T sumFeq = (T)0;
-            for (plint i = 1; i < Descriptor<T>::q; i++)
-            {
-                const T w = Descriptor<T>::t[i];
-                const Array<T, Descriptor<T>::d> &e = Descriptor<T>::c[i];
-
-                T eu_i = dot(e, u);
-                T Gamma_i_local = w * ((T)1.0 +
-                                       eu_i / cs2 +
-                                       (T)0.5 * (eu_i * eu_i) / (cs2 * cs2) -
-                                       (T)0.5 * uu / cs2);
-
-                sumFeq += w * ((chi_ * mu_) * invCs2 + rhoBar * (Gamma_i_local - w));
-            }
-            T feq_i = rhoBar - sumFeq;
+        return K::reactionDiffusionEquilibrium(iPop, rhoBar, u, chi_ * mu_);
+    }
 
-            return feq_i;
-        }
+    // All q equilibria at once, with the velocity u already divided out.
+    void computeEquilibria(T rho, T const *u, T *feq) const
+    {
+        K::reactionDiffusionEquilibria(rho, u, chi_ * mu_, feq);
     }
 
 private:
     T mu_, chi_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,166 +1,260 @@
 #ifndef LATTICE_COUPLING_H
 #define LATTICE_COUPLING_H
 
+#include "ReactionKinetics.h"
+#include "SpeciesKernels.h"
+#include "SwapStream.h"
 #include "custom_dynamics.h"
 #include <cmath>
 #include <palabos2D.h>
 #include <palabos2D.hh>
+#include "phase_field_descriptor.h"
 
-#define PHI_GRAD_FIELD 21
-#define PHI_LAPLACE_FIELD 22
 using namespace plb;
 
+// Reaction-diffusion collision of the two species lattices, switched by the
+// local phase (SpeciesCollisionCell). Applied to {c1, c2, phi}; all three
+// lattices must share the same multi-block structure so that their local
+// coordinates coincide. With withReaction = false only the diffusive
+// collision is done and the reaction is left to SpeciesReaction2D
+// (operator splitting).
 template <typename T, template <typename U> class Descriptor>
-class lattice_coupling
-    : public BoxProcessingFunctional2D_LL<T, Descriptor, T, Descriptor> {
+class lattice_coupling : public LatticeBoxProcessingFunctional2D<T, Descriptor> {
 public:
   // constructor initialization (order matches member declaration)
-  lattice_coupling(BlockLattice2D<T, Descriptor> &phi, T omega, T chi, T mu,
-                   T a, T b, T epsilon, T c_bulk_k, T tau1, T tau2)
-      : omega_(omega), chi_(chi), mu_(mu), a_(a), b_(b), epsilon_(epsilon),
-        c_bulk_k_(c_bulk_k), tau1_(tau1), tau2_(tau2),
-        dyna_(custom_dynamics<T, Descriptor>(omega, chi, mu)), phi_(phi) {}
-
-  void process(Box2D domain, BlockLattice2D<T, Descriptor> &lattice1,
-               BlockLattice2D<T, Descriptor> &lattice2) override {
-    const T density_floor = (T)1e-12;
+  lattice_coupling(T omega, T chi, T mu, T a, T b, T epsilon, T c_bulk_k,
+                   T tau1, T tau2, bool withReaction = true)
+      : omega_(omega), collision_(chi, mu, a, b, epsilon, c_bulk_k, tau1, tau2,
+                                  withReaction) {}
+
+  void process(Box2D domain,
+               std::vector<BlockLattice2D<T, Descriptor> *> lattices) override {
+    PLB_PRECONDITION(lattices.size() == 3);
+    BlockLattice2D<T, Descriptor> &lattice1 = *lattices[0];
+    BlockLattice2D<T, Descriptor> &lattice2 = *lattices[1];
+    BlockLattice2D<T, Descriptor> &phiLattice = *lattices[2];
 
     for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
       for (plint jY = domain.y0; jY <= domain.y1; ++jY) {
-        Cell<T, Descriptor> &cell1 = lattice1.get(iX, jY);
-        Cell<T, Descriptor> &cell2 = lattice2.get(iX, jY);
-        Cell<T, Descriptor> &cellPhi = phi_.get(iX, jY);
-
-        // densities with floor
-        T c1 = std::max(cell1.computeDensity(), density_floor);
-        T c2 = std::max(cell2.computeDensity(), density_floor);
-        T phi_val = std::max(cellPhi.computeDensity(), density_floor);
-
-        // compute velocity and momentum for lattice1
-        Array<T, Descriptor<T>::d> u1;
-        cell1.computeVelocity(u1);               // fills u1
-        Array<T, Descriptor<T>::d> j1 = c1 * u1; // momentum
-        T jSqr1 = dot(j1, j1);
-
-        // compute velocity and momentum for lattice2
-        Array<T, Descriptor<T>::d> u2;
-        cell2.computeVelocity(u2);
-        Array<T, Descriptor<T>::d> j2 = c2 * u2;
-        T jSqr2 = dot(j2, j2);
-
-        // reaction / source terms
-        T Sj1 = (T)0;
-        T Sj2 = (T)0;
-
-        if (phi_val >= (T)0.5) {
-          T J1 = (1.0 / epsilon_) *
-                 (c1 * (c1 - (T)1.0) - ((b_ * c2 * (c1 - a_)) / (c1 + a_)));
-          T J2 = c1 - c2;
-          Sj1 = J1;
-          Sj2 = J2;
-        } else {
-          Sj1 = -(c1 - c_bulk_k_);
-          Sj2 = -(c2 - c_bulk_k_);
-        }
-
-        // collision step: use computed j and j^2 for equilibrium
-        for (plint iPop = 0; iPop < Descriptor<T>::q; ++iPop) {
-          T feq1 = dyna_.computeEquilibrium(iPop, c1, j1, jSqr1);
-          T feq2 = dyna_.computeEquilibrium(iPop, c2, j2, jSqr2);
-
-          T f1 = cell1[iPop];
-          T f2 = cell2[iPop];
-
-          cell1[iPop] = f1 - (f1 - feq1) / tau1_ + Sj1;
-          cell2[iPop] = f2 - (f2 - feq2) / tau2_ + Sj2;
-        }
+        collision_(&lattice1.get(iX, jY)[0], &lattice2.get(iX, jY)[0],
+                   phiLattice.get(iX, jY).computeDensity());
       }
     }
   }
 
   lattice_coupling<T, Descriptor> *clone() const override {
-    return new lattice_coupling<T, Descriptor>(
-        phi_, omega_, chi_, mu_, a_, b_, epsilon_, c_bulk_k_, tau1_, tau2_);
+    return new lattice_coupling<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables; // c1
+    modified[1] = modif::staticVariables; // c2
+    modified[2] = modif::nothing;         // phi is read only
   }
 
 private:
   // members (declaration order matters for initialization order)
-  T omega_, chi_, mu_;
-  T a_, b_;
-  T epsilon_;
-  T c_bulk_k_;
-  T tau1_, tau2_;
-  custom_dynamics<T, Descriptor> dyna_;
-  BlockLattice2D<T, Descriptor> &phi_;
+  T omega_;
+  SpeciesCollisionCell<T, Descriptor> collision_;
 };
 
-// class CouplePhiMomentum
-#define PHI_GRAD_FIELD 21
-#define PHI_LAPLACE_FIELD 22
-
+// Reaction half of the operator-split species update (SpeciesReactionCell).
+// Applied to {c1, c2, phi}, like lattice_coupling; cell-local, so it can
+// run on bulk and envelope.
 template <typename T, template <typename U> class Descriptor>
-class PhiPcoupling2D
-    : public BoxProcessingFunctional2D_LL<T, Descriptor, T, Descriptor> {
+class SpeciesReaction2D
+    : public LatticeBoxProcessingFunctional2D<T, Descriptor> {
 public:
-  PhiPcoupling2D(T beta, T kappa) : beta_(beta), kappa_(kappa) {}
+  typedef typename ComputeType<T>::type C;
 
-  // this method need to be overrided , 
-  void process(Box2D domain, BlockLattice2D<T, Descriptor> &phiLattice,
-               BlockLattice2D<T, Descriptor> &pLattice) override {
+  SpeciesReaction2D(ReactionKinetics<C> const &kinetics,
+                    ReactionIntegrator<C> const &integrator, C dt)
+      : reaction_(kinetics, integrator, dt) {}
 
-    const T cs2 = Descriptor<T>::cs2;
+  void process(Box2D domain,
+               std::vector<BlockLattice2D<T, Descriptor> *> lattices) override {
+    PLB_PRECONDITION(lattices.size() == 3);
+    BlockLattice2D<T, Descriptor> &lattice1 = *lattices[0];
+    BlockLattice2D<T, Descriptor> &lattice2 = *lattices[1];
+    BlockLattice2D<T, Descriptor> &phiLattice = *lattices[2];
 
     for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
       for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        bool inside = phiLattice.get(iX, iY).computeDensity() >= (T)0.5;
+        reaction_(&lattice1.get(iX, iY)[0], &lattice2.get(iX, iY)[0], inside);
+      }
+    }
+  }
 
-        // ---- Step 1: Get phi, grad(phi), laplacian(phi) ----
-        T phi = phiLattice.get(iX, iY).computeDensity();
+  SpeciesReaction2D<T, Descriptor> *clone() const override {
+    return new SpeciesReaction2D<T, Descriptor>(*this);
+  }
 
-        Array<T, 2> gradPhi =
-            phiLattice.get(iX, iY).template getExternal<Array<T, 2>>(
-                PHI_GRAD_FIELD);
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables; // c1
+    modified[1] = modif::staticVariables; // c2
+    modified[2] = modif::nothing;         // phi is read only
+  }
 
-        T lapPhi =
-            phiLattice.get(iX, iY).template getExternal<T>(PHI_LAPLACE_FIELD);
+private:
+  SpeciesReactionCell<T, Descriptor> reaction_;
+};
 
-        // ---- Step 2: Compute mu_phi and surface-tension force ----
-        T muPhi =
-            4.0 * beta_ * phi * (phi - 0.5) * (phi - 1.0) - kappa_ * lapPhi;
+// lattice_coupling fused with the streaming of c1 and c2: one in-place
+// sweep over each atomic block (swapStreamSweep2D) that loads every
+// population once and stores it once, instead of a collision pass followed
+// by MultiBlockLattice2D::stream(). Applied to {c1, c2, phi} on bulk and
+// envelope, like lattice_coupling, with the same result. The envelope is
+// stale afterwards. With an executor the block is swept in slabs by its
+// threads.
+template <typename T, template <typename U> class Descriptor>
+class SpeciesCollideAndStream2D
+    : public LatticeBoxProcessingFunctional2D<T, Descriptor> {
+public:
+  SpeciesCollideAndStream2D(T chi, T mu, T a, T b, T epsilon, T c_bulk,
+                            T tau1, T tau2, bool withReaction = true,
+                            TileExecutor *executor = nullptr)
+      : collision_(chi, mu, a, b, epsilon, c_bulk, tau1, tau2, withReaction),
+        executor_(executor) {}
+
+  void process(Box2D domain,
+               std::vector<BlockLattice2D<T, Descriptor> *> lattices) override {
+    PLB_PRECONDITION(lattices.size() == 3);
+    BlockLattice2D<T, Descriptor> &lattice1 = *lattices[0];
+    BlockLattice2D<T, Descriptor> &lattice2 = *lattices[1];
+    BlockLattice2D<T, Descriptor> &phiLattice = *lattices[2];
+
+    swapStreamSweep2D<T, Descriptor, 2>(
+        Box2D(0, lattice1.getNx() - 1, 0, lattice1.getNy() - 1), domain,
+        executor_,
+        [&](plint iX, plint iY, T **f) {
+          f[0] = &lattice1.get(iX, iY)[0];
+          f[1] = &lattice2.get(iX, iY)[0];
+        },
+        [&](plint iX, plint iY, T **f) {
+          collision_(f[0], f[1], phiLattice.get(iX, iY).computeDensity());
+        });
+  }
 
-        Array<T, 2> Fs;
-        Fs[0] = muPhi * gradPhi[0];
-        Fs[1] = muPhi * gradPhi[1];
+  SpeciesCollideAndStream2D<T, Descriptor> *clone() const override {
+    return new SpeciesCollideAndStream2D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables; // c1
+    modified[1] = modif::staticVariables; // c2
+    modified[2] = modif::nothing;         // phi is read only
+  }
+
+private:
+  SpeciesCollisionCell<T, Descriptor> collision_;
+  TileExecutor *executor_;
+};
 
-        // ---- Step 3: Apply Fs as a source to the P lattice ----
-        T rho = pLattice.get(iX, iY).computeDensity();
-        Array<T, 2> j;
-        pLattice.get(iX, iY).computeMomentum(j);
+// SpeciesCollideAndStream2D over several steps at once, with temporal
+// blocking (blockedSwapStream2D): tiles of tileSize x tileSize cells are
+// advanced through all the steps while they stay in cache. Applied on the
+// bulk to {c1, c2, phi_0, ..., phi_{n-1}}, where the scalar fields hold the
+// phi density of each of the n steps, so that the species see the phase
+// of every step as they would one step at a time. All blocks must share
+// one multi-block structure, with an envelope of at least n cells that is
+// up to date in c1, c2 and every phi_s; the envelope of c1 and c2 is stale
+// afterwards. boundingBox is the whole domain: along its edges the
+// envelope is never exchanged and is advanced with the bulk. With an
+// executor the tiles of a block are shared among its threads.
+template <typename T, template <typename U> class Descriptor>
+class BlockedSpeciesCollideAndStream2D : public BoxProcessingFunctional2D {
+public:
+  BlockedSpeciesCollideAndStream2D(T chi, T mu, T a, T b, T epsilon,
+                                   T c_bulk, T tau1, T tau2,
+                                   Box2D const &boundingBox, plint tileSize,
+                                   TileExecutor *executor = nullptr)
+      : collision_(chi, mu, a, b, epsilon, c_bulk, tau1, tau2, true),
+        boundingBox_(boundingBox), tileSize_(tileSize), executor_(executor) {}
+
+  void process(Box2D domain, std::vector<AtomicBlock2D *> blocks) override {
+    PLB_PRECONDITION(blocks.size() >= 3);
+    BlockLattice2D<T, Descriptor> &lattice1 =
+        dynamic_cast<BlockLattice2D<T, Descriptor> &>(*blocks[0]);
+    BlockLattice2D<T, Descriptor> &lattice2 =
+        dynamic_cast<BlockLattice2D<T, Descriptor> &>(*blocks[1]);
+    std::vector<ScalarField2D<T> *> phi;
+    for (pluint i = 2; i < blocks.size(); ++i) {
+      phi.push_back(dynamic_cast<ScalarField2D<T> *>(blocks[i]));
+    }
+    const plint numSteps = (plint)phi.size();
 
-        Array<T, 2> u;
-        for (int d = 0; d < 2; ++d)
-          u[d] = j[d] / (rho + 1e-18);
+    Box2D block(0, lattice1.getNx() - 1, 0, lattice1.getNy() - 1);
+    Dot2D location = lattice1.getLocation();
+    Box2D core(domain);
+    if (domain.x0 + location.x == boundingBox_.x0) {
+      core.x0 = block.x0;
+    }
+    if (domain.x1 + location.x == boundingBox_.x1) {
+      core.x1 = block.x1;
+    }
+    if (domain.y0 + location.y == boundingBox_.y0) {
+      core.y0 = block.y0;
+    }
+    if (domain.y1 + location.y == boundingBox_.y1) {
+      core.y1 = block.y1;
+    }
+    PLB_PRECONDITION(domain.x0 >= numSteps && domain.y0 >= numSteps);
+
+    blockedSwapStream2D<T, Descriptor, 2>(
+        block, core, numSteps, tileSize_, executor_,
+        [&](plint iX, plint iY, T **f) {
+          f[0] = &lattice1.get(iX, iY)[0];
+          f[1] = &lattice2.get(iX, iY)[0];
+        },
+        [&](plint iX, plint iY, plint step, T **f) {
+          collision_(f[0], f[1], phi[step]->get(iX, iY));
+        });
+  }
 
-        for (plint iPop = 0; iPop < Descriptor<T>::q; ++iPop) {
-          const Array<T, 2> &e_i = Descriptor<T>::c[iPop];
-          T w_i = Descriptor<T>::t[iPop];
+  BlockedSpeciesCollideAndStream2D<T, Descriptor> *clone() const override {
+    return new BlockedSpeciesCollideAndStream2D<T, Descriptor>(*this);
+  }
 
-          T eu = dot(e_i, u);
-          T uu = dot(u, u);
-          T Gamma_i = w_i * (1.0 + eu / cs2 + 0.5 * (eu * eu) / (cs2 * cs2) -
-                             0.5 * uu / cs2);
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables; // c1
+    modified[1] = modif::staticVariables; // c2
+    for (pluint i = 2; i < modified.size(); ++i) {
+      modified[i] = modif::nothing; // phi of each step is read only
+    }
+  }
 
-          // S_j = dt * Gamma_j * (e_j - u) · Fs
-          Array<T, 2> diff = e_i - u;
-          T Sj = Gamma_i * dot(diff, Fs);
+private:
+  SpeciesCollisionCell<T, Descriptor> collision_;
+  Box2D boundingBox_;
+  plint tileSize_;
+  TileExecutor *executor_;
+};
 
-          T f_old = pLattice.get(iX, iY)[iPop];
-          T feq = pLattice.get(iX, iY).getDynamics().computeEquilibrium(
-              iPop, rho, j, dot(j, j));
-          T omega = 1.0 / pLattice.get(iX, iY).getDynamics().getTau();
+// class CouplePhiMomentum
+// Stores the surface-tension force Fs = mu_phi grad(phi), both read from the
+// phi lattice externals written by FusedInterfaceFunctional2D, in
+// FORCE_FIELD of the momentum lattice, where DynamicsMomentum applies it
+// with Guo forcing during its collision.
+template <typename T, template <typename U> class Descriptor>
+class PhiPcoupling2D
+    : public BoxProcessingFunctional2D_LL<T, Descriptor, T, Descriptor> {
+public:
+  void process(Box2D domain, BlockLattice2D<T, Descriptor> &phiLattice,
+               BlockLattice2D<T, Descriptor> &pLattice) override {
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        Cell<T, Descriptor> &cellPhi = phiLattice.get(iX, iY);
+        T muPhi = *cellPhi.getExternal(PHI_MU_FIELD);
+        Array<T, 2> gradPhi = getExternalVector(cellPhi, PHI_GRAD_FIELD);
 
-          // collision
-          pLattice.get(iX, iY)[iPop] = f_old - (f_old - feq) * omega + Sj;
-        }
+        T *Fs = pLattice.get(iX, iY).getExternal(FORCE_FIELD);
+        Fs[0] = muPhi * gradPhi[0];
+        Fs[1] = muPhi * gradPhi[1];
       }
     }
   }
@@ -169,8 +263,11 @@ public:
     return new PhiPcoupling2D<T, Descriptor>(*this);
   }
 
-private:
-  T beta_, kappa_;
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::nothing;         // phi
+    modified[1] = modif::staticVariables; // momentum
+  }
 };
 
 #endif
@@ -0,0 +1,139 @@
+#ifndef LATTICE_COUPLING_3D_H
+#define LATTICE_COUPLING_3D_H
+
+#include "palabos3D.h"
+#include "palabos3D.hh"
+
+#include "ReactionKinetics.h"
+#include "SpeciesKernels.h"
+
+using namespace plb;
+
+// 3D counterparts of the functionals of lattice_coupling.h, with the same
+// per-cell kernels and the same lattice arguments.
+
+// Reaction-diffusion collision of {c1, c2, phi} (see lattice_coupling).
+template <typename T, template <typename U> class Descriptor>
+class lattice_coupling3D
+    : public LatticeBoxProcessingFunctional3D<T, Descriptor> {
+public:
+  lattice_coupling3D(T chi, T mu, T a, T b, T epsilon, T c_bulk, T tau1,
+                     T tau2, bool withReaction = true)
+      : collision_(chi, mu, a, b, epsilon, c_bulk, tau1, tau2, withReaction) {}
+
+  void process(Box3D domain,
+               std::vector<BlockLattice3D<T, Descriptor> *> lattices) override {
+    PLB_PRECONDITION(lattices.size() == 3);
+    BlockLattice3D<T, Descriptor> &lattice1 = *lattices[0];
+    BlockLattice3D<T, Descriptor> &lattice2 = *lattices[1];
+    BlockLattice3D<T, Descriptor> &phiLattice = *lattices[2];
+
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        for (plint iZ = domain.z0; iZ <= domain.z1; ++iZ) {
+          collision_(&lattice1.get(iX, iY, iZ)[0],
+                     &lattice2.get(iX, iY, iZ)[0],
+                     phiLattice.get(iX, iY, iZ).computeDensity());
+        }
+      }
+    }
+  }
+
+  lattice_coupling3D<T, Descriptor> *clone() const override {
+    return new lattice_coupling3D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables; // c1
+    modified[1] = modif::staticVariables; // c2
+    modified[2] = modif::nothing;         // phi is read only
+  }
+
+private:
+  SpeciesCollisionCell<T, Descriptor> collision_;
+};
+
+// Operator-split species reaction on {c1, c2, phi} (see SpeciesReaction2D).
+template <typename T, template <typename U> class Descriptor>
+class SpeciesReaction3D
+    : public LatticeBoxProcessingFunctional3D<T, Descriptor> {
+public:
+  typedef typename ComputeType<T>::type C;
+
+  SpeciesReaction3D(ReactionKinetics<C> const &kinetics,
+                    ReactionIntegrator<C> const &integrator, C dt)
+      : reaction_(kinetics, integrator, dt) {}
+
+  void process(Box3D domain,
+               std::vector<BlockLattice3D<T, Descriptor> *> lattices) override {
+    PLB_PRECONDITION(lattices.size() == 3);
+    BlockLattice3D<T, Descriptor> &lattice1 = *lattices[0];
+    BlockLattice3D<T, Descriptor> &lattice2 = *lattices[1];
+    BlockLattice3D<T, Descriptor> &phiLattice = *lattices[2];
+
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        for (plint iZ = domain.z0; iZ <= domain.z1; ++iZ) {
+          bool inside =
+              phiLattice.get(iX, iY, iZ).computeDensity() >= (T)0.5;
+          reaction_(&lattice1.get(iX, iY, iZ)[0],
+                    &lattice2.get(iX, iY, iZ)[0], inside);
+        }
+      }
+    }
+  }
+
+  SpeciesReaction3D<T, Descriptor> *clone() const override {
+    return new SpeciesReaction3D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables; // c1
+    modified[1] = modif::staticVariables; // c2
+    modified[2] = modif::nothing;         // phi is read only
+  }
+
+private:
+  SpeciesReactionCell<T, Descriptor> reaction_;
+};
+
+// Surface-tension force Fs = mu_phi grad(phi) from the phi externals into
+// the force externals of the momentum lattice (see PhiPcoupling2D).
+template <typename T, template <typename U> class Descriptor>
+class PhiPcoupling3D
+    : public BoxProcessingFunctional3D_LL<T, Descriptor, T, Descriptor> {
+public:
+  void process(Box3D domain, BlockLattice3D<T, Descriptor> &phiLattice,
+               BlockLattice3D<T, Descriptor> &pLattice) override {
+    typedef typename Descriptor<T>::ExternalField Externals;
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        for (plint iZ = domain.z0; iZ <= domain.z1; ++iZ) {
+          Cell<T, Descriptor> &cellPhi = phiLattice.get(iX, iY, iZ);
+          T muPhi = *cellPhi.getExternal(Externals::muBeginsAt);
+          T const *gradPhi = cellPhi.getExternal(Externals::gradBeginsAt);
+
+          T *Fs =
+              pLattice.get(iX, iY, iZ).getExternal(Externals::forceBeginsAt);
+          Fs[0] = muPhi * gradPhi[0];
+          Fs[1] = muPhi * gradPhi[1];
+          Fs[2] = muPhi * gradPhi[2];
+        }
+      }
+    }
+  }
+
+  PhiPcoupling3D<T, Descriptor> *clone() const override {
+    return new PhiPcoupling3D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::nothing;         // phi
+    modified[1] = modif::staticVariables; // momentum
+  }
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef LATTICE_INITILIZATION_3D_H
+#define LATTICE_INITILIZATION_3D_H
+
+#include "palabos3D.h"
+#include "palabos3D.hh"
+#include <algorithm>
+#include <cmath>
+
+using namespace plb;
+
+// Spherical droplet with the tanh interface profile of
+// InitializePhiFunctional.
+template <typename T, template <typename U> class Descriptor>
+class InitializePhiFunctional3D
+    : public BoxProcessingFunctional3D_L<T, Descriptor> {
+public:
+  InitializePhiFunctional3D(T r0, T zeta, plint cx, plint cy, plint cz)
+      : r0_(r0), zeta_(std::max(T(1e-3), zeta)), cx_(cx), cy_(cy), cz_(cz) {}
+
+  void process(Box3D domain, BlockLattice3D<T, Descriptor> &lattice) override {
+    Array<T, 3> u(0.0, 0.0, 0.0);
+    Dot3D location = lattice.getLocation();
+    for (plint iX = domain.x0; iX <= domain.x1; ++iX) {
+      for (plint iY = domain.y0; iY <= domain.y1; ++iY) {
+        for (plint iZ = domain.z0; iZ <= domain.z1; ++iZ) {
+          T dx = iX + location.x - cx_;
+          T dy = iY + location.y - cy_;
+          T dz = iZ + location.z - cz_;
+          T arg = (T)2 / zeta_ * (std::sqrt(dx * dx + dy * dy + dz * dz) - r0_);
+          T phi = (T)0.5 * ((T)1 - std::tanh(std::min(arg, (T)50)));
+          phi = std::max(T(1e-8), std::min(phi, T(1.0)));
+
+          Cell<T, Descriptor> &cell = lattice.get(iX, iY, iZ);
+          iniCellAtEquilibrium(cell, phi, u);
+        }
+      }
+    }
+  }
+
+  InitializePhiFunctional3D<T, Descriptor> *clone() const override {
+    return new InitializePhiFunctional3D<T, Descriptor>(*this);
+  }
+
+  void
+  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
+    modified[0] = modif::staticVariables;
+  }
+
+private:
+  T r0_, zeta_;
+  plint cx_, cy_, cz_;
+};
+
+#endif
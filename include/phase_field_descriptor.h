@@ -0,0 +1,68 @@
+#ifndef PHASE_FIELD_DESCRIPTOR_H
+#define PHASE_FIELD_DESCRIPTOR_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+
+using namespace plb;
+
+// External scalars shared by the phi, c1, c2 and momentum lattices. All four
+// lattices use the same descriptor so they have the same multi-block layout
+// and can be passed together to lattice processing functionals. On the phi
+// lattice, n-hat, grad(phi), the Laplacian and mu_phi are all written by
+// FusedInterfaceFunctional2D, which DropletModel runs before the first step
+// (refreshDerivedFields()) and then every step before the couplings.
+#define PHI_NORMGRAD_FIELD 0 // n-hat, 2 scalars
+#define PHI_GRAD_FIELD 2     // grad(phi), 2 scalars
+#define PHI_LAPLACE_FIELD 4  // laplacian(phi), 1 scalar
+#define FORCE_FIELD 5        // surface-tension force Fs, 2 scalars
+#define PHI_MU_FIELD 7       // chemical potential mu_phi, 1 scalar
+
+namespace plb {
+namespace descriptors {
+
+struct PhaseFieldExternals2D {
+  static const int numScalars = 8;
+  static const int numSpecies = 4;
+
+  static const int normGradBeginsAt = PHI_NORMGRAD_FIELD;
+  static const int sizeOfNormGrad = 2;
+
+  static const int gradBeginsAt = PHI_GRAD_FIELD;
+  static const int sizeOfGrad = 2;
+
+  static const int laplaceBeginsAt = PHI_LAPLACE_FIELD;
+  static const int sizeOfLaplace = 1;
+
+  static const int forceBeginsAt = FORCE_FIELD;
+  static const int sizeOfForce = 2;
+
+  static const int muBeginsAt = PHI_MU_FIELD;
+  static const int sizeOfMu = 1;
+};
+
+struct PhaseFieldExternalsBase2D {
+  typedef PhaseFieldExternals2D ExternalField;
+};
+
+template <typename T>
+struct PhaseFieldD2Q9Descriptor : public D2Q9DescriptorBase<T>,
+                                  public PhaseFieldExternalsBase2D {
+  static const char name[];
+};
+
+template <typename T>
+const char PhaseFieldD2Q9Descriptor<T>::name[] = "PhaseFieldD2Q9";
+
+} // namespace descriptors
+} // namespace plb
+
+// Read a 2-component external field of a cell.
+template <typename T, template <typename U> class Descriptor>
+inline Array<T, 2> getExternalVector(Cell<T, Descriptor> const &cell,
+                                     plint offset) {
+  T const *ext = cell.getExternal(offset);
+  return Array<T, 2>(ext[0], ext[1]);
+}
+
+#endif
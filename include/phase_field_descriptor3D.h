@@ -0,0 +1,66 @@
+#ifndef PHASE_FIELD_DESCRIPTOR_3D_H
+#define PHASE_FIELD_DESCRIPTOR_3D_H
+
+#include "palabos3D.h"
+#include "palabos3D.hh"
+
+using namespace plb;
+
+// External scalars of the 3D model, in the order of the 2D ones
+// (phase_field_descriptor.h) with three-component vectors. Kernels shared
+// with the 2D model read the offsets from ExternalField.
+#define PHI_NORMGRAD_FIELD_3D 0 // n-hat, 3 scalars
+#define PHI_GRAD_FIELD_3D 3     // grad(phi), 3 scalars
+#define PHI_LAPLACE_FIELD_3D 6  // laplacian(phi), 1 scalar
+#define FORCE_FIELD_3D 7        // surface-tension force Fs, 3 scalars
+#define PHI_MU_FIELD_3D 10      // chemical potential mu_phi, 1 scalar
+
+namespace plb {
+namespace descriptors {
+
+struct PhaseFieldExternals3D {
+  static const int numScalars = 11;
+  static const int numSpecies = 5;
+
+  static const int normGradBeginsAt = PHI_NORMGRAD_FIELD_3D;
+  static const int sizeOfNormGrad = 3;
+
+  static const int gradBeginsAt = PHI_GRAD_FIELD_3D;
+  static const int sizeOfGrad = 3;
+
+  static const int laplaceBeginsAt = PHI_LAPLACE_FIELD_3D;
+  static const int sizeOfLaplace = 1;
+
+  static const int forceBeginsAt = FORCE_FIELD_3D;
+  static const int sizeOfForce = 3;
+
+  static const int muBeginsAt = PHI_MU_FIELD_3D;
+  static const int sizeOfMu = 1;
+};
+
+struct PhaseFieldExternalsBase3D {
+  typedef PhaseFieldExternals3D ExternalField;
+};
+
+template <typename T>
+struct PhaseFieldD3Q19Descriptor : public D3Q19DescriptorBase<T>,
+                                   public PhaseFieldExternalsBase3D {
+  static const char name[];
+};
+
+template <typename T>
+const char PhaseFieldD3Q19Descriptor<T>::name[] = "PhaseFieldD3Q19";
+
+template <typename T>
+struct PhaseFieldD3Q27Descriptor : public D3Q27DescriptorBase<T>,
+                                   public PhaseFieldExternalsBase3D {
+  static const char name[];
+};
+
+template <typename T>
+const char PhaseFieldD3Q27Descriptor<T>::name[] = "PhaseFieldD3Q27";
+
+} // namespace descriptors
+} // namespace plb
+
+#endif
@@ -3,56 +3,130 @@
 
 #include "palabos2D.h"
 #include "palabos2D.hh"
+#include "LatticeKernels.h"
 
 using namespace plb;
 
-#define PHI_NORMGRAD_FIELD 20
+// Collision model of the phase-field lattice.
+enum class PhaseCollision {
+  // single relaxation time
+  bgk,
+  // BGK on the first-order projection of f - feq; removes the ghost modes
+  // so omega close to 2 (small M, thin interfaces) stays stable
+  regularized,
+  // two relaxation times: the odd part relaxes with the omega set by M,
+  // the even part with the omega fixed by the magic parameter Lambda
+  trt
+};
 
+// Works on any velocity set of LatticeKernels (D2Q9, D3Q19, D3Q27); n-hat
+// is read from the externals at ExternalField::normGradBeginsAt.
 template <typename T, template <typename U> class Descriptor>
 class phi : public BGKdynamics<T, Descriptor> {
-
 public:
-  phi(T M, T zeta) : M_(M), zeta_(zeta) {}
+  // Conservative Allen-Cahn relaxation: tau = M / cs2 + 1/2. Lambda = 1/4
+  // is the usual TRT choice for advection-diffusion (it cancels the leading
+  // numerical diffusion of the even moments).
+  phi(T M, T zeta, PhaseCollision collision = PhaseCollision::bgk,
+      T magic = (T)0.25)
+      : BGKdynamics<T, Descriptor>((T)1 /
+                                   (M * Descriptor<T>::invCs2 + (T)0.5)),
+        M_(M), zeta_(zeta), collision_(collision), magic_(magic) {}
 
   // must override this method ,if inhereted from dynamics class
   phi<T, Descriptor> *clone() const override {
     return new phi<T, Descriptor>(*this);
   }
 
+  // n-hat is read once per cell and all equilibria come from one kernel
+  // call. Populations and equilibria are both in Palabos' shifted storage
+  // (f_i - t_i), so the collision conserves phi exactly. The arithmetic is
+  // done in ComputeType<T>.
+  void collide(Cell<T, Descriptor> &cell,
+               BlockStatistics &statistics) override {
+    typedef typename ComputeType<T>::type C;
+    typedef DescriptorKernels<C, Descriptor> K;
+    C f[K::q];
+    K::load(&cell[0], f);
+
+    C rhoBar, u[K::d];
+    K::rhoBarJ(f, rhoBar, u);
+    const C rho = Descriptor<C>::fullRho(rhoBar);
+    const C invRho = (C)1 / safeRho(rho);
+    C nHat[K::d];
+    T const *storedNHat = cell.getExternal(normGradBeginsAt);
+    for (int iD = 0; iD < K::d; ++iD) {
+      u[iD] *= invRho;
+      nHat[iD] = (C)storedNHat[iD];
+    }
+
+    C feq[K::q];
+    K::phaseFieldEquilibria(rho, u, nHat, (C)M_, (C)zeta_, feq);
+    K::unroll([&](auto i) {
+      constexpr int iPop = decltype(i)::value;
+      feq[iPop] -= K::t[iPop];
+    });
+
+    const C omega = (C)this->getOmega();
+    switch (collision_) {
+    case PhaseCollision::regularized:
+      K::regularizedFirstOrderRelax(f, feq, omega);
+      break;
+    case PhaseCollision::trt:
+      K::trtRelax(f, feq, (C)evenOmega(this->getOmega()), omega);
+      break;
+    default:
+      K::bgkRelax(f, feq, omega);
+    }
+    K::store(f, &cell[0]);
+
+    if (cell.takesStatistics()) {
+      gatherStatistics(statistics, (T)rhoBar, (T)K::normSqr(u));
+    }
+  }
+
+  // Equilibrium for the n-hat of the cell, which the caller reads from the
+  // cell's externals at normGradBeginsAt, as collide() does.
   T computeEquilibrium(plint iPop, T rhoBar,
                        Array<T, Descriptor<T>::d> const &j,
-                       T jSqr) const override {
-
-    const T rho_eps = (std::abs(rhoBar) < (T)1e-18) ? (T)1e-18 : rhoBar;
-
-    // calculate the usual equilibrium feq
-    const T cs2 = Descriptor<T>::cs2;
-    const T invCs2 = Descriptor<T>::invCs2;
-
-    const T w_i = Descriptor<T>::t[iPop];
-    const Array<T, Descriptor<T>::d> &e_i = Descriptor<T>::c[iPop];
-    Array<T, 2> u(j[0] / rho_eps, j[1] / rho_eps);
+                       T const *nHat) const {
+    typedef DescriptorKernels<T, Descriptor> K;
+    const T rho = Descriptor<T>::fullRho(rhoBar);
+    const T invRho = (T)1 / safeRho(rho);
+    T u[K::d];
+    for (int iD = 0; iD < K::d; ++iD) {
+      u[iD] = j[iD] * invRho;
+    }
+    return K::phaseFieldEquilibrium(iPop, rho, u, nHat, M_, zeta_) - K::t[iPop];
+  }
 
-    T eu = dot(e_i, u);
-    T uu = dot(u, u);
-    T Gamma_i =
-        w_i * (1.0 + eu / cs2 + 0.5 * (eu * eu) / (cs2 * cs2) - 0.5 * uu / cs2);
+  // Dynamics do not see their cell, so the Palabos entry point has no n-hat:
+  // it returns the equilibrium without the interface term (n-hat = 0).
+  T computeEquilibrium(plint iPop, T rhoBar,
+                       Array<T, Descriptor<T>::d> const &j,
+                       T jSqr) const override {
+    T const zero[Descriptor<T>::d] = {};
+    return computeEquilibrium(iPop, rhoBar, j, zero);
+  }
 
-    // phi i.e  rhobar -> 0th momentum
-    T term1 = rhoBar * Gamma_i;
-    Array<T, 2> nHat =
-        this->getCell().template getExternal<Array<T, 2>>(PHI_NORMGRAD_FIELD);
+  PhaseCollision getCollision() const { return collision_; }
 
-    T enHat = dot(e_i, nHat);
+  // Relaxation rate of the even moments under TRT.
+  T evenOmega(T omega) const {
+    return (T)1 / (magic_ / ((T)1 / omega - (T)0.5) + (T)0.5);
+  }
 
-    T term2 =
-        w_i * M_ * invCs2 * (4.0 / zeta_) * rhoBar * (1.0 - rhoBar) * enHat;
+private:
+  static const int normGradBeginsAt =
+      Descriptor<T>::ExternalField::normGradBeginsAt;
 
-    return term1 + term2;
+  template <typename C> static C safeRho(C rho) {
+    return (std::abs(rho) < (C)1e-18) ? (C)1e-18 : rho;
   }
 
-private:
   T M_, zeta_;
+  PhaseCollision collision_;
+  T magic_;
 };
 
-#endif
\ No newline at end of file
+#endif
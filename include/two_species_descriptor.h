@@ -0,0 +1,46 @@
+#ifndef TWO_SPECIES_DESCRIPTOR_H
+#define TWO_SPECIES_DESCRIPTOR_H
+
+#include "palabos2D.h"
+#include "palabos2D.hh"
+
+using namespace plb;
+
+// Interleaved storage of both species: the populations of c1 are the
+// populations of the cell, those of c2 and the phi value the species
+// collision reads follow as externals, so one cell holds everything the
+// coupling touches in one contiguous record (see TwoSpeciesLattice.h).
+#define SPECIES_C2_FIELD 0  // c2 populations, 9 scalars
+#define SPECIES_PHI_FIELD 9 // phi cached from the phase-field lattice
+
+namespace plb {
+namespace descriptors {
+
+struct TwoSpeciesExternals2D {
+  static const int numScalars = 10;
+  static const int numSpecies = 2;
+
+  static const int c2BeginsAt = SPECIES_C2_FIELD;
+  static const int sizeOfC2 = 9;
+
+  static const int phiBeginsAt = SPECIES_PHI_FIELD;
+  static const int sizeOfPhi = 1;
+};
+
+struct TwoSpeciesExternalsBase2D {
+  typedef TwoSpeciesExternals2D ExternalField;
+};
+
+template <typename T>
+struct TwoSpeciesD2Q9Descriptor : public D2Q9DescriptorBase<T>,
+                                  public TwoSpeciesExternalsBase2D {
+  static const char name[];
+};
+
+template <typename T>
+const char TwoSpeciesD2Q9Descriptor<T>::name[] = "TwoSpeciesD2Q9";
+
+} // namespace descriptors
+} // namespace plb
+
+#endif
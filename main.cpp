@@ -10,146 +10,509 @@
 #include "palabos2D.h"
 #include "palabos2D.hh"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <vector>
 
-#include "ComputeNormGradient.h"
+#include "AsyncOutputWriter.h"
+#include "DropletModel.h"
+#include "LiveView.h"
+#include "LoadBalancer.h"
+#include "PrecisionValidation.h"
+#include "Profiler.h"
+#include "RefinedDropletModel.h"
+#include "SnapshotIO.h"
 
 using namespace plb;
-typedef double T;
-#define DESCRIPTOR descriptors::D2Q9Descriptor
+#define DESCRIPTOR descriptors::PhaseFieldD2Q9Descriptor
 
-template <typename U>
-void writeField(plb_ofstream &file, TensorField2D<U, 2> &nhat) {
-
-  plint nx = nhat.getNx();
-  plint ny = nhat.getNy();
-  file << 'x' << ' ' << 'y' << ' ' << "nx" << ' ' << "ny" << std::endl;
-  for (plint iX = 0; iX < nx; ++iX) {
-    for (plint iY = 0; iY < ny; ++iY) {
+// Density of phi, c1 and c2, n-hat and the flow velocity
+// (python/lbm_snapshot.py reads the snapshots).
+template <typename T, template <typename U> class Descriptor>
+void stageOutput(DropletModel<T, Descriptor> &model, SnapshotFrame &frame) {
+  stageSnapshotDensity(frame, "phi", model.getPhi());
+  stageSnapshotDensity(frame, "c1", model.getC1());
+  stageSnapshotDensity(frame, "c2", model.getC2());
+  stageSnapshotExternal(frame, "nhat", model.getPhi(), PHI_NORMGRAD_FIELD,
+                        2);
+  stageSnapshotVelocity(frame, "u", model.getMomentum());
+}
 
-      file << iX << ' ' << iY << ' ' << nhat.get(iX, iY)[0] << ' '
-           << nhat.get(iX, iY)[1] << std::endl;
-    }
+// Copies the fields into a free output buffer; the writer thread encodes
+// and writes them while the solver continues. Collective: the species
+// catch up on every rank, whether or not this one gets a buffer.
+template <typename T, template <typename U> class Descriptor>
+void saveSnapshot(AsyncOutputWriter &writer, DropletModel<T, Descriptor> &model,
+                  plint iT) {
+  model.catchUpSpecies();
+  if (SnapshotFrame *frame = writer.acquire(iT)) {
+    ProfileScope scope("snapshot.stage", "output");
+    stageOutput(model, *frame);
+    writer.submit(frame);
   }
 }
 
-template <typename U>
-void writeDatFile(plb_ofstream &file, ScalarField2D<U> &field) {
-  plint nx = field.getNx();
-  plint ny = field.getNy();
-
-  file << 'x' << ' ' << 'y' << ' ' << "field" << std::endl;
+// Stages the same fields as a snapshot for the live view only; skipped
+// rather than waiting when the writer has no free buffer. Collective, like
+// saveSnapshot().
+template <typename T, template <typename U> class Descriptor>
+void publishLive(AsyncOutputWriter &writer, DropletModel<T, Descriptor> &model,
+                 plint iT) {
+  model.catchUpSpecies();
+  if (SnapshotFrame *frame = writer.acquireLive(iT)) {
+    ProfileScope scope("live.stage", "output");
+    stageOutput(model, *frame);
+    writer.submit(frame);
+  }
+}
 
-  for (plint i = 0; i < nx; i++) {
-    for (plint j = 0; j < ny; j++) {
-      file << i << ' ' << j << ' ' << field.get(i, j) << std::endl;
+// Drops the rows of fileName from firstStep on, which the run being
+// restarted wrote after its checkpoint, so that the restarted run can
+// append without repeating them. Rank 0 only, like plb_ofstream.
+void truncateDiagnostics(std::string const &fileName, plint firstStep) {
+  if (global::mpi().getRank() != 0) {
+    return;
+  }
+  std::ifstream in(fileName.c_str());
+  if (!in) {
+    return;
+  }
+  std::vector<std::string> kept;
+  std::string line;
+  while (std::getline(in, line)) {
+    // the header, then rows that start with their step
+    if (kept.empty() ||
+        (!line.empty() && std::atol(line.c_str()) < firstStep)) {
+      kept.push_back(line);
     }
   }
+  in.close();
+  std::ofstream out(fileName.c_str(), std::ostream::trunc);
+  for (std::string const &row : kept) {
+    out << row << "\n";
+  }
 }
 
-// ---------------- Initialization functional ----------------
-template <typename T, template <typename U> class Descriptor>
-class InitializePhiFunctional
-    : public BoxProcessingFunctional2D_L<T, Descriptor> {
-private:
-  T r0, zeta;
-  plint cx, cy;
-
-public:
-  InitializePhiFunctional(T r0_, T zeta_, plint cx_, plint cy_)
-      : r0(r0_), zeta(zeta_), cx(cx_), cy(cy_) {}
-
-  void process(Box2D domain, BlockLattice2D<T, Descriptor> &lattice) override {
-    Array<T, 2> u(0.0, 0.0);
-
-    for (plint i = domain.x0; i <= domain.x1; ++i) {
-      for (plint j = domain.y0; j <= domain.y1; ++j) {
-        T dx = i - cx;
-        T dy = j - cy;
-        T mag = std::sqrt(dx * dx + dy * dy);
-        T arg = (2.0 / zeta) * (mag - r0);
-        if (arg > 50.0)
-          arg = 50.0;
-        T phi_val = 0.5 * (1.0 - std::tanh(arg));
-
-        phi_val = std::max(T(1e-8), std::min(phi_val, T(1.0)));
-
-        Cell<T, Descriptor> &cell = lattice.get(i, j);
-        cell.defineDensity(phi_val);
-        cell.defineVelocity(u);
-        iniCellAtEquilibrium(cell, phi_val, u);
-      }
+// Command line of a droplet run.
+struct RunOptions {
+  DropletParameters params;
+  plint maxSteps = 1000, outputEvery = 100;
+  AsyncOutputWriter::Backpressure policy =
+      AsyncOutputWriter::Backpressure::block;
+  plint checkpointEvery = 0;
+  std::string restartFile;
+  RefinementParameters refinement;
+  plint diagnosticsEvery = 10;
+  // droplets to start from instead of one at the centre
+  std::string dropletFile;
+  // from LBM_LIVE; no live view unless liveEvery > 0
+  plint liveEvery = 0;
+  std::string liveDirectory = "/dev/shm";
+  // from LBM_BALANCE; no repartitioning unless balance.every > 0
+  BalanceParameters balance;
+};
+
+// The droplet run with populations and externals stored as T.
+template <typename T> int runDroplet(RunOptions options) {
+  DropletParameters &params = options.params;
+  plint maxSteps = options.maxSteps, outputEvery = options.outputEvery;
+  AsyncOutputWriter::Backpressure policy = options.policy;
+  plint checkpointEvery = options.checkpointEvery;
+  std::string restartFile = options.restartFile;
+  RefinementParameters &refinement = options.refinement;
+  plint diagnosticsEvery = options.diagnosticsEvery;
+
+  std::unique_ptr<DropletModel<T, DESCRIPTOR>> single;
+  std::unique_ptr<RefinedDropletModel<T, DESCRIPTOR>> refined;
+  if (refinement.ratio > 1) {
+    if (options.balance.every > 0) {
+      pcout << "Load balancing is not supported with refinement, ignored."
+            << std::endl;
+    }
+    if (checkpointEvery > 0 || !restartFile.empty()) {
+      pcout << "Checkpoints are not supported with refinement, ignored."
+            << std::endl;
+      checkpointEvery = 0;
+      restartFile.clear();
+    }
+    if (!options.dropletFile.empty()) {
+      pcout << "Droplet files are not supported with refinement, ignored."
+            << std::endl;
     }
+    if (params.speciesBlocking > 1) {
+      pcout << "Species blocking is not supported with refinement, ignored."
+            << std::endl;
+    }
+    // the fine level needs the reaction split from the collision, and the
+    // interface of an unrefined run in its own cells
+    if (params.reaction == ReactionScheme::explicitSource) {
+      params.reaction = ReactionScheme::implicitEuler;
+    }
+    refinement.fineZeta = params.zeta;
+    refinement.fineM = params.M;
+    refined.reset(new RefinedDropletModel<T, DESCRIPTOR>(params, refinement));
+  } else {
+    if (params.speciesBlocking > 1 &&
+        DropletModel<T, DESCRIPTOR>::speciesBlockingDepth(params) == 1) {
+      pcout << "Species blocking needs the fused species sweep, the reaction "
+               "in the collision and no active tiles, ignored."
+            << std::endl;
+    }
+    single.reset(new DropletModel<T, DESCRIPTOR>(params));
   }
-
-  void
-  getTypeOfModification(std::vector<modif::ModifT> &modified) const override {
-    modified.push_back(modif::staticVariables); // <== Required by Palabos
+  DropletModel<T, DESCRIPTOR> &model = refined ? refined->getCoarse() : *single;
+
+  pcout << "Before initialization on " << global::mpi().getSize()
+        << " process(es) x " << params.threads << " thread(s), " << params.nx
+        << "x" << params.ny << " cells..." << std::endl;
+
+  plint firstStep = 0;
+  if (refined) {
+    refined->initialize();
+  } else if (restartFile.empty() && !options.dropletFile.empty()) {
+    std::vector<DropletSpec> droplets = readDropletFile(options.dropletFile);
+    global::timer("initialize").start();
+    model.initialize(droplets);
+    pcout << droplets.size() << " droplets from " << options.dropletFile
+          << " initialized in " << global::timer("initialize").stop()
+          << " s" << std::endl;
+  } else if (restartFile.empty()) {
+    model.initialize();
+  } else {
+    firstStep = model.restart(restartFile);
+    pcout << "Restarted from " << restartFile << " at step " << firstStep
+          << std::endl;
   }
+  std::string checkpointFile =
+      global::directories().getOutputDir() + "checkpoint.lbmc";
 
-  InitializePhiFunctional<T, Descriptor> *clone() const override {
-    return new InitializePhiFunctional<T, Descriptor>(*this);
-  }
-};
+  pcout << "After initialization." << std::endl;
+  pcout << "Center density = "
+        << model.getPhi().get(params.nx / 2, params.ny / 2).computeDensity()
+        << std::endl;
 
-// ---------------- Main program ----------------
-int main() {
-  const T OMEGA = 1.0;
-  const plint nx = 200, ny = 200;
-  const T r0 = 40.0, zeta = 2.0;
+  pcout << "Step order:";
+  for (std::string const &stage : model.getScheduler().getExecutionOrder()) {
+    pcout << " " << stage;
+  }
+  pcout << std::endl;
+
+  // declared before the writer, which publishes to it until destroyed
+  std::unique_ptr<LiveView> live;
+  if (options.liveEvery > 0) {
+    live.reset(new LiveView(
+        LiveView::fileNameFor(options.liveDirectory, global::mpi().getRank())));
+    pcout << "Live view every " << options.liveEvery << " steps in "
+          << live->getFileName() << std::endl;
+  }
+  // a repartition changes the blocks of a rank, which the live view fixes
+  // at its first frame
+  std::unique_ptr<LoadBalancer<T, DESCRIPTOR>> balancer;
+  if (!refined && options.balance.every > 0 && live) {
+    pcout << "Load balancing is not supported with the live view, ignored."
+          << std::endl;
+  } else if (!refined && options.balance.every > 0) {
+    balancer.reset(new LoadBalancer<T, DESCRIPTOR>(options.balance));
+    pcout << "Load balance checked every " << options.balance.every
+          << " steps, threshold " << options.balance.threshold << std::endl;
+  }
 
-  std::filesystem::create_directories("./data");
-  global::directories().setOutputDir("./data");
+  AsyncOutputWriter writer(global::directories().getOutputDir(), live ? 3 : 2,
+                           policy);
+  writer.setPreview("phi");
+  writer.setLiveView(live.get());
+
+  // a restarted run continues the time series of the run it restarts,
+  // from the checkpoint on
+  std::string diagnosticsFile =
+      global::directories().getOutputDir() + "diagnostics.csv";
+  if (firstStep > 0) {
+    truncateDiagnostics(diagnosticsFile, firstStep);
+  }
+  plb_ofstream diagnostics(diagnosticsFile.c_str(),
+                           firstStep > 0 ? std::ostream::app
+                                         : std::ostream::trunc);
+  if (firstStep == 0) {
+    diagnostics << DropletDiagnostics::csvHeader() << "\n";
+  }
 
-  BlockLattice2D<T, DESCRIPTOR> phi(nx, ny,
-                                    new BGKdynamics<T, DESCRIPTOR>(OMEGA));
-  ScalarField2D<T> phi_s(nx, ny);
-  TensorField2D<T, 2> nhat(nx, ny);
+  global::timer("solver").start();
+  for (plint iT = firstStep; iT < maxSteps; ++iT) {
+    if (checkpointEvery > 0 && iT > firstStep && iT % checkpointEvery == 0) {
+      global::timer("checkpoint").restart();
+      ProfileScope scope("checkpoint", "output");
+      model.saveCheckpoint(checkpointFile, iT);
+      pcout << "checkpoint at step " << iT << " in "
+            << global::timer("checkpoint").stop() << " s" << std::endl;
+    }
+    if (diagnosticsEvery > 0 && iT % diagnosticsEvery == 0) {
+      diagnostics << model.diagnose().csvRow() << "\n";
+    }
+    if (iT % outputEvery == 0) {
+      saveSnapshot(writer, model, iT);
+      pcout << "step " << iT << ", envelope exchanges so far "
+            << model.getScheduler().getNumExchanges();
+      if (ActiveTiles const *tiles = model.getActiveTiles()) {
+        pcout << ", active tiles " << tiles->getNumActive() << "/"
+              << tiles->getNumTiles();
+      }
+      if (refined) {
+        Box2D patch = refined->getPatch();
+        pcout << ", fine patch [" << patch.x0 << "," << patch.x1 << "]x["
+              << patch.y0 << "," << patch.y1 << "] after "
+              << refined->getNumRegrids() << " regrids";
+      }
+      pcout << std::endl;
+    } else if (live && iT % options.liveEvery == 0) {
+      publishLive(writer, model, iT);
+    }
+    if (refined) {
+      refined->step();
+    } else if (balancer) {
+      balancer->step(model);
+    } else {
+      model.step();
+    }
+  }
+  double solverSeconds = global::timer("solver").stop();
+  if (diagnosticsEvery > 0) {
+    diagnostics << model.diagnose().csvRow() << std::endl;
+  }
 
-  std::cout << "Before initialization..." << std::endl;
+  writer.flush();
+  if (Profiler::enabled()) {
+    std::string suffix = createFileName("_p", global::mpi().getRank(), 4);
+    Profiler::writeChromeTrace(global::directories().getOutputDir() +
+                               "trace" + suffix + ".json");
+    Profiler::printSummary(std::cout);
+  }
 
-  applyProcessingFunctional(
-      new InitializePhiFunctional<T, DESCRIPTOR>(r0, zeta, nx / 2, ny / 2),
-      phi.getBoundingBox(), phi);
+  // final state in one shared file, whatever the backpressure policy
+  model.catchUpSpecies();
+  SnapshotFrame last;
+  last.step = maxSteps;
+  stageOutput(model, last);
+  writeSnapshot(last, global::directories().getOutputDir() +
+                          createFileName("snapshot_", maxSteps, 6) + ".lbm");
+  if (refined) {
+    SnapshotFrame patch;
+    patch.step = maxSteps;
+    stageOutput(refined->getFine(), patch);
+    writeSnapshot(patch, global::directories().getOutputDir() +
+                             createFileName("patch_", maxSteps, 6) + ".lbm");
+  }
 
-  // Ensure lattice-level initialization/communication BEFORE computing
-  // densities
-  phi.initialize();
+  AsyncOutputWriter::Statistics stats = writer.getStatistics();
+  pcout << "Solver: " << solverSeconds << " s for " << maxSteps - firstStep
+        << " steps" << std::endl;
+  pcout << "Output (" << AsyncOutputWriter::policyName(policy)
+        << "): " << stats.written << " frames written, " << stats.dropped
+        << " dropped; staging " << stats.stagingSeconds << " s, blocked "
+        << stats.blockedSeconds << " s, writer busy " << stats.writeSeconds
+        << " s (max " << stats.maxWriteSeconds << " s per frame, "
+        << stats.bytesWritten / (1024. * 1024.) << " MiB on rank 0)"
+        << std::endl;
+  if (balancer) {
+    pcout << "Load balancing: " << balancer->getNumRepartitions()
+          << " repartitions in " << balancer->getRepartitionSeconds() << " s"
+          << std::endl;
+  }
+  if (live) {
+    pcout << "Live view: " << stats.livePublished << " frames published, "
+          << stats.liveSkipped << " skipped" << std::endl;
+  }
+  return 0;
+}
 
-  // compute density into multi-scalar field
-  computeDensity(phi, phi_s);
-  std::vector<AtomicBlock2D *> args;
-  args.push_back(&phi_s);
-  args.push_back(&nhat);
-  applyProcessingFunctional(new BoxNormGradientFunctional2D<T>(),
-                            phi_s.getBoundingBox(), args, 0);
+// Steps a double and a float model from the same initial state and
+// compares droplet mass, radius and the profiles through the droplet
+// centre every outputEvery steps; writes precision_validation.csv.
+int validatePrecision(RunOptions const &options) {
+  DropletModel<double, DESCRIPTOR> reference(options.params);
+  DropletModel<float, DESCRIPTOR> single(options.params);
+  reference.initialize();
+  single.initialize();
+
+  std::string fileName =
+      global::directories().getOutputDir() + "precision_validation.csv";
+  plb_ofstream csv(fileName.c_str());
+  csv << "step,mass,massFloat,massDeviation,radius,radiusFloat,"
+         "radiusDeviation,phiDeviation,c1Deviation,c2Deviation\n";
+  pcout << "Validating float against double storage for "
+        << options.maxSteps << " steps" << std::endl;
+
+  PrecisionDeviation worst;
+  for (plint iT = 0; iT <= options.maxSteps; ++iT) {
+    if (iT % options.outputEvery == 0 || iT == options.maxSteps) {
+      DropletSample a = sampleDroplet(reference);
+      DropletSample b = sampleDroplet(single);
+      PrecisionDeviation deviation = compare(a, b);
+      worst.takeMax(deviation);
+      csv << iT << "," << a.mass << "," << b.mass << "," << deviation.mass
+          << "," << a.radius << "," << b.radius << "," << deviation.radius
+          << "," << deviation.phi << "," << deviation.c1 << ","
+          << deviation.c2 << "\n";
+      pcout << "step " << iT << ": mass " << deviation.mass << ", radius "
+            << deviation.radius << " (relative); max |dphi| "
+            << deviation.phi << ", |dc1| " << deviation.c1 << ", |dc2| "
+            << deviation.c2 << std::endl;
+    }
+    if (iT < options.maxSteps) {
+      reference.step();
+      single.step();
+    }
+  }
+  pcout << "Largest deviations: mass " << worst.mass << ", radius "
+        << worst.radius << ", phi " << worst.phi << ", c1 " << worst.c1
+        << ", c2 " << worst.c2 << std::endl;
+  return 0;
+}
 
-  std::cout << "After initialization." << std::endl;
-  std::cout << "Center density = " << phi.get(nx / 2, ny / 2).computeDensity()
-            << std::endl;
+// ---------------- Main program ----------------
+// Arguments: nx ny [r0] [maxSteps outputEvery] [block|drop|coarsen]
+//            [checkpointEvery] [restart file] [refinement ratio]
+//            [diagnosticsEvery] [droplet file]
+// Every diagnosticsEvery steps (0: never) droplet mass, centroid, radius,
+// interface length, species inside and outside and the largest velocity
+// are appended to data/diagnostics.csv (see DropletDiagnostics.h).
+// A droplet file lists the initial droplets, one "x y r [c1 c2]" per line
+// (see readDropletFile()); without it one droplet of radius r0 starts at
+// the centre.
+// With a refinement ratio above 1, nx, ny and r0 are in coarse cells and the
+// interface is resolved on a fine patch that follows it, with the zeta and M
+// of an unrefined run; checkpoints are not available in that mode.
+// LBM_PROFILE=on[,sync][,counters] prints a profile of the time loop and
+// writes a Chrome trace per rank (see Profiler.h).
+// LBM_LIVE=every[,directory] publishes the snapshot fields every that many
+// steps to a memory-mapped ring in directory (default /dev/shm) that
+// python/lbm_live.py can watch during the run (see LiveView.h).
+// LBM_PRECISION selects the storage of the populations: double (default),
+// float (evaluated in double, see ComputeType), or validate, which runs
+// both without output and reports how far float drifts from double.
+// LBM_THREADS=n[,tileSize][,pin] runs each rank's share of a step on n
+// threads, in tiles of tileSize x tileSize cells (default 32), pinned to
+// the CPUs of the rank with pin (see TileExecutor.h); start one rank per
+// socket.
+// LBM_BALANCE=every[,threshold] weighs the cells of each rank every that
+// many steps and repartitions the domain when the most loaded rank exceeds
+// the mean by threshold (default 1.1; see LoadBalancer.h); not together
+// with LBM_LIVE.
+// LBM_BLOCKING=steps[,tileSize] advances the species that many steps at a
+// time in tiles of tileSize x tileSize cells (default 64) that stay in
+// cache, with an envelope of that many cells (see
+// BlockedSpeciesCollideAndStream2D); only with the fused species sweep, the
+// explicit reaction source and no active tiles.
+int main(int argc, char *argv[]) {
+  plbInit(&argc, &argv);
+  Profiler::configure();
+  Profiler::setThreadName("solver");
+
+  RunOptions options;
+  DropletParameters &params = options.params;
+  plint &maxSteps = options.maxSteps;
+  plint &outputEvery = options.outputEvery;
+  std::string backpressure = "block";
+  plint &checkpointEvery = options.checkpointEvery;
+  std::string &restartFile = options.restartFile;
+  if (global::argc() > 2) {
+    global::argv(1).read(params.nx);
+    global::argv(2).read(params.ny);
+  }
+  if (global::argc() > 3) {
+    global::argv(3).read(params.r0);
+  }
+  if (global::argc() > 5) {
+    global::argv(4).read(maxSteps);
+    global::argv(5).read(outputEvery);
+  }
+  if (global::argc() > 6) {
+    global::argv(6).read(backpressure);
+  }
+  if (global::argc() > 7) {
+    global::argv(7).read(checkpointEvery);
+  }
+  if (global::argc() > 8) {
+    global::argv(8).read(restartFile);
+  }
+  RefinementParameters &refinement = options.refinement;
+  refinement.ratio = 1;
+  if (global::argc() > 9) {
+    global::argv(9).read(refinement.ratio);
+  }
+  if (global::argc() > 10) {
+    global::argv(10).read(options.diagnosticsEvery);
+  }
+  if (global::argc() > 11) {
+    global::argv(11).read(options.dropletFile);
+  }
+  if (backpressure == "drop") {
+    options.policy = AsyncOutputWriter::Backpressure::drop;
+  } else if (backpressure == "coarsen") {
+    options.policy = AsyncOutputWriter::Backpressure::coarsen;
+  }
 
-  ImageWriter<T> imageWriter("leeloo");
-  imageWriter.writeScaledPpm("phi_field", *computeDensity(phi));
+  if (char const *setting = std::getenv("LBM_LIVE")) {
+    std::stringstream live(setting);
+    std::string every;
+    std::getline(live, every, ',');
+    options.liveEvery = std::atol(every.c_str());
+    std::getline(live, options.liveDirectory);
+    if (options.liveDirectory.empty()) {
+      options.liveDirectory = "/dev/shm";
+    }
+  }
 
-  plb_ofstream file("../data/data_phi_field.dat");
-  writeDatFile(file, *computeDensity(phi));
+  if (char const *setting = std::getenv("LBM_THREADS")) {
+    std::stringstream threads(setting);
+    std::string item;
+    std::getline(threads, item, ',');
+    params.threads = (unsigned)std::max(1L, std::atol(item.c_str()));
+    while (std::getline(threads, item, ',')) {
+      if (item == "pin") {
+        params.pinThreads = true;
+      } else if (std::atol(item.c_str()) > 0) {
+        params.threadTileSize = std::atol(item.c_str());
+      }
+    }
+  }
 
-  plb_ofstream file2("../data/nhat_field.dat");
+  if (char const *setting = std::getenv("LBM_BALANCE")) {
+    std::stringstream balance(setting);
+    std::string item;
+    std::getline(balance, item, ',');
+    options.balance.every = std::atol(item.c_str());
+    if (std::getline(balance, item, ',')) {
+      options.balance.threshold = std::atof(item.c_str());
+    }
+  }
 
-  writeField(file2, nhat);
+  if (char const *setting = std::getenv("LBM_BLOCKING")) {
+    std::stringstream blocking(setting);
+    std::string item;
+    std::getline(blocking, item, ',');
+    params.speciesBlocking = std::max(1L, std::atol(item.c_str()));
+    if (std::getline(blocking, item, ',') && std::atol(item.c_str()) > 0) {
+      params.speciesBlockingTile = std::atol(item.c_str());
+    }
+  }
 
-  //   for (plint i = 0; i < nx; i++) {
-  //     for (plint j = 0; j < ny; j++) {
-  //       file << i << ' ' << j << ' ' << phi.get(i, j).computeDensity()
-  //            << std::endl;
-  //     }
-  //   }
-  file2.close();
+  std::filesystem::create_directories("./data");
+  global::directories().setOutputDir("./data");
 
-  file.close();
-  return 0;
+  char const *precision = std::getenv("LBM_PRECISION");
+  if (precision && std::strcmp(precision, "validate") == 0) {
+    return validatePrecision(options);
+  }
+  if (precision && std::strcmp(precision, "float") == 0) {
+    pcout << "Populations stored in single precision." << std::endl;
+    return runDroplet<float>(options);
+  }
+  return runDroplet<double>(options);
 }
@@ -0,0 +1,129 @@
+#include "palabos3D.h"
+#include "palabos3D.hh"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "DropletModel3D.h"
+#include "Profiler.h"
+
+using namespace plb;
+
+// Droplet volume (cells with phi summed) and the radius of a sphere of
+// that volume.
+template <typename T, template <typename U> class Descriptor>
+void printDroplet(DropletModel3D<T, Descriptor> &model, plint iT) {
+  MultiBlockLattice3D<T, Descriptor> &phi = model.getPhi();
+  Box3D domain = phi.getBoundingBox();
+  double volume = (double)computeAverageDensity(phi, domain) *
+                  (double)domain.nCells();
+  double radius = std::cbrt(3. * volume / (4. * M_PI));
+  pcout << "step " << iT << ": droplet volume " << volume << ", radius "
+        << radius << ", envelope exchanges so far "
+        << model.getScheduler().getNumExchanges() << std::endl;
+}
+
+// phi, c1, c2 and the flow velocity in one VTK image file.
+template <typename T, template <typename U> class Descriptor>
+void writeVtk(DropletModel3D<T, Descriptor> &model, plint iT) {
+  ProfileScope scope("vtk", "output");
+  VtkImageOutput3D<T> vtk(createFileName("droplet3d_", iT, 6), 1.);
+  vtk.writeData<float>(*computeDensity(model.getPhi()), "phi", 1.);
+  vtk.writeData<float>(*computeDensity(model.getC1()), "c1", 1.);
+  vtk.writeData<float>(*computeDensity(model.getC2()), "c2", 1.);
+  vtk.writeData<3, float>(*computeVelocity(model.getMomentum()), "u", 1.);
+}
+
+template <typename T, template <typename U> class Descriptor>
+int runDroplet3D(DropletParameters3D const &params, plint maxSteps,
+                 plint outputEvery) {
+  DropletModel3D<T, Descriptor> model(params);
+  pcout << "Before initialization on " << global::mpi().getSize()
+        << " process(es), " << params.nx << "x" << params.ny << "x"
+        << params.nz << " cells, D3Q" << Descriptor<T>::q << "..."
+        << std::endl;
+  model.initialize();
+
+  pcout << "Step order:";
+  for (std::string const &stage : model.getScheduler().getExecutionOrder()) {
+    pcout << " " << stage;
+  }
+  pcout << std::endl;
+
+  global::timer("solver").start();
+  for (plint iT = 0; iT < maxSteps; ++iT) {
+    if (iT % outputEvery == 0) {
+      printDroplet(model, iT);
+      writeVtk(model, iT);
+    }
+    model.step();
+  }
+  double solverSeconds = global::timer("solver").stop();
+  printDroplet(model, maxSteps);
+  writeVtk(model, maxSteps);
+
+  if (Profiler::enabled()) {
+    std::string suffix = createFileName("_p", global::mpi().getRank(), 4);
+    Profiler::writeChromeTrace(global::directories().getOutputDir() +
+                               "trace3d" + suffix + ".json");
+    Profiler::printSummary(std::cout);
+  }
+  double cellSteps =
+      (double)(params.nx * params.ny * params.nz) * (double)maxSteps;
+  pcout << "Solver: " << solverSeconds << " s for " << maxSteps << " steps ("
+        << cellSteps / solverSeconds / 1e6 << " MLUPS)" << std::endl;
+  return 0;
+}
+
+template <typename T>
+int runLattice(DropletParameters3D const &params, plint maxSteps,
+               plint outputEvery) {
+  char const *lattice = std::getenv("LBM_LATTICE");
+  if (lattice && std::strcmp(lattice, "d3q27") == 0) {
+    return runDroplet3D<T, descriptors::PhaseFieldD3Q27Descriptor>(
+        params, maxSteps, outputEvery);
+  }
+  return runDroplet3D<T, descriptors::PhaseFieldD3Q19Descriptor>(
+      params, maxSteps, outputEvery);
+}
+
+// ---------------- 3D program ----------------
+// Arguments: nx ny nz [r0] [maxSteps outputEvery]
+// The coupled droplet model of main.cpp on a 3D lattice, with a VTK image
+// of phi, c1, c2 and u every outputEvery steps in ./data.
+// LBM_LATTICE selects the velocity set: d3q19 (default) or d3q27.
+// LBM_PRECISION=float stores the populations in single precision.
+// LBM_PROFILE as in main.cpp.
+int main(int argc, char *argv[]) {
+  plbInit(&argc, &argv);
+  Profiler::configure();
+  Profiler::setThreadName("solver");
+
+  DropletParameters3D params;
+  plint maxSteps = 1000, outputEvery = 100;
+  if (global::argc() > 3) {
+    global::argv(1).read(params.nx);
+    global::argv(2).read(params.ny);
+    global::argv(3).read(params.nz);
+  }
+  if (global::argc() > 4) {
+    global::argv(4).read(params.r0);
+  }
+  if (global::argc() > 6) {
+    global::argv(5).read(maxSteps);
+    global::argv(6).read(outputEvery);
+  }
+
+  std::filesystem::create_directories("./data");
+  global::directories().setOutputDir("./data/");
+
+  char const *precision = std::getenv("LBM_PRECISION");
+  if (precision && std::strcmp(precision, "float") == 0) {
+    pcout << "Populations stored in single precision." << std::endl;
+    return runLattice<float>(params, maxSteps, outputEvery);
+  }
+  return runLattice<double>(params, maxSteps, outputEvery);
+}
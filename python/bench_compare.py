@@ -0,0 +1,62 @@
+"""Compare two lbm_bench result sets and flag slowdowns.
+
+    python bench_compare.py base new [--threshold 0.05]
+
+base and new are JSON files written by lbm_bench or directories of them
+(bench/run_bench.sh writes one per rank count). Results are matched on
+(name, nx, ny, ranks); a result whose MLUPS dropped by more than the
+threshold is a regression, and the exit status is 1 if there is any.
+"""
+
+import argparse
+import glob
+import json
+import os
+import sys
+
+
+def load(path):
+    """Results of a file or of every *.json file in a directory."""
+    files = sorted(glob.glob(os.path.join(path, "*.json"))) \
+        if os.path.isdir(path) else [path]
+    results = {}
+    for name in files:
+        with open(name) as f:
+            for r in json.load(f)["results"]:
+                results[(r["name"], r["nx"], r["ny"], r["ranks"])] = r
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("base")
+    parser.add_argument("new")
+    parser.add_argument("--threshold", type=float, default=0.05,
+                        help="relative MLUPS loss counted as a regression")
+    args = parser.parse_args()
+
+    base = load(args.base)
+    new = load(args.new)
+    regressions = 0
+    print(f"{'kernel':32} {'size':>11} {'ranks':>5} {'base':>10} "
+          f"{'new':>10} {'change':>8}")
+    for key in sorted(base.keys() & new.keys()):
+        name, nx, ny, ranks = key
+        old, cur = base[key]["mlups"], new[key]["mlups"]
+        change = cur / old - 1.0
+        flag = ""
+        if change < -args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:32} {f'{nx}x{ny}':>11} {ranks:>5} {old:10.2f} "
+              f"{cur:10.2f} {change:+8.1%}{flag}")
+    for key in sorted(base.keys() ^ new.keys()):
+        side = "base" if key in base else "new"
+        print(f"only in {side}: {key[0]} {key[1]}x{key[2]} on {key[3]} rank(s)")
+
+    print(f"{regressions} regression(s) beyond {args.threshold:.0%}")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
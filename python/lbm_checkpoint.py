@@ -0,0 +1,65 @@
+"""Memory-mapped access to the .lbmc checkpoints written by Checkpoint.h.
+
+    from lbm_checkpoint import open_checkpoint
+    ckpt = open_checkpoint("data/checkpoint.lbmc")
+    f_phi = ckpt["lattices"]["phi"][:, :, :9]   # stored populations f_i - t_i
+    ext = ckpt["lattices"]["phi"][:, :, 9:]     # external scalars
+
+Nothing is read until an array is indexed.
+"""
+
+import struct
+
+import numpy as np
+
+_MAGIC = b"LBMCKPT\0"
+_ALIGNMENT = 4096
+_DTYPES = {4: np.dtype("<f4"), 8: np.dtype("<f8")}
+
+
+def _align(offset):
+    return (offset + _ALIGNMENT - 1) // _ALIGNMENT * _ALIGNMENT
+
+
+def read_header(path):
+    with open(path, "rb") as f:
+        head = f.read(16)
+        if head[:8] != _MAGIC:
+            raise ValueError(f"{path} is not a checkpoint file")
+        version, size = struct.unpack_from("<II", head, 8)
+        if version != 1:
+            raise ValueError(f"unsupported checkpoint version {version}")
+        buf = head + f.read(size - 16)
+    nx, ny, step = struct.unpack_from("<qqq", buf, 16)
+    num_lattices, q, num_scalars, value_bytes = struct.unpack_from("<IIII", buf, 40)
+    pos = 56
+    names = []
+    for _ in range(num_lattices):
+        (length,) = struct.unpack_from("<H", buf, pos)
+        names.append(buf[pos + 2 : pos + 2 + length].decode())
+        pos += 2 + length
+    return {
+        "nx": nx,
+        "ny": ny,
+        "step": step,
+        "q": q,
+        "num_scalars": num_scalars,
+        "dtype": _DTYPES[value_bytes],
+        "lattices": names,
+        "size": size,
+    }
+
+
+def open_checkpoint(path):
+    header = read_header(path)
+    cell = header["q"] + header["num_scalars"]
+    shape = (header["nx"], header["ny"], cell)
+    lattice_bytes = header["nx"] * header["ny"] * cell * header["dtype"].itemsize
+    offset = _align(header["size"])
+    lattices = {}
+    for name in header["lattices"]:
+        lattices[name] = np.memmap(
+            path, dtype=header["dtype"], mode="r", offset=offset, shape=shape
+        )
+        offset += _align(lattice_bytes)
+    return {"header": header, "lattices": lattices}
@@ -0,0 +1,216 @@
+"""Client for the live views published by LiveView (see include/LiveView.h).
+
+Start the solver with LBM_LIVE=every[,directory], e.g.
+
+    LBM_LIVE=10 mpirun -np 2 ./example 400 400
+
+and watch it from a notebook while it runs:
+
+    import sys; sys.path.append("python")
+    from lbm_live import LiveView
+    live = LiveView.open_all("/dev/shm")    # every live_p*.lbmlive
+    frame = live.latest()
+    plt.imshow(frame["phi"].T, origin="lower")
+
+The files are mapped read-only: reading never blocks or slows the solver.
+A frame read while the solver overwrites its slot is detected by the
+slot's sequence counter and read again.
+"""
+
+import glob
+import os
+import struct
+import time
+
+import numpy as np
+
+_MAGIC = b"LBMLIVE\0"
+_PUBLISHED = 64
+_FIELD_RECORD = 24
+_BLOCK_RECORD = 32
+_SLOT_HEADER = 64
+_NAME_LENGTH = 16
+
+
+class TornFrame(Exception):
+    """The slot was reused while it was being read."""
+
+
+class LiveRank:
+    """The ring of frames of one process."""
+
+    def __init__(self, path):
+        self.path = path
+        self._map = None
+
+    def _layout(self):
+        if self._map is not None:
+            return True
+        if os.path.getsize(self.path) < _PUBLISHED + 8:
+            return False
+        buf = np.memmap(self.path, dtype=np.uint8, mode="r")
+        if bytes(buf[:8]) != _MAGIC:
+            return False
+        version, header_size = struct.unpack_from("<II", buf, 8)
+        self.nx, self.ny = struct.unpack_from("<qq", buf, 16)
+        num_fields, num_blocks, self.num_slots = struct.unpack_from(
+            "<III", buf, 32)
+        self.slot_size, self.data_offset = struct.unpack_from("<QQ", buf, 48)
+        pos = _PUBLISHED + 8
+        self.fields = []
+        for _ in range(num_fields):
+            name = bytes(buf[pos:pos + _NAME_LENGTH]).rstrip(b"\0").decode()
+            (components,) = struct.unpack_from("<I", buf, pos + _NAME_LENGTH)
+            self.fields.append((name, components))
+            pos += _FIELD_RECORD
+        self.blocks = []
+        for _ in range(num_blocks):
+            self.blocks.append(struct.unpack_from("<qqqq", buf, pos))
+            pos += _BLOCK_RECORD
+        assert pos == header_size
+        self._map = buf
+        self._words = buf[:self.data_offset + self.num_slots *
+                          self.slot_size].view(np.uint64)
+        return True
+
+    def published(self):
+        """Number of frames published so far (0 before the first one)."""
+        if not self._layout():
+            return 0
+        return int(self._words[_PUBLISHED // 8])
+
+    def _sequence(self, slot):
+        return int(self._words[(self.data_offset + slot * self.slot_size) //
+                               8])
+
+    def frames(self):
+        """{step: n} of the frames in the ring that are not being
+        overwritten."""
+        latest = self.published()
+        frames = {}
+        if latest == 0:
+            return frames
+        for n in range(max(1, latest - self.num_slots + 1), latest + 1):
+            slot = (n - 1) % self.num_slots
+            if self._sequence(slot) != 2 * n:
+                continue
+            base = self.data_offset + slot * self.slot_size
+            (step,) = struct.unpack_from("<q", self._map, base + 8)
+            if self._sequence(slot) == 2 * n:
+                frames[step] = n
+        return frames
+
+    def view(self, n=None):
+        """Frame n (default: the latest) as views into the mapped file.
+
+        Returns (step, {field: [(x0, x1, y0, y1, array), ...]}, check);
+        nothing is copied, so the arrays change when the solver reuses the
+        slot. check() raises TornFrame if that happened since view() was
+        called; call it after using the arrays.
+        """
+        latest = self.published()
+        if latest == 0:
+            raise LookupError("%s: nothing published yet" % self.path)
+        n = latest if n is None else n
+        if n < 1 or n <= latest - self.num_slots or n > latest:
+            raise LookupError("%s: frame %d is not in the ring" %
+                              (self.path, n))
+        slot = (n - 1) % self.num_slots
+        if self._sequence(slot) != 2 * n:
+            raise TornFrame("%s: frame %d is being overwritten" %
+                            (self.path, n))
+        base = self.data_offset + slot * self.slot_size
+        (step,) = struct.unpack_from("<q", self._map, base + 8)
+        values = self._map[base + _SLOT_HEADER:base +
+                           self.slot_size].view(np.float32)
+        pos = 0
+        fields = {}
+        for name, components in self.fields:
+            fields[name] = []
+            for x0, x1, y0, y1 in self.blocks:
+                shape = (x1 - x0 + 1, y1 - y0 + 1, components)
+                count = shape[0] * shape[1] * components
+                array = values[pos:pos + count].reshape(shape)
+                if components == 1:
+                    array = array[:, :, 0]
+                fields[name].append((x0, x1, y0, y1, array))
+                pos += count
+
+        def check():
+            if self._sequence(slot) != 2 * n:
+                raise TornFrame("%s: frame %d was overwritten" %
+                                (self.path, n))
+
+        return step, fields, check
+
+
+class LiveView:
+    """The live views of all processes of a run, assembled per frame."""
+
+    def __init__(self, paths):
+        self.ranks = [LiveRank(path) for path in sorted(paths)]
+        if not self.ranks:
+            raise FileNotFoundError("no live view files")
+
+    @classmethod
+    def open_all(cls, directory="/dev/shm"):
+        return cls(glob.glob(os.path.join(directory, "live_p*.lbmlive")))
+
+    def published(self):
+        """Frames published by the slowest process."""
+        return min(rank.published() for rank in self.ranks)
+
+    def _common(self):
+        """{step: [n of each process]} of the steps that every process
+        still has in its ring. A process that is busy skips frames on its
+        own, so the same step can have a different n on each."""
+        frames = [rank.frames() for rank in self.ranks]
+        steps = set(frames[0]).intersection(*frames[1:])
+        return {step: [f[step] for f in frames] for step in steps}
+
+    def latest(self, retries=100):
+        """Copy of the newest frame that every process has published:
+        {"step": step, field: array of shape (nx, ny[, components])}.
+        """
+        for _ in range(retries):
+            common = self._common()
+            if not common:
+                time.sleep(0.01)
+                continue
+            step = max(common)
+            try:
+                return self._assemble(common[step])
+            except TornFrame:
+                continue
+        raise TornFrame("no complete frame after %d attempts" % retries)
+
+    def watch(self, interval=0.1):
+        """Yields every new frame; frames overwritten before they could be
+        read are skipped."""
+        last = None
+        while True:
+            common = self._common()
+            step = max(common) if common else None
+            if step is not None and (last is None or step > last):
+                try:
+                    frame = self._assemble(common[step])
+                except TornFrame:
+                    continue
+                last = step
+                yield frame
+            else:
+                time.sleep(interval)
+
+    def _assemble(self, numbers):
+        frame = {}
+        for rank, n in zip(self.ranks, numbers):
+            step, fields, check = rank.view(n)
+            for name, blocks in fields.items():
+                for x0, x1, y0, y1, array in blocks:
+                    if name not in frame:
+                        shape = (rank.nx, rank.ny) + array.shape[2:]
+                        frame[name] = np.full(shape, np.nan, np.float32)
+                    frame[name][x0:x1 + 1, y0:y1 + 1] = array
+            check()
+            frame["step"] = step
+        return frame
@@ -0,0 +1,135 @@
+"""Reader for the .lbm snapshots written by SnapshotIO (see include/SnapshotIO.h).
+
+Usage in nb.ipynb:
+
+    import sys; sys.path.append("python")
+    from lbm_snapshot import read_snapshot
+    snap = read_snapshot("data/snapshot_000100.lbm")
+    plt.imshow(snap["fields"]["phi"].T, origin="lower")
+
+Per-process files written by writeSnapshotLocal() (the asynchronous writer
+produces snapshot_<step>_p<rank>.lbm) can be passed as a list;
+their blocks are assembled into one global array per field.
+"""
+
+import struct
+
+import numpy as np
+
+_MAGIC = b"LBMSNAP\0"
+_DTYPES = {0: np.dtype("<f8"), 1: np.dtype("<f4")}
+_WORDS = {0: np.dtype("<u8"), 1: np.dtype("<u4")}
+
+
+def _read_varint(buf, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = buf[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, pos
+        shift += 7
+
+
+def _decode_xor_delta_rle(buf, count, dtype_code):
+    word = _WORDS[dtype_code]
+    deltas = np.zeros(count, dtype=word)
+    pos = 0
+    filled = 0
+    while filled < count:
+        zeros, pos = _read_varint(buf, pos)
+        literals, pos = _read_varint(buf, pos)
+        filled += zeros
+        nbytes = literals * word.itemsize
+        deltas[filled:filled + literals] = np.frombuffer(
+            buf, dtype=word, count=literals, offset=pos)
+        pos += nbytes
+        filled += literals
+    words = np.bitwise_xor.accumulate(deltas)
+    return words.view(_DTYPES[dtype_code])
+
+
+def _decode(buf, count, dtype_code, codec):
+    if codec == 0:
+        return np.frombuffer(buf, dtype=_DTYPES[dtype_code], count=count)
+    if codec == 1:
+        return _decode_xor_delta_rle(buf, count, dtype_code)
+    raise ValueError("unknown snapshot codec %d" % codec)
+
+
+def read_header(buf):
+    if buf[:8] != _MAGIC:
+        raise ValueError("not an LBM snapshot")
+    version, header_size = struct.unpack_from("<II", buf, 8)
+    nx, ny, step = struct.unpack_from("<qqq", buf, 16)
+    num_fields, num_blocks = struct.unpack_from("<II", buf, 40)
+    dtype_code, codec = struct.unpack_from("<BB", buf, 48)
+    pos = 50
+    fields = []
+    for _ in range(num_fields):
+        (length,) = struct.unpack_from("<H", buf, pos)
+        pos += 2
+        name = bytes(buf[pos:pos + length]).decode()
+        pos += length
+        (components,) = struct.unpack_from("<B", buf, pos)
+        pos += 1
+        fields.append((name, components))
+    assert pos == header_size
+    return dict(version=version, header_size=header_size, nx=nx, ny=ny,
+                step=step, fields=fields, num_blocks=num_blocks,
+                dtype=dtype_code, codec=codec)
+
+
+def read_snapshot(paths):
+    """Return {"nx", "ny", "step", "fields": {name: array}}.
+
+    Arrays have shape (nx, ny) for scalars and (nx, ny, n) for n components.
+    Raises ValueError when the files are of different steps or domains, or
+    their blocks do not cover the domain, e.g. a per-process file is missing.
+    """
+    if isinstance(paths, str):
+        paths = [paths]
+    result = None
+    covered = None
+    for path in paths:
+        with open(path, "rb") as f:
+            buf = memoryview(f.read())
+        header = read_header(buf)
+        if result is None:
+            result = dict(nx=header["nx"], ny=header["ny"],
+                          step=header["step"], fields={})
+            for name, components in header["fields"]:
+                shape = (header["nx"], header["ny"])
+                if components > 1:
+                    shape += (components,)
+                result["fields"][name] = np.zeros(shape)
+            covered = np.zeros((header["nx"], header["ny"]), dtype=bool)
+        for key in ("step", "nx", "ny"):
+            if header[key] != result[key]:
+                raise ValueError("%s has %s %d, %s has %d"
+                                 % (path, key, header[key], paths[0],
+                                    result[key]))
+        pos = header["header_size"]
+        for _ in range(header["num_blocks"]):
+            x0, x1, y0, y1 = struct.unpack_from("<qqqq", buf, pos)
+            pos += 32
+            cells = (x1 - x0 + 1) * (y1 - y0 + 1)
+            for name, components in header["fields"]:
+                (size,) = struct.unpack_from("<Q", buf, pos)
+                pos += 8
+                values = _decode(buf[pos:pos + size], cells * components,
+                                 header["dtype"], header["codec"])
+                pos += size
+                shape = (x1 - x0 + 1, y1 - y0 + 1)
+                if components > 1:
+                    shape += (components,)
+                result["fields"][name][x0:x1 + 1, y0:y1 + 1] = \
+                    values.reshape(shape)
+            covered[x0:x1 + 1, y0:y1 + 1] = True
+    if not covered.all():
+        raise ValueError("blocks of step %d cover %d of %d x %d cells"
+                         % (result["step"], covered.sum(), result["nx"],
+                            result["ny"]))
+    return result
@@ -0,0 +1,41 @@
+#include "ActiveTiles.h"
+
+ActiveTiles::ActiveTiles(Box2D domain, plint tileSize, bool combineRanks)
+    : domain_(domain), tileSize_(tileSize), combineRanks_(combineRanks),
+      numTilesX_((domain.getNx() + tileSize - 1) / tileSize),
+      numTilesY_((domain.getNy() + tileSize - 1) / tileSize),
+      busy_(numTilesX_ * numTilesY_, 0), active_(numTilesX_ * numTilesY_, 1),
+      numActive_(numTilesX_ * numTilesY_) {
+  PLB_PRECONDITION(tileSize >= 1);
+}
+
+void ActiveTiles::beginUpdate() { std::fill(busy_.begin(), busy_.end(), 0); }
+
+void ActiveTiles::finishUpdate() {
+#ifdef PLB_MPI_PARALLEL
+  if (combineRanks_) {
+    MPI_Allreduce(MPI_IN_PLACE, busy_.data(), (int)busy_.size(), MPI_INT,
+                  MPI_MAX, global::mpi().getGlobalCommunicator());
+  }
+#endif
+  numActive_ = 0;
+  for (plint tx = 0; tx < numTilesX_; ++tx) {
+    for (plint ty = 0; ty < numTilesY_; ++ty) {
+      bool active = false;
+      for (plint nx = std::max(tx - 1, (plint)0);
+           !active && nx <= std::min(tx + 1, numTilesX_ - 1); ++nx) {
+        for (plint ny = std::max(ty - 1, (plint)0);
+             !active && ny <= std::min(ty + 1, numTilesY_ - 1); ++ny) {
+          active = busy_[nx * numTilesY_ + ny] != 0;
+        }
+      }
+      active_[tx * numTilesY_ + ty] = active;
+      numActive_ += active;
+    }
+  }
+}
+
+void ActiveTiles::activateAll() {
+  std::fill(active_.begin(), active_.end(), 1);
+  numActive_ = getNumTiles();
+}
@@ -0,0 +1,315 @@
+#include "AsyncOutputWriter.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       begin)
+      .count();
+}
+
+// Whether flag holds on every process. Collective.
+bool onAllRanks(bool flag) {
+  int value = flag ? 1 : 0;
+#ifdef PLB_MPI_PARALLEL
+  MPI_Allreduce(MPI_IN_PLACE, &value, 1, MPI_INT, MPI_MIN,
+                global::mpi().getGlobalCommunicator());
+#endif
+  return value != 0;
+}
+
+} // namespace
+
+AsyncOutputWriter::AsyncOutputWriter(std::string const &prefix,
+                                     plint numBuffers, Backpressure policy,
+                                     SnapshotOptions const &options)
+    : prefix_(prefix), policy_(policy), options_(options),
+      rank_(global::mpi().getRank()), buffers_(numBuffers) {
+  PLB_ASSERT(numBuffers > 0);
+  for (SnapshotFrame &frame : buffers_) {
+    free_.push_back(&frame);
+  }
+  worker_ = std::thread(&AsyncOutputWriter::run, this);
+}
+
+AsyncOutputWriter::~AsyncOutputWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  queued_.notify_all();
+  worker_.join();
+}
+
+void AsyncOutputWriter::setPreview(std::string const &fieldName) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  preview_ = fieldName;
+}
+
+void AsyncOutputWriter::setLiveView(LiveView *view) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  live_ = view;
+}
+
+SnapshotFrame *AsyncOutputWriter::acquire(plint iT) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  rethrowWriterError();
+
+  // offered_ and the interval only change here, the same way on every
+  // process, so every process skips the same offers
+  plint offer = offered_++;
+  if (policy_ == Backpressure::coarsen && offer % stats_.interval != 0) {
+    return nullptr;
+  }
+  if (policy_ == Backpressure::block) {
+    if (free_.empty()) {
+      Clock::time_point begin = Clock::now();
+      released_.wait(lock, [this]() { return !free_.empty() || error_; });
+      stats_.blockedSeconds += secondsSince(begin);
+      rethrowWriterError();
+    }
+  } else {
+    // Only the writer thread frees buffers and only this thread takes them,
+    // so a buffer free before the reduction is still free after it.
+    bool available = !free_.empty();
+    bool drained = drained_ >= drainedToRefine;
+    lock.unlock();
+    available = onAllRanks(available);
+    drained = policy_ == Backpressure::coarsen && onAllRanks(drained);
+    lock.lock();
+    if (!available) {
+      ++stats_.dropped;
+      if (policy_ == Backpressure::coarsen) {
+        stats_.interval *= 2;
+        offered_ = 1;
+        drained_ = 0;
+      }
+      return nullptr;
+    }
+    if (drained && stats_.interval > 1) {
+      stats_.interval /= 2;
+      drained_ = 0;
+    }
+  }
+
+  SnapshotFrame *frame = free_.back();
+  free_.pop_back();
+  stagingPersist_ = true;
+  lock.unlock();
+
+  frame->recycle();
+  frame->step = iT;
+  stagingBegin_ = Clock::now();
+  return frame;
+}
+
+SnapshotFrame *AsyncOutputWriter::acquireLive(plint iT) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  rethrowWriterError();
+  if (!live_) {
+    return nullptr;
+  }
+  bool available = !free_.empty();
+  lock.unlock();
+  available = onAllRanks(available);
+  lock.lock();
+  if (!available) {
+    ++stats_.liveSkipped;
+    return nullptr;
+  }
+
+  SnapshotFrame *frame = free_.back();
+  free_.pop_back();
+  stagingPersist_ = false;
+  lock.unlock();
+
+  frame->recycle();
+  frame->step = iT;
+  stagingBegin_ = Clock::now();
+  return frame;
+}
+
+void AsyncOutputWriter::submit(SnapshotFrame *frame) {
+  PLB_PRECONDITION(frame);
+  double staging = secondsSince(stagingBegin_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.stagingSeconds += staging;
+    if (stagingPersist_) {
+      ++stats_.submitted;
+    }
+    queue_.push_back(Job{frame, stagingPersist_});
+  }
+  queued_.notify_one();
+}
+
+void AsyncOutputWriter::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  released_.wait(lock, [this]() { return queue_.empty() && !writing_; });
+  rethrowWriterError();
+}
+
+AsyncOutputWriter::Statistics AsyncOutputWriter::getStatistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+std::string AsyncOutputWriter::policyName(Backpressure policy) {
+  switch (policy) {
+  case Backpressure::block:
+    return "block";
+  case Backpressure::drop:
+    return "drop";
+  case Backpressure::coarsen:
+    return "coarsen";
+  }
+  return "unknown";
+}
+
+// Called with mutex_ held.
+void AsyncOutputWriter::rethrowWriterError() {
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void AsyncOutputWriter::run() {
+  Profiler::setThreadName("output writer");
+  while (true) {
+    Job job = {nullptr, true};
+    std::string preview;
+    LiveView *live = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queued_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      job = queue_.front();
+      queue_.pop_front();
+      preview = preview_;
+      live = live_;
+      writing_ = true;
+    }
+
+    // a failed publish must not cost the frame its write to disk
+    std::exception_ptr liveError;
+    if (live) {
+      try {
+        ProfileScope scope("live.publish", "output");
+        live->publish(*job.frame);
+      } catch (...) {
+        liveError = std::current_exception();
+      }
+    }
+
+    Clock::time_point begin = Clock::now();
+    double bytes = 0;
+    std::exception_ptr writeError;
+    if (job.persist) {
+      try {
+        ProfileScope scope("snapshot.write", "output");
+        writeFrame(*job.frame, preview, bytes);
+      } catch (...) {
+        writeError = std::current_exception();
+      }
+    }
+    double seconds = secondsSince(begin);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (writeError) {
+        error_ = writeError;
+      } else if (liveError) {
+        error_ = liveError;
+      }
+      stats_.written += job.persist && !writeError ? 1 : 0;
+      stats_.livePublished += live && !liveError ? 1 : 0;
+      if (job.persist) {
+        stats_.writeSeconds += seconds;
+        stats_.maxWriteSeconds = std::max(stats_.maxWriteSeconds, seconds);
+        stats_.bytesWritten += bytes;
+      }
+      drained_ = queue_.empty() ? drained_ + 1 : 0;
+      free_.push_back(job.frame);
+      writing_ = false;
+    }
+    released_.notify_all();
+  }
+}
+
+void AsyncOutputWriter::writeFrame(SnapshotFrame const &frame,
+                                   std::string const &preview,
+                                   double &bytes) const {
+  std::string suffix = createFileName("_p", rank_, 4);
+  std::string fileName =
+      prefix_ + createFileName("snapshot_", frame.step, 6) + suffix + ".lbm";
+  writeSnapshotLocal(frame, fileName, options_);
+  bytes = (double)std::filesystem::file_size(fileName);
+  if (!preview.empty()) {
+    writePreview(frame, preview);
+  }
+}
+
+// Binary PGM of one scalar field over the bounding box of the local blocks,
+// scaled to its own range.
+void AsyncOutputWriter::writePreview(SnapshotFrame const &frame,
+                                     std::string const &fieldName) const {
+  plint iField = -1;
+  for (pluint i = 0; i < frame.fields.size(); ++i) {
+    if (frame.fields[i].name == fieldName) {
+      iField = (plint)i;
+    }
+  }
+  if (iField < 0 || frame.blocks.empty()) {
+    return;
+  }
+  if (frame.fields[iField].numComponents != 1) {
+    throw PlbIOException("Preview field " + fieldName + " is not a scalar");
+  }
+
+  Box2D box = frame.blocks[0].bulk;
+  double minValue = std::numeric_limits<double>::max();
+  double maxValue = std::numeric_limits<double>::lowest();
+  for (SnapshotBlock const &block : frame.blocks) {
+    box = bound(box, block.bulk);
+    for (double value : block.values[iField]) {
+      minValue = std::min(minValue, value);
+      maxValue = std::max(maxValue, value);
+    }
+  }
+  double scale = maxValue > minValue ? 255. / (maxValue - minValue) : 0.;
+
+  plint width = box.getNx(), height = box.getNy();
+  std::vector<unsigned char> pixels(width * height, 0);
+  for (SnapshotBlock const &block : frame.blocks) {
+    std::vector<double> const &values = block.values[iField];
+    pluint pos = 0;
+    for (plint iX = block.bulk.x0; iX <= block.bulk.x1; ++iX) {
+      for (plint iY = block.bulk.y0; iY <= block.bulk.y1; ++iY) {
+        // first image row is the top of the domain
+        plint row = box.y1 - iY;
+        plint col = iX - box.x0;
+        pixels[row * width + col] =
+            (unsigned char)((values[pos++] - minValue) * scale + 0.5);
+      }
+    }
+  }
+
+  std::string fileName = prefix_ +
+                         createFileName("preview_", frame.step, 6) +
+                         createFileName("_p", rank_, 4) + ".pgm";
+  std::ofstream ofile(fileName.c_str(), std::ios::binary);
+  if (!ofile) {
+    throw PlbIOException("Could not open preview file " + fileName);
+  }
+  ofile << "P5\n" << width << " " << height << "\n255\n";
+  ofile.write(reinterpret_cast<char const *>(pixels.data()), pixels.size());
+}
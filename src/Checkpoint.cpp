@@ -0,0 +1,309 @@
+#include "Checkpoint.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#ifndef PLB_MPI_PARALLEL
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char checkpointMagic[8] = {'L', 'B', 'M', 'C', 'K', 'P', 'T', '\0'};
+const std::uint32_t checkpointVersion = 1;
+
+std::uint64_t alignUp(std::uint64_t offset) {
+  return (offset + checkpointAlignment - 1) / checkpointAlignment *
+         checkpointAlignment;
+}
+
+template <typename Word> void appendRaw(std::vector<char> &out, Word value) {
+  const char *bytes = reinterpret_cast<const char *>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(Word));
+}
+
+template <typename Word>
+Word readRaw(std::vector<char> const &in, pluint &pos) {
+  if (pos + sizeof(Word) > in.size()) {
+    throw PlbIOException("Truncated checkpoint header");
+  }
+  Word value;
+  std::memcpy(&value, &in[pos], sizeof(Word));
+  pos += sizeof(Word);
+  return value;
+}
+
+std::vector<char> encodeHeader(CheckpointHeader const &header) {
+  std::vector<char> bytes(checkpointMagic, checkpointMagic + 8);
+  appendRaw(bytes, checkpointVersion);
+  appendRaw(bytes, (std::uint32_t)0); // header size, patched below
+  appendRaw(bytes, (std::int64_t)header.nx);
+  appendRaw(bytes, (std::int64_t)header.ny);
+  appendRaw(bytes, (std::int64_t)header.step);
+  appendRaw(bytes, (std::uint32_t)header.lattices.size());
+  appendRaw(bytes, (std::uint32_t)header.numPopulations);
+  appendRaw(bytes, (std::uint32_t)header.numScalars);
+  appendRaw(bytes, (std::uint32_t)header.bytesPerValue);
+  for (std::string const &name : header.lattices) {
+    appendRaw(bytes, (std::uint16_t)name.size());
+    bytes.insert(bytes.end(), name.begin(), name.end());
+  }
+  std::uint32_t size = (std::uint32_t)bytes.size();
+  std::memcpy(&bytes[12], &size, sizeof(size));
+  return bytes;
+}
+
+CheckpointHeader decodeHeader(std::vector<char> const &bytes) {
+  if (bytes.size() < 16 || std::memcmp(&bytes[0], checkpointMagic, 8) != 0) {
+    throw PlbIOException("Not a checkpoint file");
+  }
+  pluint pos = 8;
+  if (readRaw<std::uint32_t>(bytes, pos) != checkpointVersion) {
+    throw PlbIOException("Unsupported checkpoint version");
+  }
+  readRaw<std::uint32_t>(bytes, pos);
+  CheckpointHeader header;
+  header.nx = readRaw<std::int64_t>(bytes, pos);
+  header.ny = readRaw<std::int64_t>(bytes, pos);
+  header.step = readRaw<std::int64_t>(bytes, pos);
+  std::uint32_t numLattices = readRaw<std::uint32_t>(bytes, pos);
+  header.numPopulations = readRaw<std::uint32_t>(bytes, pos);
+  header.numScalars = readRaw<std::uint32_t>(bytes, pos);
+  header.bytesPerValue = readRaw<std::uint32_t>(bytes, pos);
+  for (std::uint32_t i = 0; i < numLattices; ++i) {
+    std::uint16_t length = readRaw<std::uint16_t>(bytes, pos);
+    if (pos + length > bytes.size()) {
+      throw PlbIOException("Truncated checkpoint header");
+    }
+    header.lattices.push_back(std::string(&bytes[pos], length));
+    pos += length;
+  }
+  return header;
+}
+
+// Raw header bytes, read by one process.
+std::vector<char> readHeaderBytes(std::string const &fileName) {
+  std::ifstream ifile(fileName.c_str(), std::ios::binary);
+  std::vector<char> bytes(16);
+  if (!ifile || !ifile.read(bytes.data(), bytes.size())) {
+    return std::vector<char>();
+  }
+  std::uint32_t size;
+  std::memcpy(&size, &bytes[12], sizeof(size));
+  if (size < bytes.size()) {
+    return std::vector<char>();
+  }
+  bytes.resize(size);
+  if (!ifile.read(&bytes[16], size - 16)) {
+    return std::vector<char>();
+  }
+  return bytes;
+}
+
+#ifdef PLB_MPI_PARALLEL
+// Collective transfer of all spans. The spans are cut into rounds of at
+// most 1 GiB so every count fits an int; file displacements are sorted as
+// MPI file views require.
+template <class Transfer>
+void transferSpans(MPI_File file, std::vector<CheckpointSpan> const &spans,
+                   char *buffer, Transfer transfer) {
+  MPI_Comm comm = global::mpi().getGlobalCommunicator();
+  const std::uint64_t roundBytes = 1ULL << 30;
+
+  std::vector<CheckpointSpan> sorted(spans);
+  std::sort(sorted.begin(), sorted.end(),
+            [](CheckpointSpan const &a, CheckpointSpan const &b) {
+              return a.fileOffset < b.fileOffset;
+            });
+
+  std::vector<std::vector<CheckpointSpan>> rounds(1);
+  std::uint64_t bytesInRound = 0;
+  for (CheckpointSpan const &span : sorted) {
+    PLB_ASSERT(span.length <= roundBytes);
+    if (bytesInRound + span.length > roundBytes) {
+      rounds.emplace_back();
+      bytesInRound = 0;
+    }
+    rounds.back().push_back(span);
+    bytesInRound += span.length;
+  }
+  long long localRounds = (long long)rounds.size();
+  long long numRounds = 0;
+  MPI_Allreduce(&localRounds, &numRounds, 1, MPI_LONG_LONG, MPI_MAX, comm);
+
+  for (long long iRound = 0; iRound < numRounds; ++iRound) {
+    if (iRound >= localRounds || rounds[iRound].empty()) {
+      MPI_File_set_view(file, 0, MPI_BYTE, MPI_BYTE,
+                        const_cast<char *>("native"), MPI_INFO_NULL);
+      transfer(file, buffer, 0, MPI_BYTE);
+      continue;
+    }
+    std::vector<CheckpointSpan> const &round = rounds[iRound];
+    std::vector<int> lengths(round.size());
+    std::vector<MPI_Aint> fileDisplacements(round.size());
+    std::vector<MPI_Aint> bufferDisplacements(round.size());
+    for (pluint i = 0; i < round.size(); ++i) {
+      lengths[i] = (int)round[i].length;
+      fileDisplacements[i] = (MPI_Aint)round[i].fileOffset;
+      bufferDisplacements[i] = (MPI_Aint)round[i].bufferOffset;
+    }
+    MPI_Datatype fileType, memoryType;
+    MPI_Type_create_hindexed((int)round.size(), lengths.data(),
+                             fileDisplacements.data(), MPI_BYTE, &fileType);
+    MPI_Type_create_hindexed((int)round.size(), lengths.data(),
+                             bufferDisplacements.data(), MPI_BYTE,
+                             &memoryType);
+    MPI_Type_commit(&fileType);
+    MPI_Type_commit(&memoryType);
+    MPI_File_set_view(file, 0, MPI_BYTE, fileType,
+                      const_cast<char *>("native"), MPI_INFO_NULL);
+    transfer(file, buffer, 1, memoryType);
+    MPI_Type_free(&fileType);
+    MPI_Type_free(&memoryType);
+  }
+}
+#endif
+
+} // namespace
+
+std::uint64_t CheckpointHeader::latticeBytes() const {
+  return (std::uint64_t)nx * ny * cellSize() * bytesPerValue;
+}
+
+std::uint64_t CheckpointHeader::latticeOffset(plint iLattice) const {
+  std::uint64_t offset = alignUp(encodeHeader(*this).size());
+  return offset + iLattice * alignUp(latticeBytes());
+}
+
+plint CheckpointHeader::find(std::string const &name) const {
+  for (pluint i = 0; i < lattices.size(); ++i) {
+    if (lattices[i] == name) {
+      return (plint)i;
+    }
+  }
+  return -1;
+}
+
+// Written under a temporary name and renamed once complete, so an
+// interrupted write never replaces the previous checkpoint.
+void writeCheckpointData(std::string const &fileName,
+                         CheckpointHeader const &header,
+                         std::vector<CheckpointSpan> const &spans,
+                         std::vector<char> const &buffer) {
+  std::string partName = fileName + ".part";
+  std::vector<char> headerBytes = encodeHeader(header);
+  std::uint64_t fileSize = header.latticeOffset(header.lattices.size());
+
+#ifdef PLB_MPI_PARALLEL
+  MPI_Comm comm = global::mpi().getGlobalCommunicator();
+  MPI_File file;
+  int status = MPI_File_open(comm, const_cast<char *>(partName.c_str()),
+                             MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                             &file);
+  if (status != MPI_SUCCESS) {
+    throw PlbIOException("Could not open checkpoint file " + partName);
+  }
+  // also truncates a part file left by an interrupted write; collective,
+  // unlike a delete before the open, which one rank may issue after
+  // another created the file
+  MPI_File_set_size(file, (MPI_Offset)fileSize);
+  if (global::mpi().getRank() == 0) {
+    MPI_File_write_at(file, 0, headerBytes.data(), (int)headerBytes.size(),
+                      MPI_BYTE, MPI_STATUS_IGNORE);
+  }
+  transferSpans(file, spans, const_cast<char *>(buffer.data()),
+                [](MPI_File f, char *data, int count, MPI_Datatype type) {
+                  MPI_File_write_all(f, data, count, type, MPI_STATUS_IGNORE);
+                });
+  MPI_File_close(&file);
+  if (global::mpi().getRank() == 0) {
+    std::rename(partName.c_str(), fileName.c_str());
+  }
+  MPI_Barrier(comm);
+#else
+  {
+    std::ofstream ofile(partName.c_str(), std::ios::binary | std::ios::trunc);
+    if (!ofile) {
+      throw PlbIOException("Could not open checkpoint file " + partName);
+    }
+    ofile.write(headerBytes.data(), headerBytes.size());
+    for (CheckpointSpan const &span : spans) {
+      ofile.seekp((std::streamoff)span.fileOffset);
+      ofile.write(&buffer[span.bufferOffset], (std::streamsize)span.length);
+    }
+    // pad the last array up to its alignment
+    ofile.seekp((std::streamoff)fileSize - 1);
+    ofile.put('\0');
+    if (!ofile) {
+      throw PlbIOException("Could not write checkpoint file " + partName);
+    }
+  }
+  std::rename(partName.c_str(), fileName.c_str());
+#endif
+}
+
+CheckpointHeader readCheckpointHeader(std::string const &fileName) {
+  std::vector<char> bytes;
+  if (global::mpi().getRank() == 0) {
+    bytes = readHeaderBytes(fileName);
+  }
+#ifdef PLB_MPI_PARALLEL
+  MPI_Comm comm = global::mpi().getGlobalCommunicator();
+  long long size = (long long)bytes.size();
+  MPI_Bcast(&size, 1, MPI_LONG_LONG, 0, comm);
+  bytes.resize(size);
+  if (size > 0) {
+    MPI_Bcast(bytes.data(), (int)size, MPI_BYTE, 0, comm);
+  }
+#endif
+  if (bytes.empty()) {
+    throw PlbIOException("Could not read checkpoint header of " + fileName);
+  }
+  return decodeHeader(bytes);
+}
+
+void readCheckpointData(std::string const &fileName,
+                        std::vector<CheckpointSpan> const &spans,
+                        std::vector<char> &buffer) {
+#ifdef PLB_MPI_PARALLEL
+  MPI_File file;
+  int status = MPI_File_open(global::mpi().getGlobalCommunicator(),
+                             const_cast<char *>(fileName.c_str()),
+                             MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
+  if (status != MPI_SUCCESS) {
+    throw PlbIOException("Could not open checkpoint file " + fileName);
+  }
+  transferSpans(file, spans, buffer.data(),
+                [](MPI_File f, char *data, int count, MPI_Datatype type) {
+                  MPI_File_read_all(f, data, count, type, MPI_STATUS_IGNORE);
+                });
+  MPI_File_close(&file);
+#else
+  int fd = open(fileName.c_str(), O_RDONLY);
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) != 0) {
+    throw PlbIOException("Could not open checkpoint file " + fileName);
+  }
+  std::uint64_t fileSize = (std::uint64_t)info.st_size;
+  void *mapped = fileSize > 0
+                     ? mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0)
+                     : MAP_FAILED;
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    throw PlbIOException("Could not map checkpoint file " + fileName);
+  }
+  char const *data = static_cast<char const *>(mapped);
+  for (CheckpointSpan const &span : spans) {
+    if (span.fileOffset + span.length > fileSize) {
+      munmap(mapped, fileSize);
+      throw PlbIOException("Truncated checkpoint file " + fileName);
+    }
+    std::memcpy(&buffer[span.bufferOffset], data + span.fileOffset,
+                span.length);
+  }
+  munmap(mapped, fileSize);
+#endif
+}
@@ -0,0 +1,54 @@
+#include "DropletDiagnostics.h"
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+std::string DropletDiagnostics::csvHeader() {
+  return "step,mass,centroidX,centroidY,radius,interfaceLength,c1Inside,"
+         "c1Outside,c2Inside,c2Outside,maxVelocity";
+}
+
+std::string DropletDiagnostics::csvRow() const {
+  std::ostringstream row;
+  row << std::setprecision(10) << step << "," << mass << "," << centroidX
+      << "," << centroidY << "," << radius << "," << interfaceLength << ","
+      << c1Inside << "," << c1Outside << "," << c2Inside << "," << c2Outside
+      << "," << maxVelocity;
+  return row.str();
+}
+
+void DiagnosticsSums::allReduce() {
+#ifdef PLB_MPI_PARALLEL
+  MPI_Comm comm = global::mpi().getGlobalCommunicator();
+  double sums[8] = {phi,      phiX,      phiY,     gradNorm,
+                    c1Inside, c1Outside, c2Inside, c2Outside};
+  MPI_Allreduce(MPI_IN_PLACE, sums, 8, MPI_DOUBLE, MPI_SUM, comm);
+  MPI_Allreduce(MPI_IN_PLACE, &maxVelocitySqr, 1, MPI_DOUBLE, MPI_MAX, comm);
+  phi = sums[0];
+  phiX = sums[1];
+  phiY = sums[2];
+  gradNorm = sums[3];
+  c1Inside = sums[4];
+  c1Outside = sums[5];
+  c2Inside = sums[6];
+  c2Outside = sums[7];
+#endif
+}
+
+DropletDiagnostics DiagnosticsSums::finish(plint step) const {
+  DropletDiagnostics diagnostics;
+  diagnostics.step = step;
+  diagnostics.mass = phi;
+  if (phi > 0.) {
+    diagnostics.centroidX = phiX / phi;
+    diagnostics.centroidY = phiY / phi;
+  }
+  diagnostics.radius = std::sqrt(std::max(phi, 0.) / M_PI);
+  diagnostics.interfaceLength = gradNorm;
+  diagnostics.c1Inside = c1Inside;
+  diagnostics.c1Outside = c1Outside;
+  diagnostics.c2Inside = c2Inside;
+  diagnostics.c2Outside = c2Outside;
+  diagnostics.maxVelocity = std::sqrt(maxVelocitySqr);
+  return diagnostics;
+}
@@ -0,0 +1,160 @@
+#include "DropletField.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+std::vector<DropletSpec> readDropletFile(std::string const &fileName) {
+  std::ifstream file(fileName.c_str());
+  if (!file) {
+    throw PlbIOException("Could not open droplet file " + fileName);
+  }
+  std::vector<DropletSpec> droplets;
+  std::string line;
+  plint lineNumber = 0;
+  while (std::getline(file, line)) {
+    ++lineNumber;
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::stringstream row(line);
+    std::vector<double> values;
+    std::string word;
+    while (row >> word && word[0] != '#') {
+      std::size_t end = 0;
+      double value = 0;
+      try {
+        value = std::stod(word, &end);
+      } catch (std::exception const &) {
+        end = 0;
+      }
+      if (end == 0 || end != word.size()) {
+        throw PlbIOException(fileName + ":" + std::to_string(lineNumber) +
+                             ": " + word + " is not a number");
+      }
+      values.push_back(value);
+    }
+    if (values.empty()) {
+      continue;
+    }
+    if ((values.size() != 3 && values.size() != 5) || values[2] <= 0) {
+      throw PlbIOException(fileName + ":" + std::to_string(lineNumber) +
+                           ": expected x y r [c1 c2] with r > 0");
+    }
+    DropletSpec droplet;
+    droplet.x = values[0];
+    droplet.y = values[1];
+    droplet.r = values[2];
+    if (values.size() == 5) {
+      droplet.c1 = values[3];
+      droplet.c2 = values[4];
+    }
+    droplets.push_back(droplet);
+  }
+  return droplets;
+}
+
+DropletField::DropletField(std::vector<DropletSpec> const &droplets,
+                           double zeta, double cBulk)
+    : droplets_(droplets), zeta_(std::max(1e-3, zeta)), cBulk_(cBulk) {
+  // 0.5 (1 - tanh(10)) is below phiFloor
+  reach_ = 10. * zeta_ / 2.;
+  if (droplets_.empty()) {
+    return;
+  }
+
+  double x1 = -1e300, y1 = -1e300, meanExtent = 0;
+  x0_ = y0_ = 1e300;
+  for (DropletSpec const &d : droplets_) {
+    double extent = d.r + reach_;
+    x0_ = std::min(x0_, d.x - extent);
+    y0_ = std::min(y0_, d.y - extent);
+    x1 = std::max(x1, d.x + extent);
+    y1 = std::max(y1, d.y + extent);
+    meanExtent += 2 * extent;
+  }
+  meanExtent /= (double)droplets_.size();
+
+  // bins about the size of a droplet with its interface, so that a bin
+  // holds a few droplets; coarser if a sparse set would need too many
+  binSize_ = std::max(1., meanExtent);
+  const double maxBins = 4. * (double)droplets_.size() + 4096.;
+  double numBins = std::ceil((x1 - x0_) / binSize_) *
+                   std::ceil((y1 - y0_) / binSize_);
+  if (numBins > maxBins) {
+    binSize_ *= std::sqrt(numBins / maxBins);
+  }
+  nbx_ = std::max((plint)1, (plint)std::ceil((x1 - x0_) / binSize_));
+  nby_ = std::max((plint)1, (plint)std::ceil((y1 - y0_) / binSize_));
+
+  // counting pass, then fill (compressed rows)
+  auto binRange = [this](DropletSpec const &d, plint &bx0, plint &bx1,
+                         plint &by0, plint &by1) {
+    double extent = d.r + reach_;
+    bx0 = std::max((plint)0, (plint)((d.x - extent - x0_) / binSize_));
+    by0 = std::max((plint)0, (plint)((d.y - extent - y0_) / binSize_));
+    bx1 = std::min(nbx_ - 1, (plint)((d.x + extent - x0_) / binSize_));
+    by1 = std::min(nby_ - 1, (plint)((d.y + extent - y0_) / binSize_));
+  };
+  binStart_.assign(nbx_ * nby_ + 1, 0);
+  for (DropletSpec const &d : droplets_) {
+    plint bx0, bx1, by0, by1;
+    binRange(d, bx0, bx1, by0, by1);
+    for (plint bx = bx0; bx <= bx1; ++bx) {
+      for (plint by = by0; by <= by1; ++by) {
+        ++binStart_[bx * nby_ + by + 1];
+      }
+    }
+  }
+  for (plint b = 0; b < nbx_ * nby_; ++b) {
+    binStart_[b + 1] += binStart_[b];
+  }
+  items_.resize(binStart_.back());
+  std::vector<plint> fill(binStart_.begin(), binStart_.end() - 1);
+  for (plint i = 0; i < (plint)droplets_.size(); ++i) {
+    plint bx0, bx1, by0, by1;
+    binRange(droplets_[i], bx0, bx1, by0, by1);
+    for (plint bx = bx0; bx <= bx1; ++bx) {
+      for (plint by = by0; by <= by1; ++by) {
+        items_[fill[bx * nby_ + by]++] = i;
+      }
+    }
+  }
+}
+
+DropletField::Sample DropletField::sample(double x, double y) const {
+  Sample bath = {phiFloor, cBulk_, cBulk_};
+  if (droplets_.empty() || x < x0_ || y < y0_) {
+    return bath;
+  }
+  plint bx = (plint)((x - x0_) / binSize_);
+  plint by = (plint)((y - y0_) / binSize_);
+  if (bx >= nbx_ || by >= nby_) {
+    return bath;
+  }
+
+  // signed distance to the union of the discs and the nearest droplet
+  plint nearest = -1;
+  double distance = reach_;
+  for (plint k = binStart_[bx * nby_ + by]; k < binStart_[bx * nby_ + by + 1];
+       ++k) {
+    DropletSpec const &d = droplets_[items_[k]];
+    double dx = x - d.x, dy = y - d.y;
+    double dk = std::sqrt(dx * dx + dy * dy) - d.r;
+    if (dk < distance) {
+      distance = dk;
+      nearest = items_[k];
+    }
+  }
+  if (nearest < 0) {
+    return bath;
+  }
+
+  double arg = std::min(2. / zeta_ * distance, 50.);
+  double phi = 0.5 * (1. - std::tanh(arg));
+  phi = std::max(phiFloor, std::min(phi, 1.));
+  DropletSpec const &d = droplets_[nearest];
+  Sample s;
+  s.phi = phi;
+  s.c1 = d.c1 < 0 ? cBulk_ : cBulk_ + phi * (d.c1 - cBulk_);
+  s.c2 = d.c2 < 0 ? cBulk_ : cBulk_ + phi * (d.c2 - cBulk_);
+  return s;
+}
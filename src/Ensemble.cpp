@@ -0,0 +1,137 @@
+#include "Ensemble.h"
+#include <cmath>
+#include <functional>
+#include <map>
+#include <sstream>
+
+namespace {
+
+typedef std::function<void(EnsembleCase &, double)> Setter;
+
+std::map<std::string, Setter> tableColumns() {
+  std::map<std::string, Setter> columns;
+  auto real = [&columns](std::string const &name,
+                         double DropletParameters::*field) {
+    columns[name] = [field](EnsembleCase &c, double value) {
+      c.params.*field = value;
+    };
+  };
+  auto integer = [&columns](std::string const &name,
+                            plint DropletParameters::*field) {
+    columns[name] = [field](EnsembleCase &c, double value) {
+      c.params.*field = (plint)std::llround(value);
+    };
+  };
+  integer("nx", &DropletParameters::nx);
+  integer("ny", &DropletParameters::ny);
+  real("r0", &DropletParameters::r0);
+  real("zeta", &DropletParameters::zeta);
+  real("M", &DropletParameters::M);
+  real("magic", &DropletParameters::magic);
+  real("chi", &DropletParameters::chi);
+  real("mu", &DropletParameters::mu);
+  real("a", &DropletParameters::a);
+  real("b", &DropletParameters::b);
+  real("epsilon", &DropletParameters::epsilon);
+  real("c_bulk", &DropletParameters::c_bulk);
+  real("tau1", &DropletParameters::tau1);
+  real("tau2", &DropletParameters::tau2);
+  integer("reactionPeriod", &DropletParameters::reactionPeriod);
+  columns["reactionSubsteps"] = [](EnsembleCase &c, double value) {
+    c.params.reactionSubsteps = (int)std::lround(value);
+  };
+  real("reactionTolerance", &DropletParameters::reactionTolerance);
+  integer("tileSize", &DropletParameters::tileSize);
+  real("tileTolerance", &DropletParameters::tileTolerance);
+  real("tauP", &DropletParameters::tauP);
+  real("beta", &DropletParameters::beta);
+  real("kappa", &DropletParameters::kappa);
+  columns["steps"] = [](EnsembleCase &c, double value) {
+    c.steps = (plint)std::llround(value);
+  };
+  columns["reportEvery"] = [](EnsembleCase &c, double value) {
+    c.reportEvery = (plint)std::llround(value);
+  };
+  return columns;
+}
+
+std::vector<std::string> splitRow(std::string const &line) {
+  std::vector<std::string> cells;
+  std::stringstream row(line);
+  std::string cell;
+  while (std::getline(row, cell, ',')) {
+    std::string::size_type first = cell.find_first_not_of(" \t\r");
+    std::string::size_type last = cell.find_last_not_of(" \t\r");
+    cells.push_back(first == std::string::npos
+                        ? std::string()
+                        : cell.substr(first, last - first + 1));
+  }
+  return cells;
+}
+
+} // namespace
+
+std::vector<EnsembleCase> readEnsembleTable(std::string const &fileName,
+                                            EnsembleCase const &defaults) {
+  std::ifstream table(fileName.c_str());
+  if (!table) {
+    throw PlbIOException("Could not open ensemble table " + fileName);
+  }
+  std::map<std::string, Setter> const columns = tableColumns();
+
+  std::vector<std::string> header;
+  std::vector<EnsembleCase> cases;
+  std::string line;
+  plint lineNumber = 0;
+  while (std::getline(table, line)) {
+    ++lineNumber;
+    std::vector<std::string> cells = splitRow(line);
+    if (cells.empty() || (cells.size() == 1 && cells[0].empty()) ||
+        cells[0].compare(0, 1, "#") == 0) {
+      continue;
+    }
+    std::string where = fileName + ":" + std::to_string(lineNumber);
+    if (header.empty()) {
+      for (std::string const &name : cells) {
+        if (name != "label" && columns.find(name) == columns.end()) {
+          throw PlbIOException(where + ": unknown column " + name);
+        }
+      }
+      header = cells;
+      continue;
+    }
+    if (cells.size() != header.size()) {
+      throw PlbIOException(where + ": expected " +
+                           std::to_string(header.size()) + " values");
+    }
+
+    EnsembleCase c = defaults;
+    c.label = createFileName("", (plint)cases.size(), 4);
+    for (pluint i = 0; i < cells.size(); ++i) {
+      if (header[i] == "label") {
+        if (!cells[i].empty()) {
+          c.label = cells[i];
+        }
+        continue;
+      }
+      std::size_t end = 0;
+      double value = 0;
+      try {
+        value = std::stod(cells[i], &end);
+      } catch (std::exception const &) {
+        end = 0;
+      }
+      if (end == 0 || end != cells[i].size()) {
+        throw PlbIOException(where + ": " + header[i] + " is not a number");
+      }
+      columns.find(header[i])->second(c, value);
+    }
+    if (c.params.nx < 1 || c.params.ny < 1 || c.steps < 0 ||
+        c.reportEvery < 1) {
+      throw PlbIOException(where + ": needs nx, ny, reportEvery >= 1 and "
+                                   "steps >= 0");
+    }
+    cases.push_back(c);
+  }
+  return cases;
+}
@@ -0,0 +1,29 @@
+#include "GridRefinement.h"
+
+LevelBuffer::LevelBuffer(Box2D box)
+    : box_(box),
+      data_((std::size_t)box.nCells() * numLattices * recordSize, 0.) {}
+
+void LevelBuffer::clear() { std::fill(data_.begin(), data_.end(), 0.); }
+
+void LevelBuffer::allReduce() {
+#ifdef PLB_MPI_PARALLEL
+  // every node is in the bulk of exactly one rank, the others hold zeros
+  MPI_Allreduce(MPI_IN_PLACE, data_.data(), (int)data_.size(), MPI_DOUBLE,
+                MPI_SUM, global::mpi().getGlobalCommunicator());
+#endif
+}
+
+void allReduceBoundingBox(Box2D &box) {
+#ifdef PLB_MPI_PARALLEL
+  MPI_Comm comm = global::mpi().getGlobalCommunicator();
+  long long lower[2] = {box.x0, box.y0};
+  long long upper[2] = {box.x1, box.y1};
+  MPI_Allreduce(MPI_IN_PLACE, lower, 2, MPI_LONG_LONG, MPI_MIN, comm);
+  MPI_Allreduce(MPI_IN_PLACE, upper, 2, MPI_LONG_LONG, MPI_MAX, comm);
+  box = Box2D((plint)lower[0], (plint)upper[0], (plint)lower[1],
+              (plint)upper[1]);
+#else
+  (void)box;
+#endif
+}
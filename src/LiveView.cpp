@@ -0,0 +1,166 @@
+#include "LiveView.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+const char liveMagic[8] = {'L', 'B', 'M', 'L', 'I', 'V', 'E', '\0'};
+const std::uint64_t publishedOffset = 64;
+const std::uint64_t fieldRecordSize = 24;
+const std::uint64_t blockRecordSize = 32;
+// sequence and step, padded so that the values start on a cache line
+const std::uint64_t slotHeaderSize = 64;
+
+static_assert(sizeof(std::atomic<std::uint64_t>) == sizeof(std::uint64_t),
+              "the seqlock words are shared with readers as plain uint64");
+
+std::uint64_t alignUp(std::uint64_t value, std::uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+template <typename Word> void put(char *data, std::uint64_t pos, Word value) {
+  std::memcpy(data + pos, &value, sizeof(Word));
+}
+
+std::atomic<std::uint64_t> &word(char *address) {
+  return *reinterpret_cast<std::atomic<std::uint64_t> *>(address);
+}
+
+std::string systemError(std::string const &what) {
+  return what + ": " + std::strerror(errno);
+}
+
+} // namespace
+
+LiveView::LiveView(std::string const &fileName, plint numSlots)
+    : fileName_(fileName), numSlots_(numSlots) {
+  PLB_ASSERT(numSlots > 0);
+  fd_ = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    throw PlbIOException(systemError("Could not create live view " +
+                                     fileName));
+  }
+}
+
+LiveView::~LiveView() {
+  if (data_) {
+    ::munmap(data_, size_);
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+std::string LiveView::fileNameFor(std::string const &directory, int rank) {
+  std::string prefix = directory;
+  if (!prefix.empty() && prefix.back() != '/') {
+    prefix += '/';
+  }
+  return prefix + "live" + createFileName("_p", rank, 4) + ".lbmlive";
+}
+
+void LiveView::map(SnapshotFrame const &frame) {
+  fields_ = frame.fields;
+  blocks_.clear();
+  plint numValues = 0;
+  for (SnapshotBlock const &block : frame.blocks) {
+    blocks_.push_back(block.bulk);
+    for (SnapshotField const &field : fields_) {
+      numValues += block.bulk.nCells() * field.numComponents;
+    }
+  }
+  for (SnapshotField const &field : fields_) {
+    if (field.name.size() > maxNameLength) {
+      throw PlbIOException("Live view field name too long: " + field.name);
+    }
+  }
+
+  const std::uint64_t headerSize = publishedOffset + 8 +
+                                   fieldRecordSize * fields_.size() +
+                                   blockRecordSize * blocks_.size();
+  dataOffset_ = alignUp(headerSize, 64);
+  slotSize_ =
+      alignUp(slotHeaderSize + sizeof(float) * (std::uint64_t)numValues, 64);
+  size_ = dataOffset_ + slotSize_ * (std::uint64_t)numSlots_;
+  if (::ftruncate(fd_, (off_t)size_) != 0) {
+    throw PlbIOException(systemError("Could not size live view " +
+                                     fileName_));
+  }
+  void *data =
+      ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (data == MAP_FAILED) {
+    throw PlbIOException(systemError("Could not map live view " + fileName_));
+  }
+  data_ = static_cast<char *>(data);
+
+  // the file is zero-filled, so every slot starts out complete and empty
+  put(data_, 8, version);
+  put(data_, 12, (std::uint32_t)headerSize);
+  put(data_, 16, (std::int64_t)frame.nx);
+  put(data_, 24, (std::int64_t)frame.ny);
+  put(data_, 32, (std::uint32_t)fields_.size());
+  put(data_, 36, (std::uint32_t)blocks_.size());
+  put(data_, 40, (std::uint32_t)numSlots_);
+  put(data_, 48, slotSize_);
+  put(data_, 56, dataOffset_);
+  std::uint64_t pos = publishedOffset + 8;
+  for (SnapshotField const &field : fields_) {
+    std::memcpy(data_ + pos, field.name.data(), field.name.size());
+    put(data_, pos + maxNameLength, (std::uint32_t)field.numComponents);
+    pos += fieldRecordSize;
+  }
+  for (Box2D const &box : blocks_) {
+    put(data_, pos, (std::int64_t)box.x0);
+    put(data_, pos + 8, (std::int64_t)box.x1);
+    put(data_, pos + 16, (std::int64_t)box.y0);
+    put(data_, pos + 24, (std::int64_t)box.y1);
+    pos += blockRecordSize;
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(data_, liveMagic, sizeof(liveMagic));
+}
+
+void LiveView::publish(SnapshotFrame const &frame) {
+  if (!data_) {
+    map(frame);
+  }
+  bool sameLayout = frame.fields.size() == fields_.size() &&
+                    frame.blocks.size() == blocks_.size();
+  for (pluint i = 0; sameLayout && i < fields_.size(); ++i) {
+    sameLayout = frame.fields[i].name == fields_[i].name &&
+                 frame.fields[i].numComponents == fields_[i].numComponents;
+  }
+  for (pluint i = 0; sameLayout && i < blocks_.size(); ++i) {
+    Box2D const &a = frame.blocks[i].bulk, &b = blocks_[i];
+    sameLayout = a.x0 == b.x0 && a.x1 == b.x1 && a.y0 == b.y0 && a.y1 == b.y1;
+  }
+  if (!sameLayout) {
+    throw PlbIOException("Live view " + fileName_ +
+                         ": frame layout differs from the first frame");
+  }
+
+  const std::uint64_t n = published_ + 1;
+  char *base = data_ + dataOffset_ + ((n - 1) % numSlots_) * slotSize_;
+  std::atomic<std::uint64_t> &sequence = word(base);
+  sequence.store(2 * n - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  put(base, 8, (std::int64_t)frame.step);
+  float *out = reinterpret_cast<float *>(base + slotHeaderSize);
+  for (pluint iField = 0; iField < fields_.size(); ++iField) {
+    for (SnapshotBlock const &block : frame.blocks) {
+      std::vector<double> const &values = block.values[iField];
+      out = std::transform(values.begin(), values.end(), out,
+                           [](double value) { return (float)value; });
+    }
+  }
+
+  sequence.store(2 * n, std::memory_order_release);
+  word(data_ + publishedOffset).store(n, std::memory_order_release);
+  published_ = n;
+}
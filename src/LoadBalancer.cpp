@@ -0,0 +1,136 @@
+#include "LoadBalancer.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+CostMap::CostMap(Box2D domain, plint tileSize)
+    : domain_(domain), tileSize_(std::max((plint)1, tileSize)),
+      numTilesX_(std::max((plint)1, domain.getNx() / tileSize_)),
+      numTilesY_(std::max((plint)1, domain.getNy() / tileSize_)),
+      tiles_(numTilesX_ * numTilesY_, 0.) {}
+
+void CostMap::combineRanks() {
+  rankCosts_.assign(global::mpi().getSize(), 0.);
+#ifdef PLB_MPI_PARALLEL
+  MPI_Comm comm = global::mpi().getGlobalCommunicator();
+  MPI_Allreduce(MPI_IN_PLACE, tiles_.data(), (int)tiles_.size(), MPI_DOUBLE,
+                MPI_SUM, comm);
+  MPI_Allgather(&localCost_, 1, MPI_DOUBLE, rankCosts_.data(), 1, MPI_DOUBLE,
+                comm);
+#else
+  rankCosts_[0] = localCost_;
+#endif
+}
+
+Box2D CostMap::cellsOf(plint tileX0, plint tileX1, plint tileY0,
+                       plint tileY1) const {
+  // the last tile of a row runs to the edge of the domain
+  plint x1 = tileX1 == numTilesX_ - 1
+                 ? domain_.x1
+                 : domain_.x0 + (tileX1 + 1) * tileSize_ - 1;
+  plint y1 = tileY1 == numTilesY_ - 1
+                 ? domain_.y1
+                 : domain_.y0 + (tileY1 + 1) * tileSize_ - 1;
+  return Box2D(domain_.x0 + tileX0 * tileSize_, x1,
+               domain_.y0 + tileY0 * tileSize_, y1);
+}
+
+double CostMap::getImbalance() const {
+  double total = 0, largest = 0;
+  for (double cost : rankCosts_) {
+    total += cost;
+    largest = std::max(largest, cost);
+  }
+  return total > 0 ? largest * (double)rankCosts_.size() / total : 1.;
+}
+
+namespace {
+
+void bisect(CostMap const &costs, plint tx0, plint tx1, plint ty0, plint ty1,
+            plint firstPart, plint numParts, std::vector<Box2D> &parts) {
+  if (numParts == 1 || (tx0 == tx1 && ty0 == ty1)) {
+    parts[firstPart] = costs.cellsOf(tx0, tx1, ty0, ty1);
+    return;
+  }
+  // cost of each tile row across the cut direction
+  const bool alongX = tx1 - tx0 >= ty1 - ty0;
+  const plint first = alongX ? tx0 : ty0, last = alongX ? tx1 : ty1;
+  std::vector<double> rows(last - first + 1, 0.);
+  double total = 0;
+  for (plint tx = tx0; tx <= tx1; ++tx) {
+    for (plint ty = ty0; ty <= ty1; ++ty) {
+      double cost = costs.getTile(tx, ty);
+      rows[(alongX ? tx : ty) - first] += cost;
+      total += cost;
+    }
+  }
+
+  // last row of the lower side, closest to its share of the cost
+  const plint lowerParts = numParts / 2;
+  const double target = total * (double)lowerParts / (double)numParts;
+  plint cut = first;
+  double lower = rows[0], bestError = std::abs(lower - target);
+  for (plint row = first + 1; row < last; ++row) {
+    lower += rows[row - first];
+    double error = std::abs(lower - target);
+    if (error < bestError) {
+      bestError = error;
+      cut = row;
+    }
+  }
+
+  if (alongX) {
+    bisect(costs, tx0, cut, ty0, ty1, firstPart, lowerParts, parts);
+    bisect(costs, cut + 1, tx1, ty0, ty1, firstPart + lowerParts,
+           numParts - lowerParts, parts);
+  } else {
+    bisect(costs, tx0, tx1, ty0, cut, firstPart, lowerParts, parts);
+    bisect(costs, tx0, tx1, cut + 1, ty1, firstPart + lowerParts,
+           numParts - lowerParts, parts);
+  }
+}
+
+} // namespace
+
+std::vector<Box2D> bisectByCost(CostMap const &costs, plint numParts) {
+  PLB_PRECONDITION(numParts >= 1);
+  // empty unless bisect() assigns it
+  std::vector<Box2D> parts(numParts, Box2D(0, -1, 0, -1));
+  bisect(costs, 0, costs.getNumTilesX() - 1, 0, costs.getNumTilesY() - 1, 0,
+         numParts, parts);
+  return parts;
+}
+
+std::vector<double> costOfParts(CostMap const &costs,
+                                std::vector<Box2D> const &parts) {
+  std::vector<double> partCosts(parts.size(), 0.);
+  for (plint tx = 0; tx < costs.getNumTilesX(); ++tx) {
+    for (plint ty = 0; ty < costs.getNumTilesY(); ++ty) {
+      Box2D tile = costs.cellsOf(tx, tx, ty, ty);
+      for (pluint i = 0; i < parts.size(); ++i) {
+        if (contained(tile.x0, tile.y0, parts[i])) {
+          partCosts[i] += costs.getTile(tx, ty);
+          break;
+        }
+      }
+    }
+  }
+  return partCosts;
+}
+
+MultiBlockManagement2D partitionManagement(Box2D domain,
+                                           std::vector<Box2D> const &parts,
+                                           plint envelopeWidth) {
+  SparseBlockStructure2D structure(domain);
+  std::map<plint, int> attribution;
+  for (pluint i = 0; i < parts.size(); ++i) {
+    if (parts[i].x1 < parts[i].x0) {
+      continue;
+    }
+    structure.addBlock(parts[i], (plint)i);
+    attribution[(plint)i] = (int)i;
+  }
+  return MultiBlockManagement2D(structure,
+                                new ExplicitThreadAttribution(attribution),
+                                envelopeWidth);
+}
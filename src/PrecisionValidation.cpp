@@ -0,0 +1,62 @@
+#include "PrecisionValidation.h"
+#include <algorithm>
+
+void PrecisionDeviation::takeMax(PrecisionDeviation const &other) {
+  mass = std::max(mass, other.mass);
+  radius = std::max(radius, other.radius);
+  phi = std::max(phi, other.phi);
+  c1 = std::max(c1, other.c1);
+  c2 = std::max(c2, other.c2);
+}
+
+void allReduce(DropletSample &sample) {
+#ifdef PLB_MPI_PARALLEL
+  // every profile value is set by the one rank that owns its cell
+  std::vector<double> data(1 + 3 * sample.phi.size());
+  data[0] = sample.mass;
+  std::copy(sample.phi.begin(), sample.phi.end(), data.begin() + 1);
+  std::copy(sample.c1.begin(), sample.c1.end(),
+            data.begin() + 1 + sample.phi.size());
+  std::copy(sample.c2.begin(), sample.c2.end(),
+            data.begin() + 1 + 2 * sample.phi.size());
+  MPI_Allreduce(MPI_IN_PLACE, data.data(), (int)data.size(), MPI_DOUBLE,
+                MPI_SUM, global::mpi().getGlobalCommunicator());
+  sample.mass = data[0];
+  std::vector<double>::const_iterator begin = data.begin() + 1;
+  std::copy(begin, begin + sample.phi.size(), sample.phi.begin());
+  begin += sample.phi.size();
+  std::copy(begin, begin + sample.c1.size(), sample.c1.begin());
+  begin += sample.c1.size();
+  std::copy(begin, begin + sample.c2.size(), sample.c2.begin());
+#endif
+  sample.radius = std::sqrt(std::max(sample.mass, 0.) / M_PI);
+}
+
+namespace {
+
+double maxDifference(std::vector<double> const &a,
+                     std::vector<double> const &b) {
+  double difference = 0;
+  for (pluint i = 0; i < std::min(a.size(), b.size()); ++i) {
+    difference = std::max(difference, std::abs(a[i] - b[i]));
+  }
+  return difference;
+}
+
+double relative(double reference, double value) {
+  return std::abs(value - reference) /
+         std::max(std::abs(reference), 1e-300);
+}
+
+} // namespace
+
+PrecisionDeviation compare(DropletSample const &reference,
+                           DropletSample const &other) {
+  PrecisionDeviation deviation;
+  deviation.mass = relative(reference.mass, other.mass);
+  deviation.radius = relative(reference.radius, other.radius);
+  deviation.phi = maxDifference(reference.phi, other.phi);
+  deviation.c1 = maxDifference(reference.c1, other.c1);
+  deviation.c2 = maxDifference(reference.c2, other.c2);
+  return deviation;
+}
@@ -0,0 +1,396 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::atomic<bool> Profiler::enabled_(false);
+bool Profiler::sync_ = false;
+bool Profiler::counters_ = false;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+Clock::time_point epoch = Clock::now();
+
+// Events of one thread; only that thread appends. Owned by the registry,
+// so the events of a finished thread stay available for the export. The
+// events point to their names in scopeNames, which outlive the objects
+// (e.g. a scheduler replaced on a regrid) that named the scopes.
+struct ThreadBuffer {
+  int id;
+  std::string name;
+  std::vector<Profiler::Event> events;
+  std::set<std::string, std::less<>> scopeNames;
+};
+
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+thread_local ThreadBuffer *localBuffer = nullptr;
+
+ThreadBuffer &threadBuffer() {
+  if (!localBuffer) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer);
+    buffer->id = (int)registry.size();
+    buffer->name = "thread " + std::to_string(buffer->id);
+    buffer->events.reserve(1 << 14);
+    localBuffer = buffer.get();
+    registry.push_back(std::move(buffer));
+  }
+  return *localBuffer;
+}
+
+// Counter group of the calling thread, opened on first use.
+class PerfGroup {
+public:
+  ~PerfGroup() {
+#ifdef __linux__
+    for (int fd : fds_) {
+      close(fd);
+    }
+#endif
+  }
+
+  bool read(std::uint64_t values[Profiler::numCounters]) {
+    if (!opened_) {
+      open();
+    }
+    if (fds_.size() != Profiler::numCounters) {
+      return false;
+    }
+#ifdef __linux__
+    std::uint64_t buffer[1 + Profiler::numCounters];
+    if (::read(fds_[0], buffer, sizeof(buffer)) != (ssize_t)sizeof(buffer)) {
+      return false;
+    }
+    for (int i = 0; i < Profiler::numCounters; ++i) {
+      values[i] = buffer[1 + i];
+    }
+    return true;
+#else
+    return false;
+#endif
+  }
+
+private:
+  void open() {
+    opened_ = true;
+#ifdef __linux__
+    const std::uint64_t configs[Profiler::numCounters] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES};
+    for (int i = 0; i < Profiler::numCounters; ++i) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.read_format = PERF_FORMAT_GROUP;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      int leader = fds_.empty() ? -1 : fds_[0];
+      int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+      if (fd < 0) {
+        for (int open : fds_) {
+          close(open);
+        }
+        fds_.clear();
+        return;
+      }
+      fds_.push_back(fd);
+    }
+#endif
+  }
+
+  bool opened_ = false;
+  std::vector<int> fds_;
+};
+
+thread_local PerfGroup perfGroup;
+
+std::string jsonEscape(char const *text) {
+  std::string escaped;
+  for (char const *c = text; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      escaped += '\\';
+    }
+    escaped += *c;
+  }
+  return escaped;
+}
+
+// Totals of one scope name on one rank.
+struct Totals {
+  enum {
+    calls,
+    seconds,
+    wait,
+    cells,
+    cycles,
+    instructions,
+    cacheMisses,
+    size
+  };
+};
+
+} // namespace
+
+void Profiler::configure() {
+  char const *setting = std::getenv("LBM_PROFILE");
+  if (!setting || !*setting) {
+    return;
+  }
+  bool sync = false, counters = false;
+  std::stringstream options(setting);
+  std::string option;
+  while (std::getline(options, option, ',')) {
+    if (option == "sync") {
+      sync = true;
+    } else if (option == "counters") {
+      counters = true;
+    } else if (option == "off" || option == "0") {
+      return;
+    }
+  }
+  enable(sync, counters);
+}
+
+void Profiler::enable(bool sync, bool counters) {
+  sync_ = sync;
+  counters_ = counters;
+  epoch = Clock::now();
+  enabled_.store(true);
+}
+
+void Profiler::clear() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  for (std::unique_ptr<ThreadBuffer> &buffer : registry) {
+    buffer->events.clear();
+  }
+}
+
+void Profiler::setThreadName(std::string const &name) {
+  threadBuffer().name = name;
+}
+
+std::int64_t Profiler::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                              epoch)
+      .count();
+}
+
+void Profiler::readCounters(std::uint64_t values[numCounters]) {
+  if (!counters_ || !perfGroup.read(values)) {
+    std::fill(values, values + numCounters, 0);
+  }
+}
+
+void Profiler::record(Event const &event) {
+  threadBuffer().events.push_back(event);
+}
+
+void Profiler::writeChromeTrace(std::string const &fileName) {
+  std::ofstream out(fileName.c_str());
+  if (!out) {
+    throw PlbIOException("Profiler: cannot open " + fileName);
+  }
+  int rank = global::mpi().getRank();
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << rank
+      << ",\"args\":{\"name\":\"rank " << rank << "\"}}";
+  std::lock_guard<std::mutex> lock(registryMutex);
+  for (std::unique_ptr<ThreadBuffer> const &buffer : registry) {
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << rank
+        << ",\"tid\":" << buffer->id << ",\"args\":{\"name\":\""
+        << jsonEscape(buffer->name.c_str()) << "\"}}";
+    for (Event const &event : buffer->events) {
+      out << ",\n{\"name\":\"" << jsonEscape(event.name) << "\",\"cat\":\""
+          << event.category << "\",\"ph\":\"X\",\"pid\":" << rank
+          << ",\"tid\":" << buffer->id << std::fixed << std::setprecision(3)
+          << ",\"ts\":" << event.begin * 1e-3
+          << ",\"dur\":" << event.duration * 1e-3 << ",\"args\":{";
+      out.unsetf(std::ios::floatfield);
+      out << "\"cells\":" << event.cells;
+      if (event.wait > 0) {
+        out << ",\"waitUs\":" << event.wait * 1e-3;
+      }
+      if (counters_) {
+        out << ",\"cycles\":" << event.counters[cycles]
+            << ",\"instructions\":" << event.counters[instructions]
+            << ",\"cacheMisses\":" << event.counters[cacheMisses];
+      }
+      out << "}}";
+    }
+  }
+  out << "\n]}\n";
+}
+
+void Profiler::printSummary(std::ostream &out) {
+  // local totals per name; the category of a name is the one it was first
+  // recorded with
+  std::map<std::string, std::vector<double>> local;
+  std::map<std::string, std::string> categories;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (std::unique_ptr<ThreadBuffer> const &buffer : registry) {
+      for (Event const &event : buffer->events) {
+        std::vector<double> &totals = local[event.name];
+        totals.resize(Totals::size, 0.);
+        categories.insert(std::make_pair(event.name, event.category));
+        totals[Totals::calls] += 1.;
+        totals[Totals::seconds] += event.duration * 1e-9;
+        totals[Totals::wait] += event.wait * 1e-9;
+        totals[Totals::cells] += (double)event.cells;
+        totals[Totals::cycles] += (double)event.counters[cycles];
+        totals[Totals::instructions] += (double)event.counters[instructions];
+        totals[Totals::cacheMisses] += (double)event.counters[cacheMisses];
+      }
+    }
+  }
+
+  // The ranks need not have recorded the same names (e.g. a rank without a
+  // block of the fine patch): reduce over the union.
+  std::set<std::string> names;
+  for (auto const &entry : local) {
+    names.insert(entry.first + '\t' + categories[entry.first]);
+  }
+#ifdef PLB_MPI_PARALLEL
+  {
+    std::string joined;
+    for (std::string const &name : names) {
+      joined += name + '\n';
+    }
+    MPI_Comm comm = global::mpi().getGlobalCommunicator();
+    int size = global::mpi().getSize();
+    int length = (int)joined.size();
+    std::vector<int> lengths(size), offsets(size, 0);
+    MPI_Allgather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, comm);
+    for (int i = 1; i < size; ++i) {
+      offsets[i] = offsets[i - 1] + lengths[i - 1];
+    }
+    std::vector<char> all(offsets.back() + lengths.back() + 1, '\0');
+    MPI_Allgatherv(joined.data(), length, MPI_CHAR, all.data(),
+                   lengths.data(), offsets.data(), MPI_CHAR, comm);
+    std::stringstream lines(std::string(all.data()));
+    std::string line;
+    while (std::getline(lines, line)) {
+      names.insert(line);
+    }
+  }
+#endif
+
+  std::vector<std::string> order(names.begin(), names.end());
+  std::vector<double> sum(order.size() * Totals::size, 0.);
+  std::vector<double> slowest(order.size(), 0.);
+  for (pluint i = 0; i < order.size(); ++i) {
+    std::string name = order[i].substr(0, order[i].find('\t'));
+    std::map<std::string, std::vector<double>>::const_iterator it =
+        local.find(name);
+    if (it != local.end()) {
+      std::copy(it->second.begin(), it->second.end(),
+                sum.begin() + i * Totals::size);
+      slowest[i] = it->second[Totals::seconds];
+    }
+  }
+  int numRanks = global::mpi().getSize();
+#ifdef PLB_MPI_PARALLEL
+  MPI_Comm comm = global::mpi().getGlobalCommunicator();
+  MPI_Allreduce(MPI_IN_PLACE, sum.data(), (int)sum.size(), MPI_DOUBLE,
+                MPI_SUM, comm);
+  MPI_Allreduce(MPI_IN_PLACE, slowest.data(), (int)slowest.size(), MPI_DOUBLE,
+                MPI_MAX, comm);
+#endif
+  if (global::mpi().getRank() != 0) {
+    return;
+  }
+
+  double stepSeconds = 0.;
+  for (pluint i = 0; i < order.size(); ++i) {
+    if (order[i].substr(order[i].find('\t') + 1) == "step") {
+      stepSeconds += sum[i * Totals::size + Totals::seconds];
+    }
+  }
+  stepSeconds /= numRanks;
+
+  out << "Profile over " << numRanks << " rank(s), times in s per rank"
+      << (sync_ ? ", wait = barrier before the exchange" : "") << "\n";
+  out << std::left << std::setw(28) << "scope" << std::setw(10) << "category"
+      << std::right << std::setw(9) << "calls" << std::setw(11) << "mean"
+      << std::setw(11) << "slowest" << std::setw(8) << "%step" << std::setw(11)
+      << "wait" << std::setw(10) << "Mcell/s";
+  if (counters_) {
+    out << std::setw(7) << "IPC" << std::setw(11) << "miss/cell";
+  }
+  out << "\n";
+  for (pluint i = 0; i < order.size(); ++i) {
+    double const *totals = &sum[i * Totals::size];
+    std::string::size_type tab = order[i].find('\t');
+    double mean = totals[Totals::seconds] / numRanks;
+    out << std::left << std::setw(28) << order[i].substr(0, tab)
+        << std::setw(10) << order[i].substr(tab + 1) << std::right
+        << std::setw(9) << (plint)(totals[Totals::calls] / numRanks)
+        << std::fixed << std::setprecision(4) << std::setw(11) << mean
+        << std::setw(11) << slowest[i] << std::setprecision(1) << std::setw(8)
+        << (stepSeconds > 0. ? 100. * mean / stepSeconds : 0.)
+        << std::setprecision(4) << std::setw(11)
+        << totals[Totals::wait] / numRanks << std::setprecision(1)
+        << std::setw(10)
+        << (slowest[i] > 0. ? totals[Totals::cells] / slowest[i] * 1e-6 : 0.);
+    if (counters_) {
+      out << std::setprecision(2) << std::setw(7)
+          << (totals[Totals::cycles] > 0.
+                  ? totals[Totals::instructions] / totals[Totals::cycles]
+                  : 0.)
+          << std::setprecision(3) << std::setw(11)
+          << (totals[Totals::cells] > 0.
+                  ? totals[Totals::cacheMisses] / totals[Totals::cells]
+                  : 0.);
+    }
+    out.unsetf(std::ios::floatfield);
+    out << "\n";
+  }
+  out.flush();
+}
+
+void ProfileScope::begin(char const *name, char const *category,
+                         plint cells) {
+  std::set<std::string, std::less<>> &names = threadBuffer().scopeNames;
+  auto known = names.find(name);
+  if (known == names.end()) {
+    known = names.insert(name).first;
+  }
+  event_.name = known->c_str();
+  event_.category = category;
+  event_.cells = cells;
+  event_.wait = 0;
+  Profiler::readCounters(event_.counters);
+  event_.begin = Profiler::now();
+}
+
+void ProfileScope::end() {
+  event_.duration = Profiler::now() - event_.begin;
+  std::uint64_t counters[Profiler::numCounters];
+  Profiler::readCounters(counters);
+  for (int i = 0; i < Profiler::numCounters; ++i) {
+    event_.counters[i] = counters[i] - event_.counters[i];
+  }
+  Profiler::record(event_);
+}
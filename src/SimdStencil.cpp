@@ -0,0 +1,59 @@
+#include "SimdStencil.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+SimdLevel detectSimdLevel() {
+  SimdLevel level = SimdLevel::scalar;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#ifdef LBM_SIMD_AVX2
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    level = SimdLevel::avx2;
+  }
+#endif
+#ifdef LBM_SIMD_AVX512
+  if (__builtin_cpu_supports("avx512f")) {
+    level = SimdLevel::avx512;
+  }
+#endif
+#endif
+  if (char const *requested = std::getenv("LBM_SIMD")) {
+    SimdLevel cap = SimdLevel::avx512;
+    if (std::strcmp(requested, "scalar") == 0) {
+      cap = SimdLevel::scalar;
+    } else if (std::strcmp(requested, "avx2") == 0) {
+      cap = SimdLevel::avx2;
+    }
+    if (cap < level) {
+      level = cap;
+    }
+  }
+  return level;
+}
+
+} // namespace
+
+SimdLevel activeSimdLevel() {
+  static const SimdLevel level = detectSimdLevel();
+  return level;
+}
+
+char const *simdLevelName(SimdLevel level) {
+  switch (level) {
+  case SimdLevel::avx512:
+    return "avx512";
+  case SimdLevel::avx2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+template <class Op> void stencilRowScalar(Op const &op, StencilRow const &row) {
+  stencilRowKernel<ScalarVec, ScalarVec>(op, row);
+}
+
+#define LBM_INSTANTIATE_SCALAR(Op)                                             \
+  template void stencilRowScalar<Op>(Op const &, StencilRow const &);
+LBM_STENCIL_OPERATORS(LBM_INSTANTIATE_SCALAR)
@@ -0,0 +1,13 @@
+// Compiled with -mavx2 -mfma when the compiler supports it (see
+// CMakeLists.txt); only called after activeSimdLevel() checked the CPU.
+#include "SimdStencil.h"
+
+#ifdef __AVX2__
+template <class Op> void stencilRowAvx2(Op const &op, StencilRow const &row) {
+  stencilRowKernel<Avx2Vec, ScalarLane<(int)SimdLevel::avx2>>(op, row);
+}
+
+#define LBM_INSTANTIATE_AVX2(Op)                                               \
+  template void stencilRowAvx2<Op>(Op const &, StencilRow const &);
+LBM_STENCIL_OPERATORS(LBM_INSTANTIATE_AVX2)
+#endif
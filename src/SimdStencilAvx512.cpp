@@ -0,0 +1,14 @@
+// Compiled with -mavx512f when the compiler supports it (see
+// CMakeLists.txt); only called after activeSimdLevel() checked the CPU.
+#include "SimdStencil.h"
+
+#ifdef __AVX512F__
+template <class Op>
+void stencilRowAvx512(Op const &op, StencilRow const &row) {
+  stencilRowKernel<Avx512Vec, ScalarLane<(int)SimdLevel::avx512>>(op, row);
+}
+
+#define LBM_INSTANTIATE_AVX512(Op)                                             \
+  template void stencilRowAvx512<Op>(Op const &, StencilRow const &);
+LBM_STENCIL_OPERATORS(LBM_INSTANTIATE_AVX512)
+#endif
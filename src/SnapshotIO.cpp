@@ -0,0 +1,275 @@
+#include "SnapshotIO.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+const char snapshotMagic[8] = {'L', 'B', 'M', 'S', 'N', 'A', 'P', '\0'};
+const std::uint32_t snapshotVersion = 1;
+
+template <typename Word> void appendRaw(std::vector<char> &out, Word value) {
+  const char *bytes = reinterpret_cast<const char *>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(Word));
+}
+
+void appendVarint(std::vector<char> &out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back((char)((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back((char)value);
+}
+
+std::uint64_t readVarint(std::vector<char> const &in, pluint &pos) {
+  std::uint64_t value = 0;
+  int shift = 0;
+  while (true) {
+    PLB_ASSERT(pos < in.size());
+    std::uint8_t byte = (std::uint8_t)in[pos++];
+    value |= (std::uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+    shift += 7;
+  }
+}
+
+// Token stream: varint count of zero deltas, varint count of non-zero
+// deltas, then those deltas. delta_i = word_i ^ word_{i-1}, word_{-1} = 0.
+template <typename Word>
+std::vector<char> xorDeltaRleEncode(std::vector<Word> const &words) {
+  std::vector<char> out;
+  const pluint n = words.size();
+  auto delta = [&words](pluint i) -> Word {
+    return words[i] ^ (i > 0 ? words[i - 1] : (Word)0);
+  };
+  pluint i = 0;
+  while (i < n) {
+    pluint zeroBegin = i;
+    while (i < n && delta(i) == 0) {
+      ++i;
+    }
+    pluint literalBegin = i;
+    while (i < n && delta(i) != 0) {
+      ++i;
+    }
+    appendVarint(out, literalBegin - zeroBegin);
+    appendVarint(out, i - literalBegin);
+    for (pluint k = literalBegin; k < i; ++k) {
+      appendRaw(out, delta(k));
+    }
+  }
+  return out;
+}
+
+template <typename Word>
+std::vector<Word> xorDeltaRleDecode(std::vector<char> const &in,
+                                    pluint numWords) {
+  std::vector<Word> words;
+  words.reserve(numWords);
+  Word previous = 0;
+  pluint pos = 0;
+  while (words.size() < numWords) {
+    std::uint64_t zeros = readVarint(in, pos);
+    std::uint64_t literals = readVarint(in, pos);
+    words.insert(words.end(), zeros, previous);
+    for (std::uint64_t k = 0; k < literals; ++k) {
+      Word delta;
+      PLB_ASSERT(pos + sizeof(Word) <= in.size());
+      std::memcpy(&delta, &in[pos], sizeof(Word));
+      pos += sizeof(Word);
+      previous ^= delta;
+      words.push_back(previous);
+    }
+  }
+  PLB_ASSERT(words.size() == numWords);
+  return words;
+}
+
+template <typename Float, typename Word>
+std::vector<char> encodeAs(std::vector<double> const &values,
+                           SnapshotCodec codec) {
+  std::vector<Word> words(values.size());
+  for (pluint i = 0; i < values.size(); ++i) {
+    Float value = (Float)values[i];
+    std::memcpy(&words[i], &value, sizeof(Word));
+  }
+  if (codec == SnapshotCodec::xorDeltaRle) {
+    return xorDeltaRleEncode(words);
+  }
+  std::vector<char> out(words.size() * sizeof(Word));
+  if (!words.empty()) {
+    std::memcpy(&out[0], &words[0], out.size());
+  }
+  return out;
+}
+
+template <typename Float, typename Word>
+std::vector<double> decodeAs(std::vector<char> const &encoded,
+                             pluint numValues, SnapshotCodec codec) {
+  std::vector<Word> words;
+  if (codec == SnapshotCodec::xorDeltaRle) {
+    words = xorDeltaRleDecode<Word>(encoded, numValues);
+  } else {
+    PLB_ASSERT(encoded.size() == numValues * sizeof(Word));
+    words.resize(numValues);
+    if (numValues > 0) {
+      std::memcpy(&words[0], &encoded[0], encoded.size());
+    }
+  }
+  std::vector<double> values(numValues);
+  for (pluint i = 0; i < numValues; ++i) {
+    Float value;
+    std::memcpy(&value, &words[i], sizeof(Word));
+    values[i] = (double)value;
+  }
+  return values;
+}
+
+std::vector<char> encodeHeader(SnapshotFrame const &frame,
+                               std::uint32_t numBlocks,
+                               SnapshotOptions const &options) {
+  std::vector<char> header(snapshotMagic, snapshotMagic + 8);
+  appendRaw(header, snapshotVersion);
+  appendRaw(header, (std::uint32_t)0); // header size, patched below
+  appendRaw(header, (std::int64_t)frame.nx);
+  appendRaw(header, (std::int64_t)frame.ny);
+  appendRaw(header, (std::int64_t)frame.step);
+  appendRaw(header, (std::uint32_t)frame.fields.size());
+  appendRaw(header, numBlocks);
+  appendRaw(header, (std::uint8_t)options.dtype);
+  appendRaw(header, (std::uint8_t)options.codec);
+  for (SnapshotField const &field : frame.fields) {
+    appendRaw(header, (std::uint16_t)field.name.size());
+    header.insert(header.end(), field.name.begin(), field.name.end());
+    appendRaw(header, (std::uint8_t)field.numComponents);
+  }
+  std::uint32_t size = (std::uint32_t)header.size();
+  std::memcpy(&header[12], &size, sizeof(size));
+  return header;
+}
+
+// All block records of this process, back to back.
+std::vector<char> encodeBlocks(SnapshotFrame const &frame,
+                               SnapshotOptions const &options) {
+  std::vector<char> out;
+  for (SnapshotBlock const &block : frame.blocks) {
+    PLB_ASSERT(block.values.size() >= frame.fields.size());
+    appendRaw(out, (std::int64_t)block.bulk.x0);
+    appendRaw(out, (std::int64_t)block.bulk.x1);
+    appendRaw(out, (std::int64_t)block.bulk.y0);
+    appendRaw(out, (std::int64_t)block.bulk.y1);
+    for (pluint iField = 0; iField < frame.fields.size(); ++iField) {
+      std::vector<char> encoded =
+          encodeSnapshotData(block.values[iField], options);
+      appendRaw(out, (std::uint64_t)encoded.size());
+      out.insert(out.end(), encoded.begin(), encoded.end());
+    }
+  }
+  return out;
+}
+
+void writeSerial(std::string const &fileName, std::vector<char> const &header,
+                 std::vector<char> const &payload) {
+  std::ofstream ofile(fileName.c_str(), std::ios::binary);
+  if (!ofile) {
+    throw PlbIOException("Could not open snapshot file " + fileName);
+  }
+  ofile.write(header.data(), header.size());
+  ofile.write(payload.data(), payload.size());
+}
+
+} // namespace
+
+plint SnapshotFrame::addField(std::string const &name, plint numComponents) {
+  fields.push_back(SnapshotField{name, numComponents});
+  return (plint)fields.size() - 1;
+}
+
+void SnapshotFrame::clear() {
+  fields.clear();
+  blocks.clear();
+}
+
+void SnapshotFrame::recycle() { fields.clear(); }
+
+std::vector<char> encodeSnapshotData(std::vector<double> const &values,
+                                     SnapshotOptions const &options) {
+  if (options.dtype == SnapshotDType::float32) {
+    return encodeAs<float, std::uint32_t>(values, options.codec);
+  }
+  return encodeAs<double, std::uint64_t>(values, options.codec);
+}
+
+std::vector<double> decodeSnapshotData(std::vector<char> const &encoded,
+                                       pluint numValues,
+                                       SnapshotOptions const &options) {
+  if (options.dtype == SnapshotDType::float32) {
+    return decodeAs<float, std::uint32_t>(encoded, numValues, options.codec);
+  }
+  return decodeAs<double, std::uint64_t>(encoded, numValues, options.codec);
+}
+
+void writeSnapshotLocal(SnapshotFrame const &frame, std::string const &fileName,
+                        SnapshotOptions const &options) {
+  std::vector<char> header =
+      encodeHeader(frame, (std::uint32_t)frame.blocks.size(), options);
+  writeSerial(fileName, header, encodeBlocks(frame, options));
+}
+
+void writeSnapshot(SnapshotFrame const &frame, std::string const &fileName,
+                   SnapshotOptions const &options) {
+  std::vector<char> payload = encodeBlocks(frame, options);
+
+#ifdef PLB_MPI_PARALLEL
+  MPI_Comm comm = global::mpi().getGlobalCommunicator();
+
+  long long localBlocks = (long long)frame.blocks.size();
+  long long numBlocks = 0;
+  MPI_Allreduce(&localBlocks, &numBlocks, 1, MPI_LONG_LONG, MPI_SUM, comm);
+  std::vector<char> header =
+      encodeHeader(frame, (std::uint32_t)numBlocks, options);
+
+  // each process writes its records behind those of the lower ranks
+  long long localBytes = (long long)payload.size();
+  long long offset = 0;
+  MPI_Exscan(&localBytes, &offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+  if (global::mpi().getRank() == 0) {
+    offset = 0;
+  }
+  offset += (long long)header.size();
+
+  MPI_File file;
+  int status = MPI_File_open(comm, const_cast<char *>(fileName.c_str()),
+                             MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                             &file);
+  if (status != MPI_SUCCESS) {
+    throw PlbIOException("Could not open snapshot file " + fileName);
+  }
+  // truncates an older file of the same name; collective, unlike a delete
+  // before the open, which one rank may issue after another created it
+  MPI_File_set_size(file, 0);
+  if (global::mpi().getRank() == 0) {
+    MPI_File_write_at(file, 0, header.data(), (int)header.size(), MPI_BYTE,
+                      MPI_STATUS_IGNORE);
+  }
+  // payloads may exceed INT_MAX bytes at production sizes
+  const long long chunk = 1LL << 30;
+  long long numChunks = (localBytes + chunk - 1) / chunk;
+  long long maxChunks = 0;
+  MPI_Allreduce(&numChunks, &maxChunks, 1, MPI_LONG_LONG, MPI_MAX, comm);
+  for (long long iChunk = 0; iChunk < maxChunks; ++iChunk) {
+    long long begin = std::min(iChunk * chunk, localBytes);
+    long long count = std::min(chunk, localBytes - begin);
+    MPI_File_write_at_all(file, (MPI_Offset)(offset + begin),
+                          payload.data() + begin, (int)count, MPI_BYTE,
+                          MPI_STATUS_IGNORE);
+  }
+  MPI_File_close(&file);
+#else
+  std::vector<char> header =
+      encodeHeader(frame, (std::uint32_t)frame.blocks.size(), options);
+  writeSerial(fileName, header, payload);
+#endif
+}
@@ -0,0 +1,192 @@
+#include "StepScheduler.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <set>
+
+StepScheduler::Stage &StepScheduler::Stage::reads(std::string const &resource,
+                                                  Access access) {
+  readSet.push_back(Read{resource, access, false});
+  return *this;
+}
+
+StepScheduler::Stage &
+StepScheduler::Stage::readsPrevious(std::string const &resource,
+                                    Access access) {
+  readSet.push_back(Read{resource, access, true});
+  return *this;
+}
+
+StepScheduler::Stage &StepScheduler::Stage::writes(std::string const &resource,
+                                                   Coverage coverage) {
+  writeSet.push_back(Write{resource, coverage});
+  return *this;
+}
+
+StepScheduler::Stage &StepScheduler::Stage::every(plint steps) {
+  PLB_PRECONDITION(steps >= 1);
+  period = steps;
+  return *this;
+}
+
+void StepScheduler::addResource(std::string const &name, Action exchange) {
+  Resource resource;
+  resource.exchange = exchange;
+  resources[name] = resource;
+}
+
+StepScheduler::Stage &StepScheduler::addStage(std::string const &name,
+                                              Action action) {
+  std::unique_ptr<Stage> stage(new Stage);
+  stage->name = name;
+  stage->action = action;
+  stages.push_back(std::move(stage));
+  orderIsValid = false;
+  return *stages.back();
+}
+
+StepScheduler::Resource &StepScheduler::getResource(std::string const &name) {
+  std::map<std::string, Resource>::iterator it = resources.find(name);
+  if (it == resources.end()) {
+    throw PlbLogicErrorException("StepScheduler: unknown resource " + name);
+  }
+  return it->second;
+}
+
+void StepScheduler::resolveOrder() {
+  const pluint numStages = stages.size();
+  std::vector<std::set<pluint>> successors(numStages);
+
+  // writers of each resource, in registration order
+  std::map<std::string, std::vector<pluint>> writers;
+  for (pluint iStage = 0; iStage < numStages; ++iStage) {
+    for (Stage::Write const &write : stages[iStage]->writeSet) {
+      getResource(write.resource);
+      writers[write.resource].push_back(iStage);
+    }
+  }
+  for (std::map<std::string, std::vector<pluint>>::const_iterator it =
+           writers.begin();
+       it != writers.end(); ++it) {
+    for (pluint i = 1; i < it->second.size(); ++i) {
+      successors[it->second[i - 1]].insert(it->second[i]);
+    }
+  }
+  for (pluint iStage = 0; iStage < numStages; ++iStage) {
+    for (Stage::Read const &read : stages[iStage]->readSet) {
+      getResource(read.resource);
+      std::map<std::string, std::vector<pluint>>::const_iterator it =
+          writers.find(read.resource);
+      if (it == writers.end()) {
+        continue;
+      }
+      std::vector<pluint> const &w = it->second;
+      if (std::find(w.begin(), w.end(), iStage) != w.end()) {
+        continue; // in-place update, ordered among the writers
+      }
+      if (read.previous) {
+        successors[iStage].insert(w.front());
+      } else {
+        successors[w.back()].insert(iStage);
+      }
+    }
+  }
+
+  // Kahn's algorithm; ties are broken by registration order.
+  std::vector<plint> inDegree(numStages, 0);
+  for (pluint iStage = 0; iStage < numStages; ++iStage) {
+    for (pluint next : successors[iStage]) {
+      ++inDegree[next];
+    }
+  }
+  std::set<pluint> ready;
+  for (pluint iStage = 0; iStage < numStages; ++iStage) {
+    if (inDegree[iStage] == 0) {
+      ready.insert(iStage);
+    }
+  }
+  order.clear();
+  while (!ready.empty()) {
+    pluint iStage = *ready.begin();
+    ready.erase(ready.begin());
+    order.push_back(iStage);
+    for (pluint next : successors[iStage]) {
+      if (--inDegree[next] == 0) {
+        ready.insert(next);
+      }
+    }
+  }
+  if (order.size() != numStages) {
+    std::string cycle;
+    for (pluint iStage = 0; iStage < numStages; ++iStage) {
+      if (inDegree[iStage] > 0) {
+        cycle += " " + stages[iStage]->name;
+      }
+    }
+    throw PlbLogicErrorException(
+        "StepScheduler: cyclic dependency between stages:" + cycle);
+  }
+  orderIsValid = true;
+}
+
+void StepScheduler::execute(Stage &stage) {
+  for (Stage::Read const &read : stage.readSet) {
+    if (read.access != stencil) {
+      continue;
+    }
+    Resource &resource = getResource(read.resource);
+    if (!resource.envelopeValid) {
+      ProfileScope scope(read.resource.c_str(), "exchange");
+      if (Profiler::measuresImbalance()) {
+        std::int64_t begin = Profiler::now();
+        global::mpi().barrier();
+        scope.addWait(Profiler::now() - begin);
+      }
+      resource.exchange();
+      resource.envelopeValid = true;
+      ++numExchanges;
+    }
+  }
+  {
+    ProfileScope scope(stage.name.c_str(), "stage", numCells);
+    stage.action();
+  }
+  for (Stage::Write const &write : stage.writeSet) {
+    getResource(write.resource).envelopeValid =
+        (write.coverage == bulkAndEnvelope);
+  }
+}
+
+void StepScheduler::step() {
+  if (!orderIsValid) {
+    resolveOrder();
+  }
+  ProfileScope scope("step", "step", numCells);
+  for (pluint iStage : order) {
+    Stage &stage = *stages[iStage];
+    if (numSteps % stage.period == 0) {
+      execute(stage);
+    }
+  }
+  ++numSteps;
+}
+
+void StepScheduler::run(std::string const &stageName) {
+  for (std::unique_ptr<Stage> &stage : stages) {
+    if (stage->name == stageName) {
+      execute(*stage);
+      return;
+    }
+  }
+  throw PlbLogicErrorException("StepScheduler: unknown stage " + stageName);
+}
+
+std::vector<std::string> StepScheduler::getExecutionOrder() {
+  if (!orderIsValid) {
+    resolveOrder();
+  }
+  std::vector<std::string> names;
+  for (pluint iStage : order) {
+    names.push_back(stages[iStage]->name);
+  }
+  return names;
+}
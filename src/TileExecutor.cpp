@@ -0,0 +1,203 @@
+#include "TileExecutor.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// CPUs the process may run on, as given by the MPI launcher; read once,
+// before a worker is pinned.
+std::vector<int> const &allowedCpus() {
+  static std::vector<int> const cpus = []() {
+    std::vector<int> list;
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed)) {
+          list.push_back(cpu);
+        }
+      }
+    }
+#endif
+    return list;
+  }();
+  return cpus;
+}
+
+// Holds the calling thread to the thread-th allowed CPU; does nothing if
+// there are fewer.
+void pinToAllowedCpu(unsigned thread) {
+#ifdef __linux__
+  std::vector<int> const &cpus = allowedCpus();
+  if (thread < cpus.size()) {
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(cpus[thread], &one);
+    pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+  }
+#else
+  (void)thread;
+#endif
+}
+
+} // namespace
+
+TileExecutor::TileExecutor(unsigned numThreads, plint tileSize, bool pin)
+    : tileSize_(std::max((plint)1, tileSize)) {
+  if (numThreads == 0) {
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (unsigned t = 0; t < numThreads; ++t) {
+    queues_.emplace_back(new Queue());
+  }
+  // The calling thread is left unpinned, since threads it starts later
+  // (e.g. the output writer) would inherit its affinity.
+  for (unsigned t = 1; t < numThreads; ++t) {
+    workers_.emplace_back([this, t, pin]() {
+      if (pin) {
+        pinToAllowedCpu(t);
+      }
+      Profiler::setThreadName("tile worker " + std::to_string(t));
+      worker(t);
+    });
+  }
+}
+
+TileExecutor::~TileExecutor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  started_.notify_all();
+  for (std::thread &thread : workers_) {
+    thread.join();
+  }
+}
+
+std::vector<Box2D> TileExecutor::tilesOf(Box2D domain) const {
+  std::vector<Box2D> tiles;
+  for (plint x0 = domain.x0; x0 <= domain.x1; x0 += tileSize_) {
+    plint x1 = std::min(domain.x1, x0 + tileSize_ - 1);
+    for (plint y0 = domain.y0; y0 <= domain.y1; y0 += tileSize_) {
+      tiles.push_back(
+          Box2D(x0, x1, y0, std::min(domain.y1, y0 + tileSize_ - 1)));
+    }
+  }
+  return tiles;
+}
+
+std::vector<Box2D> TileExecutor::slabsOf(Box2D domain) const {
+  std::vector<Box2D> slabs;
+  plint columns = domain.getNx();
+  plint numSlabs = std::min((plint)getNumThreads(), columns);
+  for (plint s = 0; s < numSlabs; ++s) {
+    slabs.push_back(Box2D(domain.x0 + s * columns / numSlabs,
+                          domain.x0 + (s + 1) * columns / numSlabs - 1,
+                          domain.y0, domain.y1));
+  }
+  return slabs;
+}
+
+void TileExecutor::run(std::vector<Box2D> const &boxes,
+                       std::function<void(Box2D)> const &body) {
+  if (boxes.empty()) {
+    return;
+  }
+  if (workers_.empty() || boxes.size() == 1) {
+    for (Box2D const &box : boxes) {
+      body(box);
+    }
+    return;
+  }
+
+  // Set up before the boxes are queued: a worker still looking for work
+  // from the previous call may pick up a box as soon as it is queued.
+  body_ = &body;
+  remaining_.store(boxes.size());
+  const std::size_t numThreads = queues_.size();
+  for (std::size_t t = 0; t < numThreads; ++t) {
+    std::lock_guard<std::mutex> lock(queues_[t]->mutex);
+    queues_[t]->boxes.assign(boxes.begin() + t * boxes.size() / numThreads,
+                             boxes.begin() +
+                                 (t + 1) * boxes.size() / numThreads);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+  }
+  started_.notify_all();
+
+  work(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_.wait(lock, [this]() { return remaining_.load() == 0; });
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void TileExecutor::worker(unsigned thread) {
+  std::uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      started_.wait(lock,
+                    [this, seen]() { return stop_ || generation_ != seen; });
+      if (stop_) {
+        return;
+      }
+      seen = generation_;
+    }
+    work(thread);
+  }
+}
+
+void TileExecutor::work(unsigned thread) {
+  Box2D box;
+  while (take(thread, box)) {
+    try {
+      (*body_)(box);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) {
+        error_ = std::current_exception();
+      }
+    }
+    if (remaining_.fetch_sub(1) == 1) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      finished_.notify_all();
+    }
+  }
+}
+
+bool TileExecutor::take(unsigned thread, Box2D &box) {
+  {
+    Queue &own = *queues_[thread];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.boxes.empty()) {
+      box = own.boxes.front();
+      own.boxes.pop_front();
+      return true;
+    }
+  }
+  const unsigned numThreads = (unsigned)queues_.size();
+  for (unsigned k = 1; k < numThreads; ++k) {
+    Queue &victim = *queues_[(thread + k) % numThreads];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.boxes.empty()) {
+      box = victim.boxes.back();
+      victim.boxes.pop_back();
+      stolen_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}